@@ -0,0 +1,209 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestCompositeTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkCompositeTileSource.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//----------------------------------------------------------------------------
+// Source of single color tiles, missing at zoom levels above DataZoom
+class SolidTileSource : public vtkMapTileSource
+{
+public:
+  static SolidTileSource *New();
+  vtkTypeMacro(SolidTileSource, vtkMapTileSource)
+
+  unsigned char Color[4];
+  int Components;
+  int DataZoom;
+  int Status;  // returned for missing tiles
+  int LastZoom;  // of the last tile read
+
+  virtual bool ProvidesImages() { return true; }
+
+  virtual vtkImageData *ReadTileImage(int zoom, int, int, int *status)
+  {
+    *status = vtkMapTile::DownloadOK;
+    this->LastZoom = zoom;
+    if (zoom > this->DataZoom)
+      {
+      *status = this->Status;
+      return NULL;
+      }
+
+    vtkImageData *image = vtkImageData::New();
+    image->SetDimensions(2, 2, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, this->Components);
+    unsigned char *pixel =
+      static_cast<unsigned char*>(image->GetScalarPointer());
+    for (int i = 0; i < 4; ++i, pixel += this->Components)
+      {
+      std::copy(this->Color, this->Color + this->Components, pixel);
+      }
+    return image;
+  }
+
+protected:
+  SolidTileSource()
+  {
+    this->Components = 3;
+    this->DataZoom = 30;
+    this->LastZoom = -1;
+    this->Status = vtkMapTile::DownloadMissing;
+  }
+};
+vtkStandardNewMacro(SolidTileSource)
+
+//----------------------------------------------------------------------------
+// Returns the first pixel of image, as an RGBA string for messages
+static std::string PixelString(vtkImageData *image)
+{
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  std::stringstream oss;
+  oss << int(pixel[0]) << " " << int(pixel[1]) << " "
+      << int(pixel[2]) << " " << int(pixel[3]);
+  return oss.str();
+}
+
+//----------------------------------------------------------------------------
+int TestCompositeTileSource(int, char*[])
+{
+  // Opaque red base, half transparent blue overlay
+  vtkNew<SolidTileSource> base;
+  base->Color[0] = 255;
+  base->Color[1] = base->Color[2] = 0;
+  base->DataZoom = 10;
+  vtkNew<SolidTileSource> overlay;
+  overlay->Components = 4;
+  overlay->Color[0] = overlay->Color[1] = 0;
+  overlay->Color[2] = 255;
+  overlay->Color[3] = 128;
+  overlay->DataZoom = 5;
+
+  vtkNew<vtkCompositeTileSource> composite;
+  TEST_ASSERT(composite->ProvidesImages(), "composite provides no images");
+  composite->AddSource(base.GetPointer());
+  composite->AddSource(overlay.GetPointer(), 0.5);
+  TEST_ASSERT(composite->GetNumberOfSources() == 2,
+              composite->GetNumberOfSources() << " sources");
+
+  int status = -1;
+  vtkImageData *image = composite->ReadTileImage(1, 0, 0, &status);
+  TEST_ASSERT(image && status == vtkMapTile::DownloadOK, "no image");
+  TEST_ASSERT(image->GetNumberOfScalarComponents() == 4, "image is not RGBA");
+  unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  // Overlay alpha is 0.5 * 128 / 255 = 0.25
+  TEST_ASSERT(pixel[0] == 191 && pixel[1] == 0 && pixel[2] == 64 &&
+              pixel[3] == 255, "blended pixel is " << PixelString(image));
+  image->Delete();
+
+  // Sources without the tile are left out
+  image = composite->ReadTileImage(8, 0, 0, &status);
+  TEST_ASSERT(image, "no image without overlay");
+  pixel = static_cast<unsigned char*>(image->GetScalarPointer());
+  TEST_ASSERT(pixel[0] == 255 && pixel[2] == 0 && pixel[3] == 255,
+              "base pixel is " << PixelString(image));
+  image->Delete();
+
+  image = composite->ReadTileImage(12, 0, 0, &status);
+  TEST_ASSERT(!image && status == vtkMapTile::DownloadMissing,
+              "tile missing from all sources");
+
+  // Transparent sources are skipped, and changes update the time stamp
+  unsigned long mtime = composite->GetMTime();
+  composite->SetSourceOpacity(0, 0.0);
+  TEST_ASSERT(composite->GetMTime() > mtime, "opacity change not tracked");
+  image = composite->ReadTileImage(1, 0, 0, &status);
+  pixel = static_cast<unsigned char*>(image->GetScalarPointer());
+  TEST_ASSERT(pixel[0] == 0 && pixel[2] == 255 && pixel[3] == 64,
+              "overlay pixel is " << PixelString(image));
+  image->Delete();
+
+  mtime = composite->GetMTime();
+  overlay->Modified();
+  TEST_ASSERT(composite->GetMTime() > mtime, "source change not tracked");
+
+  // Failures are not hidden by an incomplete blend
+  composite->SetSourceOpacity(0, 1.0);
+  overlay->Status = vtkMapTile::DownloadFailed;
+  image = composite->ReadTileImage(8, 0, 0, &status);
+  TEST_ASSERT(!image && status == vtkMapTile::DownloadFailed,
+              "failed tile was blended");
+
+  // Past its max zoom, the overlay tile is scaled up from its ancestor
+  overlay->Status = vtkMapTile::DownloadMissing;
+  overlay->SetMaxZoom(5);
+  image = composite->ReadTileImage(8, 100, 200, &status);
+  TEST_ASSERT(image && overlay->LastZoom == 5,
+              "overlay read at zoom " << overlay->LastZoom);
+  pixel = static_cast<unsigned char*>(image->GetScalarPointer());
+  TEST_ASSERT(pixel[0] == 191 && pixel[1] == 0 && pixel[2] == 64 &&
+              pixel[3] == 255, "overzoomed pixel is " << PixelString(image));
+  image->Delete();
+
+  // Failed downloads are backed off, and the tiles of suspended hosts
+  // left out like missing ones
+  std::string directory =
+    vtksys::SystemTools::GetCurrentWorkingDirectory() +
+    "/TestCompositeTileSource";
+  vtksys::SystemTools::RemoveADirectory(directory);
+  vtkNew<vtkMapTileSource> remote;
+  remote->SetName("remote");
+  remote->SetUrlTemplate("http://localhost:1/{z}/{x}/{y}.png");
+  remote->RemoveAllSubdomains();
+  composite->RemoveAllSources();
+  composite->AddSource(base.GetPointer());
+  composite->AddSource(remote.GetPointer());
+  composite->SetCacheDirectory(directory.c_str());
+  TEST_ASSERT(!composite->GetSourceFailureCache(2), "invalid failure cache");
+  vtkNew<TestClock> clock;
+  vtkMapTileFailureCache *failureCache = composite->GetSourceFailureCache(1);
+  failureCache->SetClock(clock.GetPointer());
+  failureCache->SetHostFailureThreshold(1);
+
+  image = composite->ReadTileImage(8, 0, 0, &status);
+  TEST_ASSERT(!image && status == vtkMapTile::DownloadFailed,
+              "failed download was blended");
+  TEST_ASSERT(!failureCache->IsTileAvailable(8, 0, 0),
+              "failed download not backed off");
+  image = composite->ReadTileImage(8, 1, 0, &status);
+  TEST_ASSERT(image && status == vtkMapTile::DownloadOK,
+              "suspended source not left out");
+  pixel = static_cast<unsigned char*>(image->GetScalarPointer());
+  TEST_ASSERT(pixel[0] == 255 && pixel[2] == 0 && pixel[3] == 255,
+              "pixel without suspended source is " << PixelString(image));
+  image->Delete();
+
+  vtksys::SystemTools::RemoveADirectory(directory);
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestCompositeTileSource)
@@ -0,0 +1,144 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMBTilesTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMBTilesTileSource.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkAtomicInt.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+#include <vtk_sqlite.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Write a package with one tile, at zoom 1, column 1, TMS row 1
+bool WritePackage(const char *filename)
+{
+  remove(filename);
+  vtk_sqlite3 *db = NULL;
+  if (vtk_sqlite3_open_v2(filename, &db,
+        VTK_SQLITE_OPEN_READWRITE | VTK_SQLITE_OPEN_CREATE, NULL) !=
+      VTK_SQLITE_OK)
+    {
+    vtk_sqlite3_close(db);
+    return false;
+    }
+
+  const char *sql =
+    "CREATE TABLE metadata (name text, value text);"
+    "CREATE TABLE tiles (zoom_level integer, tile_column integer,"
+    " tile_row integer, tile_data blob);";
+  vtk_sqlite3_stmt *statement = NULL;
+  bool ok =
+    vtk_sqlite3_exec(db, sql, NULL, NULL, NULL) == VTK_SQLITE_OK &&
+    vtk_sqlite3_prepare_v2(db, "INSERT INTO tiles VALUES (1, 1, 1, ?1)",
+                           -1, &statement, NULL) == VTK_SQLITE_OK &&
+    vtk_sqlite3_bind_blob(statement, 1, TilePNG, sizeof(TilePNG),
+                          VTK_SQLITE_STATIC) == VTK_SQLITE_OK &&
+    vtk_sqlite3_step(statement) == VTK_SQLITE_DONE;
+  vtk_sqlite3_finalize(statement);
+  vtk_sqlite3_close(db);
+  return ok;
+}
+
+struct ThreadData
+{
+  vtkMBTilesTileSource *Source;
+  vtkAtomicInt<vtkTypeInt32> Errors;
+};
+
+VTK_THREAD_RETURN_TYPE ReadTiles(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  ThreadData *data = static_cast<ThreadData*>(info->UserData);
+  std::vector<unsigned char> buffer;
+  for (int i = 0; i < 100; ++i)
+    {
+    if (!data->Source->ReadTileData(1, 1, 0, buffer) ||
+        buffer.size() != sizeof(TilePNG) ||
+        data->Source->ReadTileData(1, 0, 0, buffer))
+      {
+      data->Errors++;
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMBTilesTileSource(int, char*[])
+{
+  const char *filename = "TestMBTilesTileSource.mbtiles";
+  TEST_ASSERT(WritePackage(filename), "cannot write " << filename);
+
+  vtkNew<vtkMBTilesTileSource> source;
+  TEST_ASSERT(source->ProvidesImages(), "package doesn't provide images");
+  TEST_ASSERT(!source->IsLocal(), "package source is local");
+  TEST_ASSERT(source->GetTileUrl(1, 1, 0).empty(), "package has a url");
+
+  // No file
+  std::vector<unsigned char> data;
+  TEST_ASSERT(!source->ReadTileData(1, 1, 0, data), "read without file");
+
+  // TMS row 1 at zoom 1 is OSM row 0
+  source->SetFileName(filename);
+  TEST_ASSERT(source->ReadTileData(1, 1, 0, data), "tile not found");
+  TEST_ASSERT(data.size() == sizeof(TilePNG) &&
+              std::equal(data.begin(), data.end(), TilePNG),
+              "tile data differs");
+  TEST_ASSERT(!source->ReadTileData(1, 1, 1, data), "read missing tile");
+  TEST_ASSERT(!source->ReadTileData(1, 2, 0, data), "read invalid tile");
+  TEST_ASSERT(!source->ReadTileData(-1, 0, 0, data), "read invalid zoom");
+
+  vtkImageData *image = source->ReadTileImage(1, 1, 0);
+  TEST_ASSERT(image, "tile image not decoded");
+  int *dims = image->GetDimensions();
+  TEST_ASSERT(dims[0] == 1 && dims[1] == 1,
+              "tile image size " << dims[0] << "x" << dims[1]);
+  image->Delete();
+  TEST_ASSERT(!source->ReadTileImage(2, 0, 0), "decoded missing tile");
+
+  // Concurrent reads share the connection pool
+  source->SetMaxConnections(2);
+  source->CloseConnections();
+  ThreadData threadData;
+  threadData.Source = source.GetPointer();
+  threadData.Errors = 0;
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(8);
+  threader->SetSingleMethod(ReadTiles, &threadData);
+  threader->SingleMethodExecute();
+  TEST_ASSERT(threadData.Errors == 0,
+              threadData.Errors << " concurrent reads failed");
+
+  // Missing file
+  source->SetFileName("NoSuchFile.mbtiles");
+  TEST_ASSERT(!source->ReadTileData(1, 1, 0, data), "read from missing file");
+
+  remove(filename);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMBTilesTileSource)
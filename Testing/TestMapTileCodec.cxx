@@ -0,0 +1,210 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileCodec.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileCodec.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkLookupTable.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+// 1x1 pixel grayscale JPEG image
+const unsigned char TileJPEG[] =
+  {
+  0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+  0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+  0x00, 0x50, 0x37, 0x3c, 0x46, 0x3c, 0x32, 0x50, 0x46, 0x41, 0x46, 0x5a,
+  0x55, 0x50, 0x5f, 0x78, 0xc8, 0x82, 0x78, 0x6e, 0x6e, 0x78, 0xf5, 0xaf,
+  0xb9, 0x91, 0xc8, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x01,
+  0x00, 0x01, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x00, 0x14, 0x00, 0x01,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x03, 0xff, 0xc4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3f, 0x00,
+  0x77, 0xff, 0xd9
+  };
+
+// Codec for a made up format: "TILE" followed by a gray level, padded
+// to CheckLength and ending with "ENDTILE!"
+class GrayTileCodec : public vtkMapTileCodec
+{
+public:
+  static GrayTileCodec *New();
+  vtkTypeMacro(GrayTileCodec, vtkMapTileCodec)
+
+  virtual bool CheckImage(const unsigned char *head, const unsigned char *tail)
+  {
+    return (memcmp(head, "TILE", 4) == 0 &&
+            memcmp(tail, "ENDTILE!", CheckLength) == 0) ||
+      this->Superclass::CheckImage(head, tail);
+  }
+
+  virtual vtkImageData *Decode(const unsigned char *data, size_t length)
+  {
+    if (!this->IsImageComplete(data, length) || memcmp(data, "TILE", 4) != 0)
+      {
+      return this->Superclass::Decode(data, length);
+      }
+    vtkImageData *image = vtkImageData::New();
+    image->SetDimensions(1, 1, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    *static_cast<unsigned char*>(image->GetScalarPointer()) = data[4];
+    return image;
+  }
+
+protected:
+  GrayTileCodec() {}
+};
+vtkStandardNewMacro(GrayTileCodec)
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileCodec(int, char*[])
+{
+  vtkNew<vtkMapTileCodec> codec;
+
+  // Formats are detected from the content
+  TEST_ASSERT(vtkMapTileCodec::GetImageFormat(TilePNG) ==
+              vtkMapTileCodec::FormatPNG, "PNG not detected");
+  TEST_ASSERT(vtkMapTileCodec::GetImageFormat(TileJPEG) ==
+              vtkMapTileCodec::FormatJPEG, "JPEG not detected");
+  TEST_ASSERT(codec->IsImageComplete(TilePNG, sizeof(TilePNG)),
+              "PNG image incomplete");
+  TEST_ASSERT(codec->IsImageComplete(TileJPEG, sizeof(TileJPEG)),
+              "JPEG image incomplete");
+
+  // Truncated images are rejected
+  TEST_ASSERT(!codec->IsImageComplete(TilePNG, sizeof(TilePNG) - 1),
+              "truncated PNG image accepted");
+  TEST_ASSERT(!codec->IsImageComplete(TileJPEG, sizeof(TileJPEG) - 1),
+              "truncated JPEG image accepted");
+  TEST_ASSERT(!codec->Decode(TileJPEG, sizeof(TileJPEG) - 1),
+              "truncated JPEG image decoded");
+  TEST_ASSERT(!codec->IsImageComplete(TilePNG, 4), "short data accepted");
+
+  // Padding after the JPEG end of image marker is accepted
+  std::vector<unsigned char> padded(TileJPEG, TileJPEG + sizeof(TileJPEG));
+  padded.resize(padded.size() + 4, 0);
+  TEST_ASSERT(codec->IsImageComplete(&padded[0], padded.size()),
+              "padded JPEG image rejected");
+
+  vtkImageData *image = codec->Decode(TilePNG, sizeof(TilePNG));
+  TEST_ASSERT(image, "PNG image not decoded");
+  image->Delete();
+  image = codec->Decode(TileJPEG, sizeof(TileJPEG));
+  TEST_ASSERT(image, "JPEG image not decoded");
+  int dims[3];
+  image->GetDimensions(dims);
+  TEST_ASSERT(dims[0] == 1 && dims[1] == 1,
+              "JPEG image is " << dims[0] << "x" << dims[1]);
+  image->Delete();
+
+  // Other formats are added by subclassing
+  unsigned char grayTile[] = "TILE\x80...ENDTILE!";
+  size_t grayLength = sizeof(grayTile) - 1;
+  TEST_ASSERT(!codec->IsImageComplete(grayTile, grayLength),
+              "unknown format accepted");
+  vtkNew<GrayTileCodec> grayCodec;
+  TEST_ASSERT(grayCodec->IsImageComplete(grayTile, grayLength),
+              "custom format rejected");
+  image = grayCodec->Decode(grayTile, grayLength);
+  TEST_ASSERT(image &&
+              *static_cast<unsigned char*>(image->GetScalarPointer()) == 0x80,
+              "custom format not decoded");
+  image->Delete();
+  TEST_ASSERT(grayCodec->IsImageComplete(TilePNG, sizeof(TilePNG)),
+              "built-in format rejected by subclass");
+
+  // Images with up to 256 colors are indexed
+  vtkNew<vtkImageData> rgba;
+  rgba->SetDimensions(16, 17, 1);
+  rgba->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+  unsigned char *pixel = static_cast<unsigned char*>(rgba->GetScalarPointer());
+  for (int i = 0; i < 16 * 17; ++i, pixel += 4)
+    {
+    pixel[0] = static_cast<unsigned char>(i / 16);
+    pixel[1] = 10;
+    pixel[2] = 20;
+    pixel[3] = static_cast<unsigned char>(i < 16 ? 0 : 255);
+    }
+  vtkImageData *indexed = vtkMapTileCodec::IndexColors(rgba.GetPointer());
+  TEST_ASSERT(indexed && indexed->GetNumberOfScalarComponents() == 1,
+              "image not indexed");
+  vtkLookupTable *colors =
+    indexed->GetPointData()->GetScalars()->GetLookupTable();
+  TEST_ASSERT(colors && colors->GetNumberOfTableValues() == 17,
+              "wrong number of colors");
+  unsigned char index =
+    *static_cast<unsigned char*>(indexed->GetScalarPointer(5, 3, 0));
+  double color[4];
+  colors->GetTableValue(index, color);
+  int rgb[3];
+  for (int c = 0; c < 3; ++c)
+    {
+    rgb[c] = static_cast<int>(color[c] * 255.0 + 0.5);
+    }
+  TEST_ASSERT(rgb[0] == 3 && rgb[1] == 10 && rgb[2] == 20 && color[3] == 1.0,
+              "wrong indexed color");
+
+  // Expanding the indices restores the image, without the alpha
+  // channel if the image is opaque
+  vtkImageData *expanded = vtkMapTileCodec::ExpandColors(indexed);
+  TEST_ASSERT(expanded && expanded->GetNumberOfScalarComponents() == 4 &&
+              memcmp(expanded->GetScalarPointer(), rgba->GetScalarPointer(),
+                     16 * 17 * 4) == 0, "translucent image not restored");
+  expanded->Delete();
+  TEST_ASSERT(!vtkMapTileCodec::ExpandColors(rgba.GetPointer()),
+              "image without colors expanded");
+  indexed->Delete();
+  pixel = static_cast<unsigned char*>(rgba->GetScalarPointer());
+  for (int i = 0; i < 16; ++i, pixel += 4)
+    {
+    pixel[3] = 255;
+    }
+  indexed = vtkMapTileCodec::IndexColors(rgba.GetPointer());
+  expanded = vtkMapTileCodec::ExpandColors(indexed);
+  TEST_ASSERT(expanded && expanded->GetNumberOfScalarComponents() == 3 &&
+              *static_cast<unsigned char*>(
+                expanded->GetScalarPointer(5, 3, 0)) == 3,
+              "opaque image not restored as RGB");
+  expanded->Delete();
+  indexed->Delete();
+
+  pixel = static_cast<unsigned char*>(rgba->GetScalarPointer());
+  for (int i = 0; i < 16 * 17; ++i, pixel += 4)
+    {
+    pixel[1] = static_cast<unsigned char>(i);
+    }
+  TEST_ASSERT(!vtkMapTileCodec::IndexColors(rgba.GetPointer()),
+              "image with more than 256 colors indexed");
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileCodec)
@@ -0,0 +1,148 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileFailureCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMap.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileSource.h"
+#include "vtkOsmLayer.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+//----------------------------------------------------------------------------
+int TestMapTileFailureCache(int, char*[])
+{
+  vtkNew<TestClock> clock;
+  vtkNew<vtkMapTileFailureCache> cache;
+  cache->SetClock(clock.GetPointer());
+  cache->SetInitialRetryDelay(2.0);
+  cache->SetMaxRetryDelay(4.0);
+  cache->SetHostFailureThreshold(3);
+  cache->SetHostRetryDelay(2.0);
+
+  std::string host = vtkMapTileFailureCache::GetHost(
+    "http://tile.openstreetmap.org/1/0/0.png");
+  TEST_ASSERT(host == "tile.openstreetmap.org", "GetHost() returned " << host);
+
+  // Failed tile is backed off, then available again
+  TEST_ASSERT(cache->CanRequest(1, 0, 0, host), "new tile not requestable");
+  cache->RecordFailure(1, 0, 0, host, false);
+  TEST_ASSERT(!cache->CanRequest(1, 0, 0, host), "failed tile not backed off");
+  TEST_ASSERT(cache->CanRequest(1, 1, 0, host), "other tile backed off");
+  clock->Time += 1.9;
+  TEST_ASSERT(!cache->CanRequest(1, 0, 0, host), "backoff expired early");
+  clock->Time += 0.2;
+  TEST_ASSERT(cache->CanRequest(1, 0, 0, host), "backoff did not expire");
+
+  // Second failure doubles the delay
+  cache->RecordFailure(1, 0, 0, host, false);
+  clock->Time += 3.9;
+  TEST_ASSERT(!cache->CanRequest(1, 0, 0, host), "backoff did not double");
+  clock->Time += 0.2;
+  TEST_ASSERT(cache->CanRequest(1, 0, 0, host), "doubled backoff not expired");
+  cache->RecordTileFailure(1, 0, 0);
+  clock->Time += 4.1;
+  TEST_ASSERT(cache->CanRequest(1, 0, 0, host), "backoff exceeds maximum");
+  cache->RecordTileFailure(1, 0, 0);
+  cache->RecordSuccess(1, 0, 0, host);
+  TEST_ASSERT(cache->CanRequest(1, 0, 0, host), "success did not reset");
+
+  // Missing tiles are skipped for the TTL, and don't suspend the host
+  for (int i = 0; i < 5; ++i)
+    {
+    cache->RecordFailure(2, i, 0, host, true);
+    }
+  TEST_ASSERT(!cache->IsTileAvailable(2, 0, 0), "missing tile available");
+  TEST_ASSERT(cache->CanRequest(2, 0, 1, host), "host suspended by 404s");
+
+  // Tiles can be backed off without counting against their host
+  for (int i = 0; i < 3; ++i)
+    {
+    cache->RecordTileFailure(4, i, 0);
+    }
+  TEST_ASSERT(!cache->IsTileAvailable(4, 0, 0), "tile failure not backed off");
+  TEST_ASSERT(cache->CanRequest(4, 0, 1, host), "host suspended by tiles");
+
+  // Consecutive failures suspend the host until a probe is allowed
+  for (int i = 0; i < 3; ++i)
+    {
+    cache->RecordFailure(3, i, 0, host, false);
+    }
+  TEST_ASSERT(!cache->CanRequest(3, 0, 1, host), "host not suspended");
+  TEST_ASSERT(cache->CanRequest(3, 0, 1, "other.host"), "other host suspended");
+  clock->Time += 2.1;
+  TEST_ASSERT(cache->CanRequest(3, 0, 1, host), "probe not allowed");
+  TEST_ASSERT(!cache->CanRequest(3, 0, 2, host), "second probe allowed");
+  cache->RecordSuccess(3, 0, 1, host);
+  TEST_ASSERT(cache->CanRequest(3, 0, 2, host), "host not resumed");
+
+  // A layer whose hosts are all suspended backs off the tiles in view,
+  // rather than requesting them again on every update
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetOffScreenRendering(1);
+  renderWindow->SetSize(256, 256);
+  renderWindow->AddRenderer(renderer.GetPointer());
+  vtkNew<vtkMap> map;
+  map->SetRenderer(renderer.GetPointer());
+  map->SetStorageDirectory(
+    vtksys::SystemTools::GetCurrentWorkingDirectory().c_str());
+  map->SetCenter(0.0, 0.0);
+  map->SetZoom(0);
+
+  vtkNew<vtkMapTileSource> source;
+  source->SetName("TestMapTileFailureCache");
+  source->SetUrlTemplate("http://{s}.tiles.invalid/{z}/{x}/{y}.png");
+  source->RemoveAllSubdomains();
+  source->AddSubdomain("a");
+  source->AddSubdomain("b");
+  vtkNew<vtkOsmLayer> layer;
+  layer->SetTileSource(source.GetPointer());
+  map->AddLayer(layer.GetPointer());
+
+  vtkMapTileFailureCache *layerCache = layer->GetFailureCache();
+  for (int i = 0; i < layerCache->GetHostFailureThreshold(); ++i)
+    {
+    layerCache->RecordFailure(20, i, 0, "a.tiles.invalid", false);
+    layerCache->RecordFailure(20, i, 0, "b.tiles.invalid", false);
+    }
+  map->Draw();
+
+  int backedOff = 0;
+  for (int zoom = 0; zoom <= 3; ++zoom)
+    {
+    for (int x = 0; x < (1 << zoom); ++x)
+      {
+      for (int y = 0; y < (1 << zoom); ++y)
+        {
+        backedOff += layerCache->IsTileAvailable(zoom, x, y) ? 0 : 1;
+        }
+      }
+    }
+  TEST_ASSERT(backedOff > 0, "tiles of suspended hosts not backed off");
+
+  std::cout << "Passed" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileFailureCache)
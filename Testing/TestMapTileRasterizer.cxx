@@ -0,0 +1,159 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileRasterizer.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapMarkerSet.h"
+#include "vtkMapTileRasterizer.h"
+#include "vtkMBTilesTileSource.h"
+#include "vtkMercator.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+const double NewYork[2] = { 40.75, -73.98 };
+const double Paris[2] = { 48.85, 2.35 };
+
+// Returns the pixel of the 256 pixel tile (zoom, x, y) at latitude,
+// longitude, moved up by offset pixels
+unsigned char *GetPixel(vtkImageData *image, int zoom, int x, int y,
+                        const double latLon[2], double offset = 0.0)
+{
+  double scale = ldexp(1.0, zoom) * 256.0 / 360.0;
+  int i = static_cast<int>((latLon[1] + 180.0) * scale - x * 256.0);
+  int row = static_cast<int>(
+    (180.0 - vtkMercator::lat2y(latLon[0])) * scale - y * 256.0 - offset);
+  // Image rows count up from the bottom
+  return static_cast<unsigned char*>(image->GetScalarPointer()) +
+    4 * ((255 - row) * 256 + i);
+}
+
+// Returns the name of tile (zoom, x, y) in directory
+std::string TileFile(const std::string& directory, int zoom, int x, int y)
+{
+  std::stringstream oss;
+  oss << directory << "/" << zoom << "/" << x << "/" << y << ".png";
+  return oss.str();
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileRasterizer(int, char*[])
+{
+  vtkNew<vtkMapMarkerSet> markers;
+  markers->AddMarker(NewYork[0], NewYork[1]);
+  markers->AddMarker(Paris[0], Paris[1]);
+
+  vtkNew<vtkMapTileRasterizer> rasterizer;
+  rasterizer->AddMarkerSet(markers.GetPointer());
+  rasterizer->SetNumberOfThreads(3);
+
+  // Markers are drawn above their point
+  vtkImageData *image = rasterizer->RasterizeTile(0, 0, 0);
+  TEST_ASSERT(image, "no marker in tile 0/0/0");
+  TEST_ASSERT(image->GetDimensions()[0] == 256 &&
+              image->GetNumberOfScalarComponents() == 4,
+              "tile is not a 256 pixel RGBA image");
+  unsigned char *pixel = GetPixel(image, 0, 0, 0, NewYork, 10.0);
+  TEST_ASSERT(pixel[0] == 0 && pixel[1] == 83 && pixel[2] == 155 &&
+              pixel[3] == 255, "marker pixel is " << int(pixel[0]) << " "
+              << int(pixel[1]) << " " << int(pixel[2]) << " "
+              << int(pixel[3]));
+  pixel = GetPixel(image, 0, 0, 0, NewYork, -10.0);
+  TEST_ASSERT(pixel[3] == 0, "pixel below the marker is drawn");
+  image->Delete();
+
+  // Tiles away from the markers have no content
+  TEST_ASSERT(!rasterizer->RasterizeTile(5, 0, 0), "tile 5/0/0 not empty");
+
+  // Directory output: only tiles around the markers are rendered
+  std::string directory =
+    vtksys::SystemTools::GetCurrentWorkingDirectory() +
+    "/TestMapTileRasterizer";
+  vtksys::SystemTools::RemoveADirectory(directory);
+  std::string tiles = directory + "/tiles";
+  rasterizer->SetMaxZoom(8);
+  rasterizer->SetOutputDirectory(tiles.c_str());
+  TEST_ASSERT(rasterizer->Rasterize(), "rasterizing failed");
+  vtkTypeInt64 stored = rasterizer->GetNumberOfStoredTiles();
+  vtkTypeInt64 visited = stored + rasterizer->GetNumberOfEmptyTiles();
+  TEST_ASSERT(stored >= 9 && visited <= 2 * 4 * 9,
+              "stored " << stored << " tiles, visited " << visited);
+  int x = vtkMercator::long2tilex(NewYork[1], 8);
+  int y = vtkMercator::lat2tiley(NewYork[0], 8);
+  TEST_ASSERT(vtksys::SystemTools::FileExists(TileFile(tiles, 8, x, y)),
+              "tile 8/" << x << "/" << y << " not stored");
+  TEST_ASSERT(!vtksys::SystemTools::FileExists(TileFile(tiles, 8, 0, 0)),
+              "tile 8/0/0 stored");
+
+  // Processes share the tiles
+  vtkTypeInt64 shared = 0;
+  rasterizer->SetNumberOfProcesses(3);
+  for (int i = 0; i < 3; ++i)
+    {
+    rasterizer->SetProcessIndex(i);
+    TEST_ASSERT(rasterizer->Rasterize(), "rasterizing process " << i);
+    shared += rasterizer->GetNumberOfStoredTiles();
+    }
+  TEST_ASSERT(shared == stored, "processes stored " << shared << " tiles");
+  rasterizer->SetNumberOfProcesses(1);
+  rasterizer->SetProcessIndex(0);
+
+  // Package output, readable as a tile source
+  std::string package = directory + "/overlay.mbtiles";
+  rasterizer->SetPackageFileName(package.c_str());
+  TEST_ASSERT(rasterizer->Rasterize(), "rasterizing package failed");
+  TEST_ASSERT(rasterizer->GetNumberOfStoredTiles() == stored,
+              "packaged " << rasterizer->GetNumberOfStoredTiles() << " tiles");
+  vtkNew<vtkMBTilesTileSource> packageSource;
+  packageSource->SetFileName(package.c_str());
+  std::vector<unsigned char> data;
+  TEST_ASSERT(packageSource->ReadTileData(8, x, y, data) && !data.empty(),
+              "tile 8/" << x << "/" << y << " not in package");
+  TEST_ASSERT(!packageSource->ReadTileData(8, 0, 0, data),
+              "tile 8/0/0 in package");
+  packageSource->CloseConnections();
+
+  // Nearby markers are drawn as a cluster at low zoom levels
+  vtkNew<vtkMapMarkerSet> clustered;
+  clustered->ClusteringOn();
+  const double Brooklyn[2] = { 40.65, -73.95 };
+  clustered->AddMarker(NewYork[0], NewYork[1]);
+  clustered->AddMarker(Brooklyn[0], Brooklyn[1]);
+  rasterizer->RemoveAllInputs();
+  rasterizer->AddMarkerSet(clustered.GetPointer());
+  image = rasterizer->RasterizeTile(1, 0, 0);
+  TEST_ASSERT(image, "no cluster in tile 1/0/0");
+  pixel = GetPixel(image, 1, 0, 0, NewYork);
+  TEST_ASSERT(pixel[0] == 0 && pixel[1] == 169 && pixel[2] == 179,
+              "cluster pixel is " << int(pixel[0]) << " " << int(pixel[1])
+              << " " << int(pixel[2]));
+  image->Delete();
+
+  vtksys::SystemTools::RemoveADirectory(directory);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileRasterizer)
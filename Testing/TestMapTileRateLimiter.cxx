@@ -0,0 +1,100 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileRateLimiter.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileRateLimiter.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkNew.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+//----------------------------------------------------------------------------
+// Returns the simulated seconds taken by count requests to host
+static double TimeRequests(vtkMapTileRateLimiter *limiter, TestClock *clock,
+                           const char *host, int count)
+{
+  double start = clock->Time;
+  for (int i = 0; i < count; ++i)
+    {
+    limiter->Acquire(host);
+    }
+  return clock->Time - start;
+}
+
+//----------------------------------------------------------------------------
+// Limiter sleeps overshoot by a millisecond
+static bool IsNear(double elapsed, double expected)
+{
+  return fabs(elapsed - expected) < 0.02;
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileRateLimiter(int, char*[])
+{
+  vtkNew<TestClock> clock;
+  vtkNew<vtkMapTileRateLimiter> limiter;
+  limiter->SetClock(clock.GetPointer());
+  TEST_ASSERT(limiter->GetClock() == clock.GetPointer(), "clock not set");
+
+  // No limits
+  limiter->SetRequestsPerSecondPerHost(0.0);
+  double elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(),
+                                "a", 100);
+  TEST_ASSERT(elapsed == 0.0, "unlimited requests took " << elapsed << "s");
+
+  // Burst of 5, then 20 per second
+  limiter->SetRequestsPerSecondPerHost(20.0);
+  limiter->SetBurstDuration(0.25);
+  limiter->Reset();
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "a", 5);
+  TEST_ASSERT(elapsed == 0.0, "burst took " << elapsed << "s");
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "a", 10);
+  TEST_ASSERT(IsNear(elapsed, 0.5),
+              "10 requests at 20/s took " << elapsed << "s");
+
+  // Hosts have separate buckets
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "b", 5);
+  TEST_ASSERT(elapsed == 0.0, "burst on second host took " << elapsed << "s");
+
+  // Requests wait while bytes are in debt
+  limiter->SetRequestsPerSecondPerHost(0.0);
+  limiter->SetMaxBytesPerSecond(1000.0);
+  limiter->SetBurstDuration(1.0);
+  limiter->Reset();
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "a", 1);
+  TEST_ASSERT(elapsed == 0.0, "request within byte budget took "
+              << elapsed << "s");
+  limiter->RecordBytes("b", 1500.0);
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "a", 1);
+  TEST_ASSERT(IsNear(elapsed, 0.5), "request over global byte budget took "
+              << elapsed << "s");
+
+  limiter->SetMaxBytesPerSecond(0.0);
+  limiter->SetBytesPerSecondPerHost(1000.0);
+  limiter->Reset();
+  limiter->RecordBytes("a", 1500.0);
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "b", 1);
+  TEST_ASSERT(elapsed == 0.0, "request to other host took " << elapsed << "s");
+  elapsed = TimeRequests(limiter.GetPointer(), clock.GetPointer(), "a", 1);
+  TEST_ASSERT(IsNear(elapsed, 0.5), "request over host byte budget took "
+              << elapsed << "s");
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileRateLimiter)
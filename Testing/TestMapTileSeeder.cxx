@@ -0,0 +1,138 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileSeeder.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileSeeder.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileSource.h"
+#include "vtkMBTilesTileSource.h"
+#include "vtkMercator.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Set bounds to the center of tile z/x/y
+void GetTileCenter(int zoom, int x, int y, double bounds[4])
+{
+  bounds[0] = bounds[2] = 0.5 * (vtkMercator::tiley2lat(y, zoom) +
+                                 vtkMercator::tiley2lat(y + 1, zoom));
+  bounds[1] = bounds[3] = 0.5 * (vtkMercator::tilex2long(x, zoom) +
+                                 vtkMercator::tilex2long(x + 1, zoom));
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileSeeder(int, char*[])
+{
+  vtkNew<vtkMapTileSeeder> seeder;
+
+  // Tile counts
+  double world[] = {-85.0, -180.0, 85.0, 180.0};
+  seeder->SetBounds(world);
+  seeder->SetMinZoom(0);
+  seeder->SetMaxZoom(2);
+  TEST_ASSERT(seeder->GetNumberOfTiles() == 21,
+              "world has " << seeder->GetNumberOfTiles() << " tiles");
+  double point[] = {42.85, -73.76, 42.85, -73.76};
+  seeder->SetBounds(point);
+  seeder->SetMinZoom(10);
+  seeder->SetMaxZoom(12);
+  TEST_ASSERT(seeder->GetNumberOfTiles() == 3,
+              "point has " << seeder->GetNumberOfTiles() << " tiles");
+
+  // Local tile directory, without tile 1/1/1
+  std::string directory =
+    vtksys::SystemTools::GetCurrentWorkingDirectory() + "/TestMapTileSeeder";
+  vtksys::SystemTools::RemoveADirectory(directory);
+  std::string tiles = directory + "/tiles";
+  WriteTilePNG(tiles, 0, 0, 0);
+  WriteTilePNG(tiles, 1, 0, 0);
+  WriteTilePNG(tiles, 1, 0, 1);
+  WriteTilePNG(tiles, 1, 1, 0);
+
+  vtkMapTileSource *source = seeder->GetTileSource();
+  source->SetUrlTemplate(("file://" + tiles + "/{z}/{x}/{y}.png").c_str());
+  source->RemoveAllSubdomains();
+  seeder->SetBounds(world);
+  seeder->SetMinZoom(0);
+  seeder->SetMaxZoom(1);
+  seeder->SetMaxRequestsPerSecond(0.0);
+  seeder->SetMaxAttempts(1);
+
+  // Pack the directory
+  std::string package = directory + "/tiles.mbtiles";
+  seeder->SetPackageFileName(package.c_str());
+  TEST_ASSERT(seeder->Seed(), "seeding package failed");
+  TEST_ASSERT(seeder->GetNumberOfDownloadedTiles() == 4 &&
+              seeder->GetNumberOfFailedTiles() == 1,
+              "seeded " << seeder->GetNumberOfDownloadedTiles()
+              << " tiles, " << seeder->GetNumberOfFailedTiles() << " failed");
+
+  vtkNew<vtkMBTilesTileSource> packageSource;
+  packageSource->SetFileName(package.c_str());
+  std::vector<unsigned char> data;
+  TEST_ASSERT(packageSource->ReadTileData(1, 0, 1, data) &&
+              data.size() == sizeof(TilePNG), "tile 1/0/1 not in package");
+  TEST_ASSERT(!packageSource->ReadTileData(1, 1, 1, data),
+              "tile 1/1/1 in package");
+  packageSource->CloseConnections();
+
+  // Resume skips stored tiles
+  TEST_ASSERT(seeder->Seed(), "resuming package failed");
+  TEST_ASSERT(seeder->GetNumberOfSkippedTiles() == 4 &&
+              seeder->GetNumberOfDownloadedTiles() == 0,
+              "resume skipped " << seeder->GetNumberOfSkippedTiles()
+              << " tiles");
+
+  // Fill a cache directory
+  std::string cache = directory + "/cache";
+  seeder->SetPackageFileName(NULL);
+  seeder->SetCacheDirectory(cache.c_str());
+  TEST_ASSERT(seeder->Seed(), "seeding cache failed");
+  TEST_ASSERT(seeder->GetNumberOfDownloadedTiles() == 4,
+              "cached " << seeder->GetNumberOfDownloadedTiles() << " tiles");
+  std::string cached = source->GetCacheTileFile(cache.c_str(), 1, 1, 0);
+  TEST_ASSERT(vtkMapTile::IsImageFileValid(cached.c_str()),
+              "tile 1/1/0 not cached");
+
+  // Tiles with the same digits, 11/12/3 and 11/1/23, are cached apart
+  WriteTilePNG(tiles, 11, 12, 3);
+  double bounds[4];
+  GetTileCenter(11, 12, 3, bounds);
+  seeder->SetBounds(bounds);
+  seeder->SetMinZoom(11);
+  seeder->SetMaxZoom(11);
+  TEST_ASSERT(seeder->Seed() && seeder->GetNumberOfDownloadedTiles() == 1,
+              "tile 11/12/3 not cached");
+  GetTileCenter(11, 1, 23, bounds);
+  seeder->SetBounds(bounds);
+  TEST_ASSERT(seeder->Seed(), "seeding tile 11/1/23 failed");
+  TEST_ASSERT(seeder->GetNumberOfSkippedTiles() == 0 &&
+              seeder->GetNumberOfFailedTiles() == 1,
+              "tile 11/1/23 skipped as cached");
+
+  vtksys::SystemTools::RemoveADirectory(directory);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileSeeder)
@@ -0,0 +1,312 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileService.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMap.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileCodec.h"
+#include "vtkMapTileService.h"
+#include "vtkMapTileSource.h"
+#include "vtkMultiThreadedOsmLayer.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkCamera.h>
+#include <vtkImageData.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// Codec counting its decodes, slow enough for requests to be in
+// progress while the test changes the layers
+class CountingCodec : public vtkMapTileCodec
+{
+public:
+  static CountingCodec *New();
+  vtkTypeMacro(CountingCodec, vtkMapTileCodec)
+
+  virtual vtkImageData *Decode(const unsigned char *data, size_t length)
+  {
+    this->Lock->Lock();
+    this->NumberOfDecodes++;
+    this->Lock->Unlock();
+    vtksys::SystemTools::Delay(20);
+    return this->Superclass::Decode(data, length);
+  }
+
+  int GetNumberOfDecodes()
+  {
+    this->Lock->Lock();
+    int count = this->NumberOfDecodes;
+    this->Lock->Unlock();
+    return count;
+  }
+
+protected:
+  CountingCodec() : NumberOfDecodes(0) { this->Lock = vtkMutexLock::New(); }
+  ~CountingCodec() { this->Lock->Delete(); }
+
+  int NumberOfDecodes;
+  vtkMutexLock *Lock;
+};
+vtkStandardNewMacro(CountingCodec)
+
+//----------------------------------------------------------------------------
+// Layer listing the image sources of its cached tiles
+class TestLayer : public vtkMultiThreadedOsmLayer
+{
+public:
+  static TestLayer *New();
+  vtkTypeMacro(TestLayer, vtkMultiThreadedOsmLayer)
+
+  void GetTileSources(std::set<std::string>& sources)
+  {
+    for (size_t i = 0; i < this->CachedTiles.size(); ++i)
+      {
+      sources.insert(this->CachedTiles[i]->GetImageSource());
+      }
+  }
+};
+vtkStandardNewMacro(TestLayer)
+
+namespace
+{
+// Returns true if service has an image for key
+bool HasImage(vtkMapTileService *service, const std::string& key)
+{
+  vtkImageData *image = service->GetImage(key);
+  if (image)
+    {
+    image->Delete();
+    }
+  return image != NULL;
+}
+
+// Wait (up to 30 s) until the tile service resolved the requests of layer
+bool WaitForTiles(vtkMultiThreadedOsmLayer *layer)
+{
+  vtkMapTileService *service = layer->GetTileService();
+  for (int i = 0; i < 3000 && service->GetNumberOfPendingTiles(layer); ++i)
+    {
+    vtksys::SystemTools::Delay(10);
+    }
+  return service->GetNumberOfPendingTiles(layer) == 0;
+}
+
+// Wait (up to 30 s) until codec decoded more than count images
+bool WaitForDecodes(CountingCodec *codec, int count)
+{
+  for (int i = 0; i < 3000 && codec->GetNumberOfDecodes() <= count; ++i)
+    {
+    vtksys::SystemTools::Delay(10);
+    }
+  return codec->GetNumberOfDecodes() > count;
+}
+
+// Returns true if a cached tile of layer comes from urlTemplate
+bool HasTilesFrom(TestLayer *layer, const std::string& urlTemplate)
+{
+  std::string prefix = urlTemplate.substr(0, urlTemplate.find('{'));
+  std::set<std::string> sources;
+  layer->GetTileSources(sources);
+  std::set<std::string>::iterator iter = sources.begin();
+  for (; iter != sources.end(); iter++)
+    {
+    if (iter->compare(0, prefix.size(), prefix) == 0)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+}
+
+//----------------------------------------------------------------------------
+int TestMapTileService(int, char*[])
+{
+  vtkNew<vtkMapTileService> service;
+  service->SetMaxNumberOfImages(2);
+
+  // Images added first are kept
+  vtkNew<vtkImageData> image1;
+  vtkNew<vtkImageData> image2;
+  vtkImageData *cached = service->AddImage("a", image1.GetPointer());
+  TEST_ASSERT(cached == image1.GetPointer(), "image a not added");
+  cached->Delete();
+  cached = service->AddImage("a", image2.GetPointer());
+  TEST_ASSERT(cached == image1.GetPointer(), "image a replaced");
+  cached->Delete();
+
+  // Least recently used images are dropped
+  service->AddImage("b", image2.GetPointer())->Delete();
+  TEST_ASSERT(HasImage(service.GetPointer(), "a"), "image a dropped");
+  service->AddImage("c", image2.GetPointer())->Delete();
+  TEST_ASSERT(service->GetNumberOfImages() == 2,
+              service->GetNumberOfImages() << " images cached");
+  TEST_ASSERT(HasImage(service.GetPointer(), "a") &&
+              !HasImage(service.GetPointer(), "b") &&
+              HasImage(service.GetPointer(), "c"),
+              "wrong image dropped");
+
+  service->ClearImages();
+  TEST_ASSERT(service->GetNumberOfImages() == 0, "images not cleared");
+
+  // Image files are decoded once
+  std::string filename =
+    vtksys::SystemTools::GetCurrentWorkingDirectory() + "/TestMapTileService.png";
+  std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+  file.write(reinterpret_cast<const char*>(TilePNG), sizeof(TilePNG));
+  file.close();
+  vtkImageData *loaded1 = service->LoadImageFile(filename);
+  vtkImageData *loaded2 = service->LoadImageFile(filename);
+  TEST_ASSERT(loaded1 && loaded1 == loaded2, "image file decoded twice");
+  loaded1->Delete();
+  loaded2->Delete();
+
+  // Expanded images replace the indexed ones in the cache
+  service->ClearImages();
+  vtkImageData *indexed = service->LoadImageFile(filename, NULL, true);
+  TEST_ASSERT(indexed && indexed->GetNumberOfScalarComponents() == 1,
+              "image file not indexed");
+  vtkImageData *expanded = service->ExpandImage(filename, indexed);
+  TEST_ASSERT(expanded && expanded->GetNumberOfScalarComponents() >= 3,
+              "indexed image not expanded");
+  cached = service->GetImage(filename);
+  TEST_ASSERT(cached == expanded, "expanded image not shared with the cache");
+  cached->Delete();
+  cached = service->ExpandImage(filename, expanded);
+  TEST_ASSERT(cached == expanded, "expanded image expanded again");
+  cached->Delete();
+  expanded->Delete();
+  indexed->Delete();
+
+  // Invalid files are not cached
+  file.open(filename.c_str(), std::ios::out | std::ios::binary);
+  file.write(reinterpret_cast<const char*>(TilePNG), sizeof(TilePNG) - 8);
+  file.close();
+  service->ClearImages();
+  TEST_ASSERT(!service->LoadImageFile(filename), "truncated image decoded");
+  TEST_ASSERT(service->GetNumberOfImages() == 0, "truncated image cached");
+
+  vtksys::SystemTools::RemoveFile(filename);
+
+  // Two layers sharing a service, showing local tiles
+  std::string directory =
+    vtksys::SystemTools::GetCurrentWorkingDirectory() + "/TestMapTileService";
+  vtksys::SystemTools::RemoveADirectory(directory);
+  for (int zoom = 0; zoom <= 4; ++zoom)
+    {
+    for (int x = 0; x < (1 << zoom); ++x)
+      {
+      for (int y = 0; y < (1 << zoom); ++y)
+        {
+        WriteTilePNG(directory + "/a", zoom, x, y);
+        WriteTilePNG(directory + "/b", zoom, x, y);
+        }
+      }
+    }
+  std::string templateA = "file://" + directory + "/a/{z}/{x}/{y}.png";
+  std::string templateB = "file://" + directory + "/b/{z}/{x}/{y}.png";
+  vtkNew<CountingCodec> codecA;
+  vtkNew<vtkMapTileSource> sourceA;
+  sourceA->SetName("TestMapTileServiceA");
+  sourceA->SetUrlTemplate(templateA.c_str());
+  sourceA->SetCodec(codecA.GetPointer());
+  vtkNew<vtkMapTileSource> sourceB;
+  sourceB->SetName("TestMapTileServiceB");
+  sourceB->SetUrlTemplate(templateB.c_str());
+
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetOffScreenRendering(1);
+  renderWindow->SetSize(256, 256);
+  renderWindow->AddRenderer(renderer.GetPointer());
+  vtkNew<vtkMap> map;
+  map->SetRenderer(renderer.GetPointer());
+  map->SetStorageDirectory(directory.c_str());
+  map->SetCenter(0.0, 0.0);
+  map->SetZoom(0);
+
+  vtkNew<TestLayer> layer1;
+  layer1->SetTileSource(sourceA.GetPointer());
+  vtkNew<TestLayer> layer2;
+  layer2->SetTileSource(sourceA.GetPointer());
+  layer2->SetTileService(layer1->GetTileService());
+  map->AddLayer(layer1.GetPointer());
+  map->AddLayer(layer2.GetPointer());
+
+  // Tiles requested by both layers are decoded once
+  map->Draw();
+  TEST_ASSERT(WaitForTiles(layer1.GetPointer()) &&
+              WaitForTiles(layer2.GetPointer()), "tiles not resolved");
+  layer1->ResolveAsync();
+  layer2->ResolveAsync();
+  std::set<std::string> sources1;
+  std::set<std::string> sources2;
+  layer1->GetTileSources(sources1);
+  layer2->GetTileSources(sources2);
+  TEST_ASSERT(!sources1.empty() && sources1 == sources2,
+              "layers have " << sources1.size() << " and " << sources2.size()
+              << " tiles");
+  TEST_ASSERT(codecA->GetNumberOfDecodes() == static_cast<int>(sources1.size()),
+              codecA->GetNumberOfDecodes() << " decodes for "
+              << sources1.size() << " tiles");
+
+  // A canceled layer gets no tiles once CancelRequests() returns
+  double bounds[4] = { -20.0, -20.0, 20.0, 20.0 };
+  map->SetVisibleBounds(bounds);
+  int decodes = codecA->GetNumberOfDecodes();
+  map->Draw();
+  TEST_ASSERT(WaitForDecodes(codecA.GetPointer(), decodes),
+              "zoomed in tiles not requested");
+  layer2->GetTileService()->CancelRequests(layer2.GetPointer());
+  TEST_ASSERT(layer2->GetTileService()->GetNumberOfPendingTiles(
+                layer2.GetPointer()) == 0, "canceled tiles pending");
+  layer2->ResolveAsync();
+  TEST_ASSERT(WaitForTiles(layer1.GetPointer()), "tiles not resolved");
+  layer1->ResolveAsync();
+  vtksys::SystemTools::Delay(100);
+  TEST_ASSERT(layer2->ResolveAsync() == vtkMap::AsyncIdle,
+              "canceled layer got tiles");
+
+  // Tiles resolved for the previous source are dropped, even if they
+  // are waiting to be added to the cache
+  renderer->GetActiveCamera()->Dolly(2.0);
+  map->Draw();
+  TEST_ASSERT(WaitForTiles(layer1.GetPointer()), "tiles not resolved");
+  layer1->SetTileSource(sourceB.GetPointer());
+  map->Draw();
+  TEST_ASSERT(WaitForTiles(layer1.GetPointer()), "tiles not resolved");
+  layer1->ResolveAsync();
+  TEST_ASSERT(HasTilesFrom(layer1.GetPointer(), templateB),
+              "no tiles from the new source");
+  TEST_ASSERT(!HasTilesFrom(layer1.GetPointer(), templateA),
+              "tiles from the previous source");
+
+  vtksys::SystemTools::RemoveADirectory(directory);
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileService)
@@ -0,0 +1,75 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMapTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileSource.h"
+#include "vtkMapTestUtilities.h"
+
+#include <vtkNew.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <string>
+
+//----------------------------------------------------------------------------
+int TestMapTileSource(int, char*[])
+{
+  vtkNew<vtkMapTileSource> source;
+
+  // Default is OpenStreetMap, rotated across 3 subdomains
+  TEST_ASSERT(std::string(source->GetName()) == "osm", "default name");
+  TEST_ASSERT(!source->IsLocal(), "default source is local");
+  TEST_ASSERT(source->GetNumberOfSubdomains() == 3, "default subdomains");
+  std::string url = source->GetTileUrl(3, 4, 5, 1);
+  TEST_ASSERT(url == "http://b.tile.openstreetmap.org/3/4/5.png",
+              "GetTileUrl() returned " << url);
+
+  std::set<int> indices;
+  for (int i = 0; i < 3; ++i)
+    {
+    indices.insert(source->GetNextSubdomainIndex());
+    }
+  TEST_ASSERT(indices.size() == 3, "subdomains not rotated");
+
+  // Custom template, placeholders may repeat
+  source->SetUrlTemplate("https://{s}.example.com/tiles/{z}/{x}/{y}@{z}.jpg");
+  source->RemoveAllSubdomains();
+  source->AddSubdomain("mirror1");
+  source->AddSubdomain("mirror2");
+  url = source->GetTileUrl(12, 1205, 1539, 3);
+  TEST_ASSERT(url == "https://mirror2.example.com/tiles/12/1205/1539@12.jpg",
+              "GetTileUrl() returned " << url);
+
+  // No subdomains
+  source->RemoveAllSubdomains();
+  source->SetUrlTemplate("http://tiles.internal/{z}/{x}/{y}.png");
+  TEST_ASSERT(source->GetNextSubdomainIndex() == 0, "subdomain index");
+  url = source->GetTileUrl(0, 0, 0, source->GetNextSubdomainIndex());
+  TEST_ASSERT(url == "http://tiles.internal/0/0/0.png",
+              "GetTileUrl() returned " << url);
+
+  // Local files
+  source->SetUrlTemplate("file:///data/tiles/{z}/{x}/{y}.png");
+  TEST_ASSERT(source->IsLocal(), "file:// source not local");
+  std::string file = source->GetLocalTileFile(2, 1, 3);
+  TEST_ASSERT(file == "/data/tiles/2/1/3.png",
+              "GetLocalTileFile() returned " << file);
+
+  std::cout << "Passed" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMapTileSource)
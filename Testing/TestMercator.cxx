@@ -0,0 +1,110 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    TestMercator.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include <vtkObject.h>
+#include "vtkMercator.h"
+#include "vtkMapTestUtilities.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+// Web Mercator latitude limit, and its Mercator y
+const double MaxLatitude = 85.0511287798;
+const double MaxY = 180.0;
+
+// Meters per degree of latitude, and the 1 cm error bound in degrees
+const double MetersPerDegree = 111319.49;
+const double MaxError = 0.01 / MetersPerDegree;
+}
+
+//----------------------------------------------------------------------------
+int TestMercator(int, char*[])
+{
+  // Latitudes across the whole map, including the limits and the equator
+  const vtkIdType n = 100001;
+  std::vector<double> lat(n);
+  std::vector<double> y(n);
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    lat[i] = -MaxLatitude + 2.0 * MaxLatitude * i / (n - 1);
+    }
+  vtkMercator::lat2y(&lat[0], &y[0], n);
+
+  // Errors in y are scaled by cos(latitude) on the ground
+  double maxError = 0.0;
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    double error = fabs(y[i] - vtkMercator::lat2y(lat[i])) *
+      cos(lat[i] * 3.14159265358979323846 / 180.0);
+    maxError = std::max(maxError, error);
+    }
+  TEST_ASSERT(maxError < MaxError,
+              "lat2y error " << maxError * MetersPerDegree << " m");
+
+  // Inverse, in place
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    y[i] = -MaxY + 2.0 * MaxY * i / (n - 1);
+    }
+  std::vector<double> expected(n);
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    expected[i] = vtkMercator::y2lat(y[i]);
+    }
+  vtkMercator::y2lat(&y[0], &y[0], n);
+  maxError = 0.0;
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    maxError = std::max(maxError, fabs(y[i] - expected[i]));
+    }
+  TEST_ASSERT(maxError < MaxError,
+              "y2lat error " << maxError * MetersPerDegree << " m");
+
+  // Tile indices match the scalar functions at all zoom levels
+  std::vector<double> lon(n);
+  for (vtkIdType i = 0; i < n; ++i)
+    {
+    lon[i] = -180.0 + 360.0 * i / n;
+    }
+  std::vector<int> tileX(n);
+  std::vector<int> tileY(n);
+  for (int zoom = 0; zoom <= 20; ++zoom)
+    {
+    vtkMercator::long2tilex(&lon[0], &tileX[0], n, zoom);
+    vtkMercator::lat2tiley(&lat[0], &tileY[0], n, zoom);
+    int mismatches = 0;
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      mismatches += tileX[i] != vtkMercator::long2tilex(lon[i], zoom);
+      mismatches += tileY[i] != vtkMercator::lat2tiley(lat[i], zoom);
+      }
+    TEST_ASSERT(mismatches == 0,
+                mismatches << " tile index mismatches at zoom " << zoom);
+    }
+
+  TEST_ASSERT(vtkMercator::tilex2long(3, 2) == 90.0, "tilex2long");
+  TEST_ASSERT(fabs(vtkMercator::tiley2lat(0, 0) - MaxLatitude) < 1e-9,
+              "tiley2lat");
+
+  return EXIT_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+VTKMAP_TEST_MAIN(TestMercator)
@@ -0,0 +1,87 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTestUtilities.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// Checks, entry point and data shared by the tests. A test defines
+// int TestName(int, char*[]), returning EXIT_SUCCESS or EXIT_FAILURE,
+// and adds VTKMAP_TEST_MAIN(TestName) to run it as the executable.
+
+#ifndef __vtkMapTestUtilities_h
+#define __vtkMapTestUtilities_h
+
+#include "vtkMapTileClock.h"
+
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Fail the test with message (streamed to std::cerr) unless condition holds
+#define TEST_ASSERT(condition, message) \
+  if (!(condition)) \
+    { \
+    std::cerr << "FAILED: " << message << std::endl; \
+    return EXIT_FAILURE; \
+    }
+
+#define VTKMAP_TEST_MAIN(test) \
+  int main(int argc, char *argv[]) \
+  { \
+    return test(argc, argv); \
+  }
+
+// 1x1 pixel PNG image
+static const unsigned char TilePNG[] =
+  {
+  0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+  0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+  0x08, 0x02, 0x00, 0x00, 0x00, 0x90, 0x77, 0x53, 0xde, 0x00, 0x00, 0x00,
+  0x0c, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9c, 0x63, 0xf8, 0xcf, 0xc0, 0x00,
+  0x00, 0x03, 0x01, 0x01, 0x00, 0xc9, 0xfe, 0x92, 0xef, 0x00, 0x00, 0x00,
+  0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+  };
+
+// Write TilePNG as tile z/x/y.png in directory
+inline void WriteTilePNG(const std::string& directory, int zoom, int x, int y)
+{
+  std::stringstream oss;
+  oss << directory << "/" << zoom << "/" << x;
+  vtksys::SystemTools::MakeDirectory(oss.str());
+  oss << "/" << y << ".png";
+  std::ofstream file(oss.str().c_str(), std::ios::out | std::ios::binary);
+  file.write(reinterpret_cast<const char*>(TilePNG), sizeof(TilePNG));
+}
+
+// Simulated time for vtkMapTileRateLimiter and vtkMapTileFailureCache,
+// advanced by the test or by the limiter's waits
+class TestClock : public vtkMapTileClock
+{
+public:
+  static TestClock *New();
+  vtkTypeMacro(TestClock, vtkMapTileClock)
+
+  virtual double GetTime() { return this->Time; }
+  virtual void Sleep(double seconds) { this->Time += seconds; }
+
+  double Time;
+
+protected:
+  TestClock() : Time(1000.0) {}
+};
+vtkStandardNewMacro(TestClock)
+
+#endif // __vtkMapTestUtilities_h
@@ -0,0 +1,215 @@
+// vtkmap-rasterize: render map overlays into image tiles
+//
+// Renders markers and GeoJSON features into transparent PNG tiles, for
+// web clients to draw over their base map. Tiles are written to a
+// <zoom>/<x>/<y>.png directory or to an MBTiles package; tiles without
+// content are not written. Marker files hold one "LAT LON" (or
+// "LAT,LON") pair per line.
+//
+// Rendering runs on all cores, and can be split between worker
+// processes, which write to the same directory or package.
+
+#include "vtkFeatureLayer.h"
+#include "vtkGeoJSONMapFeature.h"
+#include "vtkMap.h"
+#include "vtkMapMarkerSet.h"
+#include "vtkMapTileRasterizer.h"
+#include "workers.h"
+
+#include <vtkNew.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+static void PrintUsage(const char *program)
+{
+  std::cerr
+    << "Usage: " << program
+    << " (--markers FILE | --geojson FILE)... --zoom MIN MAX"
+    << " (--output DIR | --mbtiles FILE) [options]\n"
+    << "\n"
+    << "Zoom levels are tile zoom levels. The level vtkOsmLayer\n"
+    << "displays at a vtkMap zoom depends on the screen resolution\n"
+    << "and the tile size.\n"
+    << "\n"
+    << "Options:\n"
+    << "  --clustering       draw nearby markers as clusters\n"
+    << "  --tile-size N      tile width and height in pixels"
+    << " (default 256)\n"
+    << "  --name NAME        tile set name, stored in packages"
+    << " (default overlay)\n"
+    << "  --threads N        rendering threads per process"
+    << " (default: number of cores)\n"
+    << "  --processes N      number of worker processes (default 1)\n";
+}
+
+//----------------------------------------------------------------------------
+// Add the markers listed in filename to markerSet
+static bool AddMarkers(vtkMapMarkerSet *markerSet, const std::string& filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read " << filename << std::endl;
+    return false;
+    }
+
+  std::string line;
+  while (std::getline(file, line))
+    {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream iss(line);
+    double latitude, longitude;
+    if (iss >> latitude >> longitude)
+      {
+      markerSet->AddMarker(latitude, longitude);
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  vtkNew<vtkMapTileRasterizer> rasterizer;
+  vtkNew<vtkMapMarkerSet> markerSet;
+
+  std::vector<std::string> markerFiles;
+  std::vector<std::string> geojsonFiles;
+  bool hasZoom = false;
+  int processes = 1;
+  int worker = -1;
+
+  // Workers are run with the same arguments, and their index
+  std::vector<std::string> args(1, argv[0]);
+  for (int i = 1; i < argc; ++i)
+    {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    int start = i;
+    if (arg == "--worker" && hasValue)
+      {
+      worker = atoi(argv[++i]);
+      continue;
+      }
+    else if (arg == "--processes" && hasValue)
+      {
+      processes = std::max(1, atoi(argv[++i]));
+      continue;
+      }
+    else if (arg == "--markers" && hasValue)
+      {
+      markerFiles.push_back(argv[++i]);
+      }
+    else if (arg == "--geojson" && hasValue)
+      {
+      geojsonFiles.push_back(argv[++i]);
+      }
+    else if (arg == "--clustering")
+      {
+      markerSet->ClusteringOn();
+      }
+    else if (arg == "--zoom" && i + 2 < argc)
+      {
+      rasterizer->SetMinZoom(atoi(argv[++i]));
+      rasterizer->SetMaxZoom(atoi(argv[++i]));
+      hasZoom = true;
+      }
+    else if (arg == "--output" && hasValue)
+      {
+      rasterizer->SetOutputDirectory(argv[++i]);
+      }
+    else if (arg == "--mbtiles" && hasValue)
+      {
+      rasterizer->SetPackageFileName(argv[++i]);
+      }
+    else if (arg == "--tile-size" && hasValue)
+      {
+      rasterizer->SetTileSize(atoi(argv[++i]));
+      }
+    else if (arg == "--name" && hasValue)
+      {
+      rasterizer->SetName(argv[++i]);
+      }
+    else if (arg == "--threads" && hasValue)
+      {
+      rasterizer->SetNumberOfThreads(atoi(argv[++i]));
+      }
+    else
+      {
+      std::cerr << "Invalid argument " << arg << "\n\n";
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+      }
+    args.insert(args.end(), argv + start, argv + i + 1);
+    }
+
+  if (!hasZoom || (markerFiles.empty() && geojsonFiles.empty()) ||
+      (!rasterizer->GetOutputDirectory() && !rasterizer->GetPackageFileName()))
+    {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+    }
+
+  // Split the pyramid between the workers
+  if (worker < 0 && processes > 1)
+    {
+    return RunWorkers(args, processes) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  if (worker >= 0)
+    {
+    rasterizer->SetNumberOfProcesses(processes);
+    rasterizer->SetProcessIndex(worker);
+    }
+
+  for (size_t i = 0; i < markerFiles.size(); ++i)
+    {
+    if (!AddMarkers(markerSet.GetPointer(), markerFiles[i]))
+      {
+      return EXIT_FAILURE;
+      }
+    }
+  rasterizer->AddMarkerSet(markerSet.GetPointer());
+
+  // Features are added to a map layer, which needs a renderer,
+  // but nothing is drawn with OpenGL
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkMap> map;
+  map->SetRenderer(renderer.GetPointer());
+  vtkNew<vtkFeatureLayer> featureLayer;
+  featureLayer->SetName("geojson");
+  map->AddLayer(featureLayer.GetPointer());
+  for (size_t i = 0; i < geojsonFiles.size(); ++i)
+    {
+    std::ifstream file(geojsonFiles[i].c_str());
+    if (!file)
+      {
+      std::cerr << "Cannot read " << geojsonFiles[i] << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::stringstream content;
+    content << file.rdbuf();
+    vtkNew<vtkGeoJSONMapFeature> feature;
+    feature->SetInputString(content.str().c_str());
+    featureLayer->AddFeature(feature.GetPointer());
+    }
+  rasterizer->AddFeatureLayer(featureLayer.GetPointer());
+
+  bool ok = rasterizer->Rasterize();
+  if (worker >= 0)
+    {
+    std::cout << "Worker " << worker << ": ";
+    }
+  std::cout << rasterizer->GetNumberOfStoredTiles() << " tiles stored, "
+            << rasterizer->GetNumberOfEmptyTiles() << " empty, "
+            << rasterizer->GetNumberOfFailedTiles() << " failed"
+            << std::endl;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
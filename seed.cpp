@@ -0,0 +1,185 @@
+// vtkmap-seed: download map tiles for offline use
+//
+// Fills a vtkMap tile cache directory, or an MBTiles package, with the
+// tiles covering a lat-lon bounding box over a range of zoom levels.
+// Tiles already stored are skipped, so an interrupted run is resumed
+// by running the same command again.
+
+#include "vtkMapTileSeeder.h"
+#include "vtkMapTileSource.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkNew.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+//----------------------------------------------------------------------------
+static void PrintUsage(const char *program)
+{
+  std::cerr
+    << "Usage: " << program
+    << " --bounds LAT1 LON1 LAT2 LON2 --zoom MIN MAX [options]\n"
+    << "\n"
+    << "Zoom levels are tile zoom levels. The level vtkOsmLayer\n"
+    << "displays at a vtkMap zoom depends on the screen resolution\n"
+    << "and the tile size.\n"
+    << "\n"
+    << "Options:\n"
+    << "  --cache DIR        tile cache directory"
+    << " (default ~/.vtkmap/NAME)\n"
+    << "  --mbtiles FILE     write an MBTiles package instead\n"
+    << "  --url TEMPLATE     tile url with {z} {x} {y} and {s} placeholders\n"
+    << "                     (default OpenStreetMap)\n"
+    << "  --subdomains LIST  comma-separated values for {s}"
+    << " (default a,b,c)\n"
+    << "  --name NAME        tile source name (default osm)\n"
+    << "  --threads N        number of download threads (default 6)\n"
+    << "  --rate N           max requests per second, 0 for no limit"
+    << " (default 2)\n"
+    << "  --dry-run          print the number of tiles and exit\n";
+}
+
+//----------------------------------------------------------------------------
+static void ProgressCallback(vtkObject *caller, unsigned long, void *,
+                             void *callData)
+{
+  vtkMapTileSeeder *seeder = vtkMapTileSeeder::SafeDownCast(caller);
+  double progress = *static_cast<double*>(callData);
+  std::cout << "\r" << static_cast<int>(100.0 * progress) << "%  "
+            << seeder->GetNumberOfDownloadedTiles() << " downloaded, "
+            << seeder->GetNumberOfSkippedTiles() << " skipped, "
+            << seeder->GetNumberOfMissingTiles() << " missing, "
+            << seeder->GetNumberOfFailedTiles() << " failed   "
+            << std::flush;
+}
+
+//----------------------------------------------------------------------------
+// Parse count numbers following argument i into values
+static bool ParseNumbers(int argc, char *argv[], int& i, int count,
+                         double *values)
+{
+  if (i + count >= argc)
+    {
+    return false;
+    }
+  for (int k = 0; k < count; ++k)
+    {
+    std::istringstream iss(argv[++i]);
+    if (!(iss >> values[k]))
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  vtkNew<vtkMapTileSeeder> seeder;
+  vtkMapTileSource *source = seeder->GetTileSource();
+
+  bool hasBounds = false;
+  bool hasZoom = false;
+  bool dryRun = false;
+  std::string cacheDirectory;
+  for (int i = 1; i < argc; ++i)
+    {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    double values[4];
+    if (arg == "--bounds" && ParseNumbers(argc, argv, i, 4, values))
+      {
+      seeder->SetBounds(values);
+      hasBounds = true;
+      }
+    else if (arg == "--zoom" && ParseNumbers(argc, argv, i, 2, values))
+      {
+      seeder->SetMinZoom(static_cast<int>(values[0]));
+      seeder->SetMaxZoom(static_cast<int>(values[1]));
+      hasZoom = true;
+      }
+    else if (arg == "--threads" && ParseNumbers(argc, argv, i, 1, values))
+      {
+      seeder->SetNumberOfThreads(static_cast<int>(values[0]));
+      }
+    else if (arg == "--rate" && ParseNumbers(argc, argv, i, 1, values))
+      {
+      seeder->SetMaxRequestsPerSecond(values[0]);
+      }
+    else if (arg == "--cache" && hasValue)
+      {
+      cacheDirectory = argv[++i];
+      }
+    else if (arg == "--mbtiles" && hasValue)
+      {
+      seeder->SetPackageFileName(argv[++i]);
+      }
+    else if (arg == "--url" && hasValue)
+      {
+      source->SetUrlTemplate(argv[++i]);
+      }
+    else if (arg == "--subdomains" && hasValue)
+      {
+      source->RemoveAllSubdomains();
+      std::istringstream iss(argv[++i]);
+      std::string subdomain;
+      while (std::getline(iss, subdomain, ','))
+        {
+        source->AddSubdomain(subdomain);
+        }
+      }
+    else if (arg == "--name" && hasValue)
+      {
+      source->SetName(argv[++i]);
+      }
+    else if (arg == "--dry-run")
+      {
+      dryRun = true;
+      }
+    else
+      {
+      std::cerr << "Invalid argument " << arg << "\n\n";
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+      }
+    }
+
+  if (!hasBounds || !hasZoom || seeder->GetMinZoom() > seeder->GetMaxZoom())
+    {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+    }
+
+  // Default to the cache directory used by vtkMap and vtkOsmLayer
+  if (cacheDirectory.empty())
+    {
+    cacheDirectory = vtksys::SystemTools::CollapseFullPath(
+      std::string(".vtkmap/") + source->GetName(), "~/");
+    }
+  seeder->SetCacheDirectory(cacheDirectory.c_str());
+
+  std::cout << "Seeding " << seeder->GetNumberOfTiles() << " tiles into "
+            << (seeder->GetPackageFileName() ?
+                seeder->GetPackageFileName() : cacheDirectory.c_str())
+            << std::endl;
+  if (dryRun)
+    {
+    return EXIT_SUCCESS;
+    }
+
+  vtkNew<vtkCallbackCommand> progressCommand;
+  progressCommand->SetCallback(ProgressCallback);
+  seeder->AddObserver(vtkCommand::ProgressEvent,
+                      progressCommand.GetPointer());
+  bool ok = seeder->Seed();
+  std::cout << std::endl;
+
+  return ok && seeder->GetNumberOfFailedTiles() == 0 ?
+    EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,331 @@
+// vtkmap-snapshot: render map images without a window
+//
+// Renders a list of views of the map to PNG files, offscreen, e.g. to
+// generate report thumbnails on a server. Each line of the list file
+// describes one image:
+//
+//   LAT LON ZOOM WIDTH HEIGHT OUTPUT.png [markers=FILE] [geojson=FILE,...]
+//
+// ZOOM may be fractional. Marker files hold one "LAT LON" (or
+// "LAT,LON") pair per line. Empty lines and lines starting with # are
+// skipped. Images are split between worker processes, which share the
+// tile cache directory, so tiles are only downloaded once.
+//
+// Servers without a display or GPU need a VTK built for offscreen
+// rendering, e.g. with OSMesa (VTK_OPENGL_HAS_OSMESA).
+
+#include "vtkFeatureLayer.h"
+#include "vtkGeoJSONMapFeature.h"
+#include "vtkMap.h"
+#include "vtkMapMarkerSet.h"
+#include "vtkMapTileSource.h"
+#include "vtkOsmLayer.h"
+#include "workers.h"
+
+#include <vtkNew.h>
+#include <vtkPNGWriter.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindow.h>
+#include <vtkWindowToImageFilter.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//----------------------------------------------------------------------------
+// One image of the list
+struct Snapshot
+{
+  double Latitude;
+  double Longitude;
+  double Zoom;
+  int Size[2];
+  std::string Output;
+  std::string MarkerFile;
+  std::vector<std::string> GeoJSONFiles;
+};
+
+//----------------------------------------------------------------------------
+static void PrintUsage(const char *program)
+{
+  std::cerr
+    << "Usage: " << program << " --list FILE [options]\n"
+    << "\n"
+    << "Each line of the list file describes one image:\n"
+    << "  LAT LON ZOOM WIDTH HEIGHT OUTPUT.png"
+    << " [markers=FILE] [geojson=FILE,...]\n"
+    << "\n"
+    << "Options:\n"
+    << "  --processes N      number of worker processes (default 1)\n"
+    << "  --storage DIR      vtkMap storage directory, holding the tile\n"
+    << "                     cache (default ~/.vtkmap)\n"
+    << "  --url TEMPLATE     tile url with {z} {x} {y} and {s} placeholders\n"
+    << "                     (default OpenStreetMap)\n"
+    << "  --subdomains LIST  comma-separated values for {s}"
+    << " (default a,b,c)\n"
+    << "  --name NAME        tile source name (default osm)\n";
+}
+
+//----------------------------------------------------------------------------
+// Parse the list file into snapshots. Returns false on invalid lines.
+static bool ReadList(const std::string& filename,
+                     std::vector<Snapshot>& snapshots)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read " << filename << std::endl;
+    return false;
+    }
+
+  std::string line;
+  for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+    std::istringstream iss(line);
+    Snapshot snapshot;
+    if (!(iss >> snapshot.Latitude))
+      {
+      // Empty line or comment
+      std::istringstream first(line);
+      std::string word;
+      if (!(first >> word) || word[0] == '#')
+        {
+        continue;
+        }
+      std::cerr << filename << ":" << lineNumber << ": invalid line\n";
+      return false;
+      }
+    if (!(iss >> snapshot.Longitude >> snapshot.Zoom
+          >> snapshot.Size[0] >> snapshot.Size[1] >> snapshot.Output) ||
+        snapshot.Size[0] <= 0 || snapshot.Size[1] <= 0)
+      {
+      std::cerr << filename << ":" << lineNumber << ": invalid line\n";
+      return false;
+      }
+
+    std::string option;
+    while (iss >> option)
+      {
+      if (option.compare(0, 8, "markers=") == 0)
+        {
+        snapshot.MarkerFile = option.substr(8);
+        }
+      else if (option.compare(0, 8, "geojson=") == 0)
+        {
+        std::istringstream files(option.substr(8));
+        std::string geojsonFile;
+        while (std::getline(files, geojsonFile, ','))
+          {
+          snapshot.GeoJSONFiles.push_back(geojsonFile);
+          }
+        }
+      else
+        {
+        std::cerr << filename << ":" << lineNumber << ": invalid option "
+                  << option << "\n";
+        return false;
+        }
+      }
+    snapshots.push_back(snapshot);
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Add the markers listed in filename to map
+static bool AddMarkers(vtkMap *map, const std::string& filename)
+{
+  std::ifstream file(filename.c_str());
+  if (!file)
+    {
+    std::cerr << "Cannot read " << filename << std::endl;
+    return false;
+    }
+
+  std::string line;
+  while (std::getline(file, line))
+    {
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream iss(line);
+    double latitude, longitude;
+    if (iss >> latitude >> longitude)
+      {
+      map->GetMapMarkerSet()->AddMarker(latitude, longitude);
+      }
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+// Render snapshot to its PNG file, with the map tiles of source
+static bool RenderSnapshot(const Snapshot& snapshot, vtkMapTileSource *source,
+                           const std::string& storageDirectory)
+{
+  vtkNew<vtkRenderer> renderer;
+  vtkNew<vtkRenderWindow> window;
+  window->SetOffScreenRendering(1);
+  window->AddRenderer(renderer.GetPointer());
+  window->SetSize(snapshot.Size[0], snapshot.Size[1]);
+
+  vtkNew<vtkMap> map;
+  map->SetRenderer(renderer.GetPointer());
+  map->SetStorageDirectory(storageDirectory.c_str());
+  map->SetCenter(snapshot.Latitude, snapshot.Longitude);
+  map->SetZoom(static_cast<int>(snapshot.Zoom));
+
+  // Synchronous tile layer: tiles are all loaded by the first draw
+  vtkNew<vtkOsmLayer> osmLayer;
+  osmLayer->SetTileSource(source);
+  map->AddLayer(osmLayer.GetPointer());
+
+  // Note: features are added after their layer is added to the map
+  vtkNew<vtkFeatureLayer> featureLayer;
+  if (!snapshot.GeoJSONFiles.empty())
+    {
+    featureLayer->SetName("geojson");
+    map->AddLayer(featureLayer.GetPointer());
+    }
+  for (size_t i = 0; i < snapshot.GeoJSONFiles.size(); ++i)
+    {
+    std::ifstream file(snapshot.GeoJSONFiles[i].c_str());
+    if (!file)
+      {
+      std::cerr << "Cannot read " << snapshot.GeoJSONFiles[i] << std::endl;
+      return false;
+      }
+    std::stringstream content;
+    content << file.rdbuf();
+    vtkNew<vtkGeoJSONMapFeature> feature;
+    feature->SetInputString(content.str().c_str());
+    featureLayer->AddFeature(feature.GetPointer());
+    }
+
+  if (!snapshot.MarkerFile.empty() &&
+      !AddMarkers(map.GetPointer(), snapshot.MarkerFile))
+    {
+    return false;
+    }
+
+  // Without an interactor, the view moves to the (fractional) zoom
+  // level at once
+  map->FlyTo(snapshot.Latitude, snapshot.Longitude, snapshot.Zoom, 0.0);
+  map->Draw();
+
+  vtkNew<vtkWindowToImageFilter> capture;
+  capture->SetInput(window.GetPointer());
+  capture->ReadFrontBufferOff();
+  vtkNew<vtkPNGWriter> writer;
+  writer->SetFileName(snapshot.Output.c_str());
+  writer->SetInputConnection(capture->GetOutputPort());
+  writer->Write();
+  if (writer->GetErrorCode())
+    {
+    std::cerr << "Cannot write " << snapshot.Output << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  vtkNew<vtkMapTileSource> source;
+
+  std::string listFile;
+  std::string storageDirectory =
+    vtksys::SystemTools::CollapseFullPath(".vtkmap", "~/");
+  int processes = 1;
+  int worker = -1;
+
+  // Workers are run with the same arguments, and their index
+  std::vector<std::string> args(1, argv[0]);
+  for (int i = 1; i < argc; ++i)
+    {
+    std::string arg(argv[i]);
+    bool hasValue = i + 1 < argc;
+    int start = i;
+    if (arg == "--worker" && hasValue)
+      {
+      worker = atoi(argv[++i]);
+      continue;
+      }
+    else if (arg == "--list" && hasValue)
+      {
+      listFile = argv[++i];
+      }
+    else if (arg == "--processes" && hasValue)
+      {
+      processes = std::max(1, atoi(argv[++i]));
+      }
+    else if (arg == "--storage" && hasValue)
+      {
+      storageDirectory = argv[++i];
+      }
+    else if (arg == "--url" && hasValue)
+      {
+      source->SetUrlTemplate(argv[++i]);
+      }
+    else if (arg == "--subdomains" && hasValue)
+      {
+      source->RemoveAllSubdomains();
+      std::istringstream iss(argv[++i]);
+      std::string subdomain;
+      while (std::getline(iss, subdomain, ','))
+        {
+        source->AddSubdomain(subdomain);
+        }
+      }
+    else if (arg == "--name" && hasValue)
+      {
+      source->SetName(argv[++i]);
+      }
+    else
+      {
+      std::cerr << "Invalid argument " << arg << "\n\n";
+      PrintUsage(argv[0]);
+      return EXIT_FAILURE;
+      }
+    args.insert(args.end(), argv + start, argv + i + 1);
+    }
+
+  std::vector<Snapshot> snapshots;
+  if (listFile.empty())
+    {
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+    }
+  if (!ReadList(listFile, snapshots))
+    {
+    return EXIT_FAILURE;
+    }
+
+  // Split the images between the workers
+  if (worker < 0 && processes > 1 &&
+      static_cast<int>(snapshots.size()) > 1)
+    {
+    processes = std::min(processes, static_cast<int>(snapshots.size()));
+    return RunWorkers(args, processes) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  int first = std::max(0, worker);
+  int step = worker < 0 ? 1 : processes;
+  int failures = 0;
+  for (size_t i = first; i < snapshots.size(); i += step)
+    {
+    if (RenderSnapshot(snapshots[i], source.GetPointer(), storageDirectory))
+      {
+      std::cout << snapshots[i].Output << std::endl;
+      }
+    else
+      {
+      ++failures;
+      }
+    }
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,372 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkCompositeTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkCompositeTileSource.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileFailureCache.h"
+
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstring>  // for memset()
+#include <vector>
+
+vtkStandardNewMacro(vtkCompositeTileSource)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Blend source over the RGBA target image, scaling source to the
+// target size (nearest pixel). If shift is not zero, source is the
+// ancestor tile shift levels up, and only the part of it covering the
+// target tile, at column col and row row (from the top) of the
+// ancestor's 2^shift subdivisions, is scaled up.
+// Returns false for unsupported images.
+bool BlendImage(vtkImageData *target, vtkImageData *source, double opacity,
+                int shift = 0, int col = 0, int row = 0)
+{
+  int components = source->GetNumberOfScalarComponents();
+  if (source->GetScalarType() != VTK_UNSIGNED_CHAR ||
+      components < 1 || components > 4)
+    {
+    return false;
+    }
+
+  int targetDims[3];
+  int sourceDims[3];
+  target->GetDimensions(targetDims);
+  source->GetDimensions(sourceDims);
+  unsigned char *out =
+    static_cast<unsigned char*>(target->GetScalarPointer());
+  const unsigned char *in =
+    static_cast<unsigned char*>(source->GetScalarPointer());
+  // Image rows count up from the bottom
+  vtkTypeInt64 n = static_cast<vtkTypeInt64>(1) << shift;
+  vtkTypeInt64 width = n * targetDims[0];
+  vtkTypeInt64 height = n * targetDims[1];
+  vtkTypeInt64 left = col * static_cast<vtkTypeInt64>(targetDims[0]);
+  vtkTypeInt64 bottom = (n - 1 - row) * targetDims[1];
+  bool hasAlpha = (components == 2 || components == 4);
+  bool isGray = components < 3;
+
+  for (int j = 0; j < targetDims[1]; ++j)
+    {
+    int sourceJ = static_cast<int>((bottom + j) * sourceDims[1] / height);
+    const unsigned char *line = in + components * sourceJ * sourceDims[0];
+    for (int i = 0; i < targetDims[0]; ++i, out += 4)
+      {
+      int sourceI = static_cast<int>((left + i) * sourceDims[0] / width);
+      const unsigned char *pixel = line + components * sourceI;
+      double alpha = opacity *
+        (hasAlpha ? pixel[components - 1] / 255.0 : 1.0);
+      if (alpha <= 0.0)
+        {
+        continue;
+        }
+
+      // Non-premultiplied "over" operator
+      double below = (out[3] / 255.0) * (1.0 - alpha);
+      double outAlpha = alpha + below;
+      for (int c = 0; c < 3; ++c)
+        {
+        double value = isGray ? pixel[0] : pixel[c];
+        out[c] = static_cast<unsigned char>(
+          (value * alpha + out[c] * below) / outAlpha + 0.5);
+        }
+      out[3] = static_cast<unsigned char>(255.0 * outAlpha + 0.5);
+      }
+    }
+  return true;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkCompositeTileSource::vtkCompositeTileSourceInternals
+{
+public:
+  std::vector<vtkMapTileSource*> Sources;
+  std::vector<double> Opacities;
+  std::vector<vtkMapTileFailureCache*> FailureCaches;
+};
+
+//----------------------------------------------------------------------------
+vtkCompositeTileSource::vtkCompositeTileSource()
+{
+  this->CacheDirectory = NULL;
+  this->CompositeInternals = new vtkCompositeTileSourceInternals;
+
+  // Tiles come from the component sources
+  this->SetName("composite");
+  this->SetUrlTemplate(NULL);
+  this->RemoveAllSubdomains();
+}
+
+//----------------------------------------------------------------------------
+vtkCompositeTileSource::~vtkCompositeTileSource()
+{
+  this->RemoveAllSources();
+  delete [] this->CacheDirectory;
+  delete this->CompositeInternals;
+}
+
+//----------------------------------------------------------------------------
+void vtkCompositeTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "CacheDirectory: "
+     << (this->CacheDirectory ? this->CacheDirectory : "(none)") << "\n"
+     << indent << "Sources:\n";
+  for (size_t i = 0; i < this->CompositeInternals->Sources.size(); ++i)
+    {
+    vtkMapTileSource *source = this->CompositeInternals->Sources[i];
+    os << indent.GetNextIndent() << (source->GetName() ? source->GetName() : "")
+       << " opacity " << this->CompositeInternals->Opacities[i] << "\n";
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCompositeTileSource::AddSource(vtkMapTileSource *source,
+                                       double opacity)
+{
+  if (!source || source == this)
+    {
+    return;
+    }
+
+  source->Register(this);
+  this->CompositeInternals->Sources.push_back(source);
+  this->CompositeInternals->Opacities.push_back(
+    std::max(0.0, std::min(opacity, 1.0)));
+  this->CompositeInternals->FailureCaches.push_back(
+    vtkMapTileFailureCache::New());
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkCompositeTileSource::RemoveAllSources()
+{
+  for (size_t i = 0; i < this->CompositeInternals->Sources.size(); ++i)
+    {
+    this->CompositeInternals->Sources[i]->UnRegister(this);
+    this->CompositeInternals->FailureCaches[i]->Delete();
+    }
+  this->CompositeInternals->Sources.clear();
+  this->CompositeInternals->Opacities.clear();
+  this->CompositeInternals->FailureCaches.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkCompositeTileSource::GetNumberOfSources()
+{
+  return static_cast<int>(this->CompositeInternals->Sources.size());
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSource *vtkCompositeTileSource::GetSource(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfSources())
+    {
+    return NULL;
+    }
+  return this->CompositeInternals->Sources[index];
+}
+
+//----------------------------------------------------------------------------
+void vtkCompositeTileSource::SetSourceOpacity(int index, double opacity)
+{
+  if (index < 0 || index >= this->GetNumberOfSources())
+    {
+    vtkErrorMacro("Invalid source index " << index);
+    return;
+    }
+
+  opacity = std::max(0.0, std::min(opacity, 1.0));
+  if (opacity != this->CompositeInternals->Opacities[index])
+    {
+    this->CompositeInternals->Opacities[index] = opacity;
+    this->Modified();
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkCompositeTileSource::GetSourceOpacity(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfSources())
+    {
+    return 0.0;
+    }
+  return this->CompositeInternals->Opacities[index];
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileFailureCache *vtkCompositeTileSource::GetSourceFailureCache(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfSources())
+    {
+    return NULL;
+    }
+  return this->CompositeInternals->FailureCaches[index];
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkCompositeTileSource::GetMTime()
+{
+  unsigned long mtime = this->Superclass::GetMTime();
+  for (size_t i = 0; i < this->CompositeInternals->Sources.size(); ++i)
+    {
+    mtime = std::max(mtime,
+                     this->CompositeInternals->Sources[i]->GetMTime());
+    }
+  return mtime;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkCompositeTileSource::ReadTileImage(int zoom, int x, int y,
+                                                    int *status)
+{
+  vtkImageData *result = NULL;
+  bool failed = false;
+  for (int i = 0; i < this->GetNumberOfSources() && !failed; ++i)
+    {
+    double opacity = this->CompositeInternals->Opacities[i];
+    if (opacity <= 0.0)
+      {
+      continue;
+      }
+
+    // Past the source's highest level, scale up its ancestor tile
+    int shift = std::max(0, zoom - this->GetSource(i)->GetMaxZoom());
+    int sourceStatus = vtkMapTile::DownloadMissing;
+    vtkImageData *image = this->ReadSourceTileImage(
+      i, zoom - shift, x >> shift, y >> shift, sourceStatus);
+    if (!image)
+      {
+      failed = (sourceStatus == vtkMapTile::DownloadFailed);
+      continue;
+      }
+
+    // The first image sets the size of the result
+    if (!result)
+      {
+      int dims[3];
+      image->GetDimensions(dims);
+      result = vtkImageData::New();
+      result->SetDimensions(dims[0], dims[1], 1);
+      result->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+      memset(result->GetScalarPointer(), 0,
+             4 * static_cast<size_t>(dims[0]) * dims[1]);
+      }
+    if (!BlendImage(result, image, opacity, shift,
+                    x - ((x >> shift) << shift), y - ((y >> shift) << shift)))
+      {
+      vtkWarningMacro("Cannot blend tile " << zoom << "/" << x << "/" << y
+                      << " of source " << this->GetSource(i)->GetName()
+                      << ": unsupported image format");
+      }
+    image->Delete();
+    }
+
+  if (failed && result)
+    {
+    result->Delete();
+    result = NULL;
+    }
+  if (status)
+    {
+    *status = result ? vtkMapTile::DownloadOK :
+      (failed ? vtkMapTile::DownloadFailed : vtkMapTile::DownloadMissing);
+    }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkCompositeTileSource::
+ReadSourceTileImage(int index, int zoom, int x, int y, int& status)
+{
+  vtkMapTileSource *source = this->CompositeInternals->Sources[index];
+  if (source->ProvidesImages())
+    {
+    return source->ReadTileImage(zoom, x, y, &status);
+    }
+
+  if (source->IsLocal())
+    {
+    vtkImageData *image =
+      vtkMapTile::ReadImageFile(source->GetLocalTileFile(zoom, x, y),
+                                source->GetCodec());
+    status = image ? vtkMapTile::DownloadOK : vtkMapTile::DownloadMissing;
+    return image;
+    }
+
+  if (!this->CacheDirectory || !source->GetName())
+    {
+    vtkErrorMacro("No cache directory for source " << index);
+    status = vtkMapTile::DownloadFailed;
+    return NULL;
+    }
+
+  std::string directory =
+    std::string(this->CacheDirectory) + "/" + source->GetName();
+  std::string filename =
+    source->GetCacheTileFile(directory.c_str(), zoom, x, y);
+  if (!vtkMapTile::IsImageFileValid(filename.c_str(), source->GetCodec()))
+    {
+    // Skip tiles that failed recently. If the next host in rotation
+    // is suspended, try the other hosts.
+    vtkMapTileFailureCache *failureCache =
+      this->CompositeInternals->FailureCaches[index];
+    std::string url;
+    std::string host;
+    int numHosts = std::max(1, source->GetNumberOfSubdomains());
+    int start = source->GetNextSubdomainIndex();
+    bool canRequest = false;
+    for (int i = 0; i < numHosts && !canRequest; ++i)
+      {
+      url = source->GetTileUrl(zoom, x, y, (start + i) % numHosts);
+      host = vtkMapTileFailureCache::GetHost(url);
+      canRequest = failureCache->CanRequest(zoom, x, y, host);
+      }
+    if (!canRequest)
+      {
+      // Leave the tile out of the blend, as a missing one
+      if (failureCache->IsTileAvailable(zoom, x, y))
+        {
+        failureCache->RecordTileFailure(zoom, x, y);
+        }
+      status = vtkMapTile::DownloadMissing;
+      return NULL;
+      }
+
+    vtksys::SystemTools::MakeDirectory(directory.c_str());
+    std::string errorMessage;
+    status = source->DownloadTile(url, filename, errorMessage);
+    if (status != vtkMapTile::DownloadOK)
+      {
+      vtkWarningMacro(<< errorMessage);
+      failureCache->RecordFailure(zoom, x, y, host,
+                                  status == vtkMapTile::DownloadMissing);
+      return NULL;
+      }
+    failureCache->RecordSuccess(zoom, x, y, host);
+    }
+
+  vtkImageData *image =
+    vtkMapTile::ReadImageFile(filename, source->GetCodec());
+  status = image ? vtkMapTile::DownloadOK : vtkMapTile::DownloadFailed;
+  return image;
+}
@@ -0,0 +1,119 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkCompositeTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkCompositeTileSource - map tiles blended from several sources
+// .SECTION Description
+// Stacks several tile sources, e.g. a base map, a hillshade and a
+// weather radar overlay, into one RGBA image per tile. Sources are
+// blended in the order they were added (first at the bottom), each
+// with its own opacity, in addition to the alpha of its images.
+// Used as the tile source of a vtkOsmLayer, this draws one textured
+// quad per tile instead of one per tile and source; with
+// vtkMultiThreadedOsmLayer, tiles are blended on the worker threads,
+// and the layer's vtkMapTileService caches the blended images.
+//
+// Tiles of the component sources are downloaded to subdirectories
+// of CacheDirectory named after the sources. Local sources and sources
+// that provide images are read in place. Changing a source or an
+// opacity makes layers using the composite source reload their tiles.
+//
+// Past the MaxZoom of a source, the part of its tile at MaxZoom
+// covering the requested tile is scaled up, so sources with fewer
+// levels remain in the blend. The MaxZoom of the composite source
+// should be the highest of its sources'.
+//
+// Tiles a source doesn't have are left out of the blend. If a download
+// fails, the whole tile is reported as failed, so that layers retry
+// it later rather than caching an incomplete blend. Each source has a
+// vtkMapTileFailureCache backing off its failed tiles and suspending
+// its failing hosts; tiles it backs off are left out like missing
+// ones, so that the other sources still show.
+
+#ifndef __vtkCompositeTileSource_h
+#define __vtkCompositeTileSource_h
+
+#include "vtkMapTileSource.h"
+#include "vtkmap_export.h"
+
+class vtkMapTileFailureCache;
+
+class VTKMAP_EXPORT vtkCompositeTileSource : public vtkMapTileSource
+{
+public:
+  static vtkCompositeTileSource *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkCompositeTileSource, vtkMapTileSource)
+
+  // Description:
+  // Add a source on top of the current ones, with opacity in [0, 1].
+  // Sources should not be added while layers read tiles.
+  void AddSource(vtkMapTileSource *source, double opacity = 1.0);
+  void RemoveAllSources();
+  int GetNumberOfSources();
+  vtkMapTileSource *GetSource(int index);
+
+  // Description:
+  // Get/Set the opacity of the source at index
+  void SetSourceOpacity(int index, double opacity);
+  double GetSourceOpacity(int index);
+
+  // Description:
+  // Get the negative cache used to back off from the failing downloads
+  // of the source at index, e.g. to adjust its retry delays
+  vtkMapTileFailureCache *GetSourceFailureCache(int index);
+
+  // Description:
+  // Get/Set the directory caching the tiles of the component sources.
+  // If not set, vtkOsmLayer sets it to its own cache directory.
+  vtkSetStringMacro(CacheDirectory)
+  vtkGetStringMacro(CacheDirectory)
+
+  // Description:
+  // Tiles are blended in memory
+  virtual bool ProvidesImages() { return true; }
+
+  // Description:
+  // Blend tile (zoom, x, y) of the sources, downloading the missing
+  // tiles. Returns a new RGBA image, the size of the first source image
+  // found, that the caller must Delete(), or NULL if no source has the
+  // tile or a download failed. Thread safe.
+  virtual vtkImageData *ReadTileImage(int zoom, int x, int y,
+                                      int *status = NULL);
+
+  // Description:
+  // Includes the modification times of the sources
+  virtual unsigned long GetMTime();
+
+protected:
+  vtkCompositeTileSource();
+  ~vtkCompositeTileSource();
+
+  // Description:
+  // Read tile (zoom, x, y) of the source at index, downloading it
+  // if needed, unless the source's failure cache backs off the request.
+  // Sets status to a vtkMapTile::DownloadStatus value.
+  vtkImageData *ReadSourceTileImage(int index, int zoom, int x, int y,
+                                    int& status);
+
+  char *CacheDirectory;
+
+  class vtkCompositeTileSourceInternals;
+  vtkCompositeTileSourceInternals *CompositeInternals;
+
+private:
+  vtkCompositeTileSource(const vtkCompositeTileSource&);  // Not implemented
+  vtkCompositeTileSource& operator=(const vtkCompositeTileSource&); // Not implemented
+};
+
+#endif // __vtkCompositeTileSource_h
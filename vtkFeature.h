@@ -71,6 +71,13 @@ public:
   // not directly by the application code.
   virtual void Update() = 0;
 
+  // Description:
+  // Add/Remove the feature's props to/from a viewport of the layer's
+  // map (see vtkLayer::UpdateViewport()), sharing them with the layer's
+  // renderer. Called by the feature layer; do nothing by default.
+  virtual void AddViewport(vtkRenderer*) { }
+  virtual void RemoveViewport(vtkRenderer*) { }
+
   // Description:
   // Return boolean indicating if the feature is to be displayed,
   // which is the boolean product of the feature's visibiltiy
@@ -29,6 +29,7 @@ class vtkFeatureLayer::vtkInternal
 {
 public:
   std::vector<vtkFeature*> Features;
+  std::vector<vtkRenderer*> Viewports;
 };
 
 //----------------------------------------------------------------------------
@@ -87,6 +88,10 @@ void vtkFeatureLayer::AddFeature(vtkFeature* feature)
     }
 
   feature->Init();
+  for (size_t i = 0; i < this->Impl->Viewports.size(); ++i)
+    {
+    feature->AddViewport(this->Impl->Viewports[i]);
+    }
 
   this->Modified();
 }
@@ -99,6 +104,10 @@ void vtkFeatureLayer::RemoveFeature(vtkFeature* feature)
     return;
     }
 
+  for (size_t i = 0; i < this->Impl->Viewports.size(); ++i)
+    {
+    feature->RemoveViewport(this->Impl->Viewports[i]);
+    }
   feature->CleanUp();
   typedef std::vector< vtkFeature* >::iterator iter;
   iter found_iter =  std::find(this->Impl->Features.begin(),
@@ -110,6 +119,68 @@ void vtkFeatureLayer::RemoveFeature(vtkFeature* feature)
   //now resize the array to not hold the empty feature
   this->Impl->Features.erase( std::remove(this->Impl->Features.begin(),
                               this->Impl->Features.end(), feature ));
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkFeatureLayer::GetNumberOfFeatures()
+{
+  return static_cast<int>(this->Impl->Features.size());
+}
+
+//----------------------------------------------------------------------------
+vtkFeature *vtkFeatureLayer::GetFeature(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfFeatures())
+    {
+    return NULL;
+    }
+  return this->Impl->Features[index];
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkFeatureLayer::GetMTime()
+{
+  unsigned long mtime = this->Superclass::GetMTime();
+  for (size_t i = 0; i < this->Impl->Features.size(); ++i)
+    {
+    mtime = std::max(mtime, this->Impl->Features[i]->GetMTime());
+    }
+  return mtime;
+}
+
+//----------------------------------------------------------------------------
+void vtkFeatureLayer::UpdateViewport(vtkRenderer *renderer)
+{
+  if (!renderer || renderer == this->Renderer ||
+      std::find(this->Impl->Viewports.begin(), this->Impl->Viewports.end(),
+                renderer) != this->Impl->Viewports.end())
+    {
+    return;
+    }
+
+  this->Impl->Viewports.push_back(renderer);
+  for (size_t i = 0; i < this->Impl->Features.size(); ++i)
+    {
+    this->Impl->Features[i]->AddViewport(renderer);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkFeatureLayer::RemoveViewport(vtkRenderer *renderer)
+{
+  std::vector<vtkRenderer*>::iterator iter = std::find(
+    this->Impl->Viewports.begin(), this->Impl->Viewports.end(), renderer);
+  if (iter == this->Impl->Viewports.end())
+    {
+    return;
+    }
+
+  for (size_t i = 0; i < this->Impl->Features.size(); ++i)
+    {
+    this->Impl->Features[i]->RemoveViewport(renderer);
+    }
+  this->Impl->Viewports.erase(iter);
 }
 
 //----------------------------------------------------------------------------
@@ -39,10 +39,25 @@ public:
   // Remove a feature from the layer
   void RemoveFeature(vtkFeature* feature);
 
+  // Description:
+  // Get the number of features, and the feature at index
+  int GetNumberOfFeatures();
+  vtkFeature *GetFeature(int index);
+
   // Description:
   // Update features and prepare them for rendering
   virtual void Update();
 
+  // Description:
+  // Includes the modification times of the features
+  virtual unsigned long GetMTime();
+
+  // Description:
+  // Display the features in a viewport of the map too, sharing their
+  // actors with the map's renderer
+  virtual void UpdateViewport(vtkRenderer *renderer);
+  virtual void RemoveViewport(vtkRenderer *renderer);
+
 protected:
   vtkFeatureLayer();
   ~vtkFeatureLayer();
@@ -23,6 +23,8 @@
 #include <vtkPolyData.h>
 #include <vtkProperty.h>
 
+#include <vector>
+
 vtkStandardNewMacro(vtkGeoJSONMapFeature);
 
 //----------------------------------------------------------------------------
@@ -62,10 +64,20 @@ void vtkGeoJSONMapFeature::Init()
 
   // Convert poly data points from <lon, lat> to <x, y>
   vtkPoints *points = this->PolyData->GetPoints();
-  for (vtkIdType i=0; i<points->GetNumberOfPoints(); i++)
+  vtkIdType numberOfPoints = points->GetNumberOfPoints();
+  std::vector<double> y(numberOfPoints);
+  for (vtkIdType i=0; i<numberOfPoints; i++)
+    {
+    y[i] = points->GetPoint(i)[1];
+    }
+  if (numberOfPoints > 0)
+    {
+    vtkMercator::lat2y(&y[0], &y[0], numberOfPoints);
+    }
+  for (vtkIdType i=0; i<numberOfPoints; i++)
     {
     double *coords = points->GetPoint(i);
-    coords[1] = vtkMercator::lat2y(coords[1]);
+    coords[1] = y[i];
     points->SetPoint(i, coords);
     }
 
@@ -26,6 +26,9 @@
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
 
+#include <algorithm>
+#include <cmath>
+
 vtkStandardNewMacro(vtkInteractorStyleMap)
 
 //----------------------------------------------------------------------------
@@ -104,11 +107,15 @@ void vtkInteractorStyleMap::OnMouseWheelForward()
 {
   if (this->Map)
     {
-    int zoom = this->Map->GetZoom();
-    if (zoom < 19)
+    // Interaction takes over from FlyTo()
+    this->Map->StopFlyTo();
+    double zoom = this->Map->GetFractionalZoom();
+    if (zoom < this->Map->GetMaxZoom() - 1e-6)
       {
-      zoom++;
-      this->Map->SetZoom(zoom);
+      // Zoom in by ZoomStep levels, up to MaxZoom
+      double step = std::min(this->Map->GetZoomStep(),
+                             this->Map->GetMaxZoom() - zoom);
+      double factor = pow(2.0, step);
       this->SetCurrentRenderer(this->Map->GetRenderer());
 
       vtkCamera *camera = this->Map->GetRenderer()->GetActiveCamera();
@@ -125,7 +132,7 @@ void vtkInteractorStyleMap::OnMouseWheelForward()
       camera->GetPosition(cameraCoords);
 
       // Apply the dolly operation (move closer to focal point)
-      camera->Dolly(2.0);
+      camera->Dolly(factor);
 
       // Get new camera coordinates
       double nextCameraCoords[3];
@@ -133,7 +140,8 @@ void vtkInteractorStyleMap::OnMouseWheelForward()
 
       // Adjust xy position to be proportional to change in z
       // That way, the zoom point remains stationary
-      const double f = 0.5;   // fraction that camera moved closer to origin
+      // fraction that camera moved closer to origin
+      const double f = 1.0 - 1.0 / factor;
       double losVector[3];  // line-of-sight vector, from camera to zoomCoords
       vtkMath::Subtract(zoomCoords, cameraCoords, losVector);
       vtkMath::Normalize(losVector);
@@ -147,7 +155,7 @@ void vtkInteractorStyleMap::OnMouseWheelForward()
       camera->SetFocalPoint(nextCameraCoords);
 
       // Redraw the map
-      this->Map->Draw();
+      this->Map->RequestDraw();
       }
     }
   this->Superclass::OnMouseWheelForward();
@@ -158,12 +166,14 @@ void vtkInteractorStyleMap::OnMouseWheelBackward()
 {
   if (this->Map)
     {
-    int zoom = this->Map->GetZoom();
-    if (zoom > 0)
+    // Interaction takes over from FlyTo()
+    this->Map->StopFlyTo();
+    double zoom = this->Map->GetFractionalZoom();
+    if (zoom > 1e-6)
       {
-      zoom--;
-
-      this->Map->SetZoom(zoom);
+      // Zoom out by ZoomStep levels, down to 0
+      double step = std::min(this->Map->GetZoomStep(), zoom);
+      double factor = pow(2.0, -step);
       this->SetCurrentRenderer(this->Map->GetRenderer());
 
       vtkCamera *camera = this->Map->GetRenderer()->GetActiveCamera();
@@ -180,7 +190,7 @@ void vtkInteractorStyleMap::OnMouseWheelBackward()
       camera->GetPosition(cameraCoords);
 
       // Apply the dolly operation (move away from focal point)
-      camera->Dolly(0.5);
+      camera->Dolly(factor);
 
       // Get new camera coordinates
       double nextCameraCoords[3];
@@ -191,7 +201,7 @@ void vtkInteractorStyleMap::OnMouseWheelBackward()
       double losVector[3];  // line-of-sight vector, from camera to zoomCoords
       vtkMath::Subtract(zoomCoords, cameraCoords, losVector);
       vtkMath::Normalize(losVector);
-      vtkMath::MultiplyScalar(losVector, -1.0 * cameraCoords[2]);
+      vtkMath::MultiplyScalar(losVector, (1.0 - 1.0 / factor) * cameraCoords[2]);
       nextCameraCoords[0] = cameraCoords[0] + losVector[0];
       nextCameraCoords[1] = cameraCoords[1] + losVector[1];
       camera->SetPosition(nextCameraCoords);
@@ -201,7 +211,7 @@ void vtkInteractorStyleMap::OnMouseWheelBackward()
       camera->SetFocalPoint(nextCameraCoords);
 
       // Redraw the map
-      this->Map->Draw();
+      this->Map->RequestDraw();
       }
     }
   this->Superclass::OnMouseWheelBackward();
@@ -220,6 +230,8 @@ void vtkInteractorStyleMap::Pan()
     return;
     }
 
+  this->Map->StopFlyTo();
+
   // Following logic is copied from vtkInteractorStyleTrackballCamera:
 
   vtkRenderWindowInteractor *rwi = this->Interactor;
@@ -264,5 +276,5 @@ void vtkInteractorStyleMap::Pan()
                       motionVector[1] + viewPoint[1],
                       motionVector[2] + viewPoint[2]);
 
-  this->Map->Draw();
+  this->Map->RequestDraw();
 }
@@ -92,6 +92,26 @@ bool vtkLayer::IsAsynchronous()
   return this->AsyncMode;
 }
 
+//----------------------------------------------------------------------------
+void vtkLayer::PrepareUpdate()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkLayer::Prefetch(const double*, int)
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkLayer::UpdateViewport(vtkRenderer*)
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkLayer::RemoveViewport(vtkRenderer*)
+{
+}
+
 //----------------------------------------------------------------------------
 vtkMap::AsyncState vtkLayer::ResolveAsync()
 {
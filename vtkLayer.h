@@ -70,9 +70,32 @@ public:
   // by the vtkMap object.
   virtual vtkMap::AsyncState ResolveAsync();
 
+  // Description:
+  // Prepare the next Update() without changing any render object,
+  // e.g. select and read the data it will display. vtkMap calls it
+  // concurrently, on worker threads, for all the layers it is about
+  // to update, then calls Update() for each on the main thread.
+  // Does nothing by default.
+  virtual void PrepareUpdate();
+
+  // Description:
+  // Queue the data needed to display the world area worldBounds
+  // (xmin, xmax, ymin, ymax) on displayWidth pixels, ahead of earlier
+  // requests, e.g. for the keyframes of vtkMap::FlyTo(). Only
+  // asynchronous layers fetch data ahead; does nothing by default.
+  virtual void Prefetch(const double worldBounds[4], int displayWidth);
+
   // Description:
   virtual void Update() = 0;
 
+  // Description:
+  // Display the layer in an additional viewport of its map (see
+  // vtkMap::AddViewport()), from the viewport's camera, or remove it
+  // from one. By default, layers are only displayed in the map's
+  // renderer and these do nothing.
+  virtual void UpdateViewport(vtkRenderer *renderer);
+  virtual void RemoveViewport(vtkRenderer *renderer);
+
 protected:
 
   vtkLayer();
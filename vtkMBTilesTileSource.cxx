@@ -0,0 +1,293 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMBTilesTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMBTilesTileSource.h"
+#include "vtkMapTile.h"
+
+#include <vtkConditionVariable.h>
+#include <vtkImageData.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtk_sqlite.h>
+
+#include <cstring>  // for memcpy()
+
+vtkStandardNewMacro(vtkMBTilesTileSource)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// MBTiles stores rows in TMS order (counting up from the bottom)
+const char *TileQuery =
+  "SELECT tile_data FROM tiles"
+  " WHERE zoom_level=?1 AND tile_column=?2 AND tile_row=?3";
+
+// Database connection with its prepared tile query
+struct Connection
+{
+  vtk_sqlite3 *Database;
+  vtk_sqlite3_stmt *Statement;
+  int Generation;  // FileName generation the connection was opened for
+};
+
+void CloseConnection(Connection *connection)
+{
+  if (connection->Statement)
+    {
+    vtk_sqlite3_finalize(connection->Statement);
+    }
+  vtk_sqlite3_close(connection->Database);
+  delete connection;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMBTilesTileSource::vtkMBTilesTileSourceInternals
+{
+public:
+  std::vector<Connection*> IdleConnections;
+  int NumberOfConnections;  // idle plus in use
+  int Generation;  // incremented when the file changes
+  bool ReportedError;  // report open errors once per file
+  vtkMutexLock *Lock;
+  vtkConditionVariable *ConnectionAvailable;
+
+  // Get an idle connection, opening a new one if the pool isn't full.
+  // Returns NULL if the file cannot be opened.
+  Connection *Acquire(vtkMBTilesTileSource *self);
+  void Release(Connection *connection);
+};
+
+//----------------------------------------------------------------------------
+Connection *vtkMBTilesTileSource::vtkMBTilesTileSourceInternals::
+Acquire(vtkMBTilesTileSource *self)
+{
+  this->Lock->Lock();
+  while (this->IdleConnections.empty() &&
+         this->NumberOfConnections >= self->GetMaxConnections() &&
+         self->GetMaxConnections() > 0)
+    {
+    this->ConnectionAvailable->Wait(this->Lock);
+    }
+
+  if (!this->IdleConnections.empty())
+    {
+    Connection *connection = this->IdleConnections.back();
+    this->IdleConnections.pop_back();
+    this->Lock->Unlock();
+    return connection;
+    }
+
+  // Reserve the slot, and open outside of the lock
+  this->NumberOfConnections++;
+  int generation = this->Generation;
+  std::string filename(self->GetFileName() ? self->GetFileName() : "");
+  this->Lock->Unlock();
+
+  Connection *connection = new Connection;
+  connection->Database = NULL;
+  connection->Statement = NULL;
+  connection->Generation = generation;
+  std::string errorMessage;
+  if (filename.empty())
+    {
+    errorMessage = "No FileName specified";
+    }
+  else if (vtk_sqlite3_open_v2(filename.c_str(), &connection->Database,
+                               VTK_SQLITE_OPEN_READONLY, NULL) !=
+           VTK_SQLITE_OK ||
+           vtk_sqlite3_prepare_v2(connection->Database, TileQuery, -1,
+                                  &connection->Statement, NULL) !=
+           VTK_SQLITE_OK)
+    {
+    errorMessage = "Cannot read MBTiles file " + filename + ": " +
+      (connection->Database ?
+       vtk_sqlite3_errmsg(connection->Database) : "out of memory");
+    }
+
+  if (errorMessage.empty())
+    {
+    return connection;
+    }
+
+  CloseConnection(connection);
+  this->Lock->Lock();
+  this->NumberOfConnections--;
+  bool report = !this->ReportedError;
+  this->ReportedError = true;
+  this->ConnectionAvailable->Signal();
+  this->Lock->Unlock();
+  if (report)
+    {
+    vtkErrorWithObjectMacro(self, << errorMessage);
+    }
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkMBTilesTileSource::vtkMBTilesTileSourceInternals::
+Release(Connection *connection)
+{
+  this->Lock->Lock();
+  if (connection->Generation == this->Generation)
+    {
+    this->IdleConnections.push_back(connection);
+    }
+  else
+    {
+    // Opened for a previous file
+    CloseConnection(connection);
+    this->NumberOfConnections--;
+    }
+  this->ConnectionAvailable->Signal();
+  this->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkMBTilesTileSource::vtkMBTilesTileSource()
+{
+  this->FileName = NULL;
+  this->MaxConnections = 6;
+
+  this->MBTilesInternals = new vtkMBTilesTileSourceInternals;
+  this->MBTilesInternals->NumberOfConnections = 0;
+  this->MBTilesInternals->Generation = 0;
+  this->MBTilesInternals->ReportedError = false;
+  this->MBTilesInternals->Lock = vtkMutexLock::New();
+  this->MBTilesInternals->ConnectionAvailable = vtkConditionVariable::New();
+
+  // Nothing to download
+  this->SetName("mbtiles");
+  this->SetUrlTemplate(NULL);
+  this->RemoveAllSubdomains();
+}
+
+//----------------------------------------------------------------------------
+vtkMBTilesTileSource::~vtkMBTilesTileSource()
+{
+  this->CloseConnections();
+  delete [] this->FileName;
+  this->MBTilesInternals->Lock->Delete();
+  this->MBTilesInternals->ConnectionAvailable->Delete();
+  delete this->MBTilesInternals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMBTilesTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: "
+     << (this->FileName ? this->FileName : "(none)") << "\n"
+     << indent << "MaxConnections: " << this->MaxConnections << "\n"
+     << indent << "NumberOfConnections: "
+     << this->MBTilesInternals->NumberOfConnections << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMBTilesTileSource::SetFileName(const char *filename)
+{
+  this->MBTilesInternals->Lock->Lock();
+  delete [] this->FileName;
+  this->FileName = NULL;
+  if (filename)
+    {
+    this->FileName = new char[strlen(filename) + 1];
+    strcpy(this->FileName, filename);
+    }
+  this->MBTilesInternals->ReportedError = false;
+  this->MBTilesInternals->Lock->Unlock();
+
+  this->CloseConnections();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMBTilesTileSource::CloseConnections()
+{
+  this->MBTilesInternals->Lock->Lock();
+  this->MBTilesInternals->Generation++;
+  std::vector<Connection*>::iterator iter =
+    this->MBTilesInternals->IdleConnections.begin();
+  for (; iter != this->MBTilesInternals->IdleConnections.end(); iter++)
+    {
+    CloseConnection(*iter);
+    this->MBTilesInternals->NumberOfConnections--;
+    }
+  this->MBTilesInternals->IdleConnections.clear();
+  this->MBTilesInternals->ConnectionAvailable->Broadcast();
+  this->MBTilesInternals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMBTilesTileSource::
+ReadTileData(int zoom, int x, int y, std::vector<unsigned char>& data)
+{
+  data.clear();
+  if (zoom < 0 || zoom > 30 || x < 0 || y < 0 ||
+      x >= (1 << zoom) || y >= (1 << zoom))
+    {
+    return false;
+    }
+
+  Connection *connection = this->MBTilesInternals->Acquire(this);
+  if (!connection)
+    {
+    return false;
+    }
+
+  vtk_sqlite3_stmt *statement = connection->Statement;
+  vtk_sqlite3_bind_int(statement, 1, zoom);
+  vtk_sqlite3_bind_int(statement, 2, x);
+  vtk_sqlite3_bind_int(statement, 3, (1 << zoom) - 1 - y);
+  if (vtk_sqlite3_step(statement) == VTK_SQLITE_ROW)
+    {
+    const void *blob = vtk_sqlite3_column_blob(statement, 0);
+    int length = vtk_sqlite3_column_bytes(statement, 0);
+    if (blob && length > 0)
+      {
+      data.resize(length);
+      memcpy(&data[0], blob, length);
+      }
+    }
+  vtk_sqlite3_reset(statement);
+
+  this->MBTilesInternals->Release(connection);
+  return !data.empty();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMBTilesTileSource::ReadTileImage(int zoom, int x, int y,
+                                                  int *status)
+{
+  // The package doesn't change, so tiles that can't be read now
+  // are considered missing
+  vtkImageData *image = NULL;
+  std::vector<unsigned char> data;
+  if (this->ReadTileData(zoom, x, y, data))
+    {
+    image = vtkMapTile::DecodeImage(&data[0], data.size(), this->Codec);
+    if (!image)
+      {
+      vtkWarningMacro("Cannot decode tile " << zoom << "/" << x << "/" << y
+                      << " in " << this->FileName);
+      }
+    }
+
+  if (status)
+    {
+    *status = image ? vtkMapTile::DownloadOK : vtkMapTile::DownloadMissing;
+    }
+  return image;
+}
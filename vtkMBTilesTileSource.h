@@ -0,0 +1,89 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMBTilesTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMBTilesTileSource - map tiles read from an MBTiles package
+// .SECTION Description
+// Reads tile images from an MBTiles file, a SQLite database with a
+// "tiles" table (https://github.com/mapbox/mbtiles-spec), for offline
+// maps. Tiles are decoded in memory: nothing is downloaded, and no
+// files are written to the cache directory.
+//
+// Reads go through a pool of read-only database connections, one per
+// concurrent caller, so ReadTileImage() can run synchronously on the
+// tile layer worker threads.
+
+#ifndef __vtkMBTilesTileSource_h
+#define __vtkMBTilesTileSource_h
+
+#include "vtkMapTileSource.h"
+#include "vtkmap_export.h"
+
+#include <vector>
+
+class VTKMAP_EXPORT vtkMBTilesTileSource : public vtkMapTileSource
+{
+public:
+  static vtkMBTilesTileSource *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMBTilesTileSource, vtkMapTileSource)
+
+  // Description:
+  // Get/Set the MBTiles file. Setting it closes open connections.
+  void SetFileName(const char *filename);
+  vtkGetStringMacro(FileName)
+
+  // Description:
+  // Get/Set the maximum number of open connections. Callers wait
+  // while all of them are in use. Default is 6.
+  vtkSetMacro(MaxConnections, int)
+  vtkGetMacro(MaxConnections, int)
+
+  // Description:
+  // Tiles are decoded from the package
+  virtual bool ProvidesImages() { return true; }
+
+  // Description:
+  // Read and decode tile (zoom, x, y), with OSM tile indices.
+  // Returns a new image that the caller must Delete(), or NULL if
+  // the package doesn't contain the tile (status is then always
+  // vtkMapTile::DownloadMissing). Thread safe.
+  virtual vtkImageData *ReadTileImage(int zoom, int x, int y,
+                                      int *status = NULL);
+
+  // Description:
+  // Read the encoded image of tile (zoom, x, y) into data.
+  // Returns false if the package doesn't contain the tile. Thread safe.
+  bool ReadTileData(int zoom, int x, int y, std::vector<unsigned char>& data);
+
+  // Description:
+  // Close the open connections; they are reopened on demand.
+  // Connections in use are closed when released.
+  void CloseConnections();
+
+protected:
+  vtkMBTilesTileSource();
+  ~vtkMBTilesTileSource();
+
+  char *FileName;
+  int MaxConnections;
+
+  class vtkMBTilesTileSourceInternals;
+  vtkMBTilesTileSourceInternals *MBTilesInternals;
+
+private:
+  vtkMBTilesTileSource(const vtkMBTilesTileSource&);  // Not implemented
+  vtkMBTilesTileSource& operator=(const vtkMBTilesTileSource&); // Not implemented
+};
+
+#endif // __vtkMBTilesTileSource_h
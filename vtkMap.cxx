@@ -24,9 +24,12 @@
 #include <vtkActor2D.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCamera.h>
+#include <vtkDataArray.h>
 #include <vtkImageInPlaceFilter.h>
 #include <vtkMath.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
 #include <vtkObjectFactory.h>
 #include <vtkPlaneSource.h>
 #include <vtkPointPicker.h>
@@ -34,6 +37,7 @@
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
+#include <vtkTimerLog.h>
 #include <vtksys/SystemTools.hxx>
 
 #include <algorithm>
@@ -42,39 +46,242 @@
 #include <iterator>
 #include <math.h>
 #include <sstream>
+#include <vector>
 
 vtkStandardNewMacro(vtkMap)
 
 //----------------------------------------------------------------------------
-double computeCameraDistance(vtkCamera* cam, int zoomLevel)
+double computeCameraDistance(vtkCamera* cam, double zoomLevel)
 {
   double deg = 360.0 / std::pow( 2.0, zoomLevel);
   return (deg / std::sin(vtkMath::RadiansFromDegrees(cam->GetViewAngle())));
 }
 
 //----------------------------------------------------------------------------
-int computeZoomLevel(vtkCamera* cam)
+int computeZoomLevel(vtkCamera* cam, int maxZoom)
 {
   double* pos = cam->GetPosition();
   double width = pos[2] * sin(vtkMath::RadiansFromDegrees(cam->GetViewAngle()));
 
-  for (int i = 0; i < 20; ++i) {
+  for (int i = 0; i <= maxZoom; ++i) {
     if (width >= (360.0 / std::pow( 2.0, i))) {
       /// We are forcing the minimum zoom level to 2 so that we can get
       /// high res imagery even at the zoom level 0 distance
       return i;
     }
   }
-  return 0;
+  // Closer than the highest level
+  return maxZoom;
+}
+
+//----------------------------------------------------------------------------
+double computeFractionalZoom(vtkCamera* cam, int maxZoom)
+{
+  double* pos = cam->GetPosition();
+  double width = pos[2] * sin(vtkMath::RadiansFromDegrees(cam->GetViewAngle()));
+  if (width <= 0.0)
+    {
+    return maxZoom;
+    }
+  double zoom = log(360.0 / width) / log(2.0);
+  return std::max(0.0, std::min(zoom, static_cast<double>(maxZoom)));
+}
+
+//----------------------------------------------------------------------------
+// Returns longitude (or world x) wrapped to [-180, 180)
+double wrapLongitude(double lon)
+{
+  return lon - 360.0 * floor((lon + 180.0) / 360.0);
 }
 
 //----------------------------------------------------------------------------
 static void StaticPollingCallback(
   vtkObject* caller, long unsigned int vtkNotUsed(eventId),
-    void* clientData, void* vtkNotUsed(callData))
+    void* clientData, void* callData)
 {
+  // Skip the events of other timers, e.g. the frame timer
   vtkMap *self = static_cast<vtkMap*>(clientData);
-  self->PollingCallback();
+  if (callData && *static_cast<int*>(callData) == self->GetPollingTimerId())
+    {
+    self->PollingCallback();
+    }
+}
+
+//----------------------------------------------------------------------------
+static void StaticFrameCallback(
+  vtkObject* vtkNotUsed(caller), long unsigned int vtkNotUsed(eventId),
+    void* clientData, void* callData)
+{
+  // Timer events pass the id of the timer
+  vtkMap *self = static_cast<vtkMap*>(clientData);
+  if (callData)
+    {
+    self->FrameCallback(*static_cast<int*>(callData));
+    }
+}
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Number of keyframes of a flight whose tiles are requested ahead
+const int FlightKeyframes = 8;
+
+// Smallest number of points transformed per thread
+const vtkIdType MinPointsPerThread = 16384;
+
+// Number of points projected at a time by TransformRange()
+const vtkIdType TransformBlockSize = 256;
+
+// Transform between map and display coordinates
+struct TransformJob
+{
+  double Matrix[16];  // world to view, or view to world
+  double Scale[2];    // view to display
+  double Offset[2];
+  const double *Input;
+  double *Output;
+  vtkIdType NumberOfPoints;
+  int Components;
+  bool ToDisplay;
+};
+
+//----------------------------------------------------------------------------
+// Transform points [begin, end) of job, in blocks whose latitudes are
+// projected with the batch Mercator functions
+void TransformRange(const TransformJob& job, vtkIdType begin, vtkIdType end)
+{
+  const double *m = job.Matrix;
+  const int nc = job.Components;
+  double y[TransformBlockSize];
+  for (vtkIdType first = begin; first < end; first += TransformBlockSize)
+    {
+    vtkIdType n = std::min(TransformBlockSize, end - first);
+    const double *in = job.Input + first * nc;
+    double *out = job.Output + first * nc;
+    if (job.ToDisplay)
+      {
+      // [latitude, longitude, elevation] to world, to view, to display
+      for (vtkIdType i = 0; i < n; ++i)
+        {
+        y[i] = in[i * nc];
+        }
+      vtkMercator::lat2y(y, y, n);
+      for (vtkIdType i = 0; i < n; ++i, in += nc, out += nc)
+        {
+        double p[3];
+        p[0] = in[1];
+        p[1] = y[i];
+        p[2] = (nc == 3) ? in[2] : 0.0;
+        double w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+        double s = (w != 0.0) ? 1.0 / w : 1.0;
+        double vx = (m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3]) * s;
+        double vy = (m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7]) * s;
+        double vz = (m[8] * p[0] + m[9] * p[1] + m[10] * p[2] + m[11]) * s;
+        out[0] = (vx + 1.0) * job.Scale[0] + job.Offset[0];
+        out[1] = (vy + 1.0) * job.Scale[1] + job.Offset[1];
+        if (nc == 3)
+          {
+          out[2] = vz;
+          }
+        }
+      }
+    else
+      {
+      // Display to view, to world, to [latitude, longitude, 0]
+      for (vtkIdType i = 0; i < n; ++i, in += nc, out += nc)
+        {
+        double p[3];
+        p[0] = (in[0] - job.Offset[0]) / job.Scale[0] - 1.0;
+        p[1] = (in[1] - job.Offset[1]) / job.Scale[1] - 1.0;
+        p[2] = (nc == 3) ? in[2] : 0.0;
+        double w = m[12] * p[0] + m[13] * p[1] + m[14] * p[2] + m[15];
+        double s = (w != 0.0) ? 1.0 / w : 1.0;
+        out[1] = (m[0] * p[0] + m[1] * p[1] + m[2] * p[2] + m[3]) * s;
+        y[i] = (m[4] * p[0] + m[5] * p[1] + m[6] * p[2] + m[7]) * s;
+        if (nc == 3)
+          {
+          out[2] = 0.0;
+          }
+        }
+      vtkMercator::y2lat(y, y, n);
+      out = job.Output + first * nc;
+      for (vtkIdType i = 0; i < n; ++i, out += nc)
+        {
+        out[0] = y[i];
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Thread method transforming one contiguous part of the job's points
+VTK_THREAD_RETURN_TYPE StaticTransformThread(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  const TransformJob *job = static_cast<TransformJob*>(info->UserData);
+  vtkIdType n = job->NumberOfPoints;
+  TransformRange(*job, n * info->ThreadID / info->NumberOfThreads,
+                 n * (info->ThreadID + 1) / info->NumberOfThreads);
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+// Transform points to a new double precision vtkPoints
+vtkPoints *TransformPoints(vtkMap *map, vtkPoints *points, bool toDisplay)
+{
+  vtkIdType n = points->GetNumberOfPoints();
+  vtkPoints* newPoints = vtkPoints::New(VTK_DOUBLE);
+  newPoints->SetNumberOfPoints(n);
+  if (n == 0)
+    {
+    return newPoints;
+    }
+
+  std::vector<double> coords;
+  const double *input = NULL;
+  if (points->GetDataType() == VTK_DOUBLE)
+    {
+    input = static_cast<double*>(points->GetData()->GetVoidPointer(0));
+    }
+  else
+    {
+    coords.resize(3 * n);
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      points->GetPoint(i, &coords[3 * i]);
+      }
+    input = &coords[0];
+    }
+
+  double *output =
+    static_cast<double*>(newPoints->GetData()->GetVoidPointer(0));
+  if (toDisplay)
+    {
+    map->gcsToDisplay(input, output, n);
+    }
+  else
+    {
+    map->displayToGcs(input, output, n);
+    }
+  return newPoints;
+}
+}
+
+//----------------------------------------------------------------------------
+// Thread method preparing every NumberOfThreads-th layer of the list
+static VTK_THREAD_RETURN_TYPE StaticPrepareLayers(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  std::vector<vtkLayer*> *layers =
+    static_cast<std::vector<vtkLayer*>*>(info->UserData);
+  for (size_t i = info->ThreadID; i < layers->size();
+       i += info->NumberOfThreads)
+    {
+    (*layers)[i]->PrepareUpdate();
+    }
+  return VTK_THREAD_RETURN_VALUE;
 }
 
 //----------------------------------------------------------------------------
@@ -86,13 +293,26 @@ vtkMap::vtkMap()
   this->InteractorStyle->SetMap(this);
   this->Picker = vtkPointPicker::New();
   this->Zoom = 1;
+  this->MaxZoom = 22;
+  this->ZoomStep = 1.0;
   this->Center[0] = this->Center[1] = 0.0;
   this->MapMarkerSet = vtkMapMarkerSet::New();
   this->Initialized = false;
   this->BaseLayer = NULL;
   this->PollingCallbackCommand = NULL;
+  this->PollingTimerId = 0;
   this->CurrentAsyncState = AsyncOff;
-
+  this->UpdateSize[0] = this->UpdateSize[1] = 0;
+  this->FrameInterval = 16;
+  this->FrameTimerId = 0;
+  this->FrameCallbackCommand = NULL;
+  this->Flying = false;
+  this->FlightStart[0] = this->FlightStart[1] = this->FlightStart[2] = 0.0;
+  this->FlightEnd[0] = this->FlightEnd[1] = this->FlightEnd[2] = 0.0;
+  this->FlightZoomOut = 0.0;
+  this->FlightStartTime = 0.0;
+  this->FlightDuration = 0.0;
+  this->FlightKeyframe = 0;
 
   // Set default storage directory to ~/.vtkmap
   std::string fullPath =
@@ -103,6 +323,10 @@ vtkMap::vtkMap()
 //----------------------------------------------------------------------------
 vtkMap::~vtkMap()
 {
+  while (!this->Viewports.empty())
+    {
+    this->RemoveViewport(this->Viewports.back().Renderer);
+    }
   if (this->InteractorStyle)
     {
     this->InteractorStyle->Delete();
@@ -119,6 +343,10 @@ vtkMap::~vtkMap()
     {
     this->PollingCallbackCommand->Delete();
     }
+  if (this->FrameCallbackCommand)
+    {
+    this->FrameCallbackCommand->Delete();
+    }
   if ( this->StorageDirectory )
     {
     delete[] StorageDirectory;
@@ -152,6 +380,11 @@ void vtkMap::PrintSelf(ostream &os, vtkIndent indent)
   double *camPosition = this->Renderer->GetActiveCamera()->GetPosition();
   double *focalPosition = this->Renderer->GetActiveCamera()->GetFocalPoint();
   os << "  Zoom Level: " << this->Zoom << "\n"
+     << "  Max Zoom Level: " << this->MaxZoom << "\n"
+     << "  Zoom Step: " << this->ZoomStep << "\n"
+     << "  Frame Interval: " << this->FrameInterval << " ms\n"
+     << "  Flying: " << (this->Flying ? "On" : "Off") << "\n"
+     << "  Viewports: " << this->Viewports.size() << "\n"
      << "  Center Lat/Lon: " << this->Center[1] << " "
      << this->Center[0] << "\n"
      << "  Camera Position: " << camPosition[0] << " "
@@ -177,22 +410,19 @@ void vtkMap::SetVisibleBounds(double latLngCoords[4])
   worldCoords[2] = latLngCoords[3];
   worldCoords[3] = vtkMercator::lat2y(latLngCoords[2]);
 
+  // The bounds span the shorter way between the longitudes, which
+  // crosses the antimeridian if they are more than 180 degrees apart
+  worldCoords[2] =
+    worldCoords[0] + wrapLongitude(worldCoords[2] - worldCoords[0]);
+
   // Compute size as the larger of delta lon/lat
   double deltaLon = fabs(worldCoords[2] - worldCoords[0]);
-  if (deltaLon > 180.0)
-    {
-    // If > 180, then points wrap around the 180th meridian
-    // Adjust things to be > 0
-    deltaLon = 360.0 - deltaLon;
-    worldCoords[0] += worldCoords[0] < 0.0 ? 360.0 : 0;
-    worldCoords[2] += worldCoords[2] < 0.0 ? 360.0 : 0;
-    }
   double deltaLat = fabs(worldCoords[3] - worldCoords[1]);
   double delta = deltaLon > deltaLat ? deltaLon : deltaLat;
 
   // Compute zoom level
   double maxDelta = 360.0;
-  double maxZoom = 20;
+  double maxZoom = this->MaxZoom + 1;
   int zoom = 0;
   for (zoom=0; delta < maxDelta && zoom < maxZoom; zoom++)
     {
@@ -203,11 +433,7 @@ void vtkMap::SetVisibleBounds(double latLngCoords[4])
   // Compute center
   double center[2];
   center[0] = 0.5 * (latLngCoords[0] + latLngCoords[2]);
-  if (center[0] > 180.0)
-    {
-    center[0] -= 360.0;
-    }
-  center[1] = 0.5 * (latLngCoords[1] + latLngCoords[3]);
+  center[1] = wrapLongitude(0.5 * (worldCoords[0] + worldCoords[2]));
 
   this->SetCenter(center);
   this->SetZoom(zoom);
@@ -342,6 +568,7 @@ void vtkMap::AddLayer(vtkLayer* layer)
     }
 
   layer->SetMap(this);
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -355,6 +582,86 @@ void vtkMap::RemoveLayer(vtkLayer* layer)
 
   this->Layers.erase(std::remove(this->Layers.begin(),
                                  this->Layers.end(), layer));
+  for (size_t i = 0; i < this->Viewports.size(); ++i)
+    {
+    layer->RemoveViewport(this->Viewports[i].Renderer);
+    }
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::AddViewport(vtkRenderer *renderer, bool follow,
+                         double zoomOffset)
+{
+  if (!renderer || renderer == this->Renderer ||
+      this->GetViewportIndex(renderer) >= 0)
+    {
+    return;
+    }
+
+  Viewport viewport;
+  viewport.Renderer = renderer;
+  viewport.Follow = follow;
+  viewport.ZoomOffset = zoomOffset;
+  renderer->Register(this);
+  this->Viewports.push_back(viewport);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::RemoveViewport(vtkRenderer *renderer)
+{
+  int index = this->GetViewportIndex(renderer);
+  if (index < 0)
+    {
+    return;
+    }
+
+  if (this->BaseLayer)
+    {
+    this->BaseLayer->RemoveViewport(renderer);
+    }
+  for (size_t i = 0; i < this->Layers.size(); ++i)
+    {
+    this->Layers[i]->RemoveViewport(renderer);
+    }
+  vtkActor *markers = this->MapMarkerSet->GetActor();
+  if (markers)
+    {
+    renderer->RemoveActor(markers);
+    }
+
+  this->Viewports.erase(this->Viewports.begin() + index);
+  renderer->UnRegister(this);
+}
+
+//----------------------------------------------------------------------------
+int vtkMap::GetNumberOfViewports()
+{
+  return static_cast<int>(this->Viewports.size());
+}
+
+//----------------------------------------------------------------------------
+vtkRenderer *vtkMap::GetViewport(int index)
+{
+  if (index < 0 || index >= this->GetNumberOfViewports())
+    {
+    return NULL;
+    }
+  return this->Viewports[index].Renderer;
+}
+
+//----------------------------------------------------------------------------
+int vtkMap::GetViewportIndex(vtkRenderer *renderer)
+{
+  for (size_t i = 0; i < this->Viewports.size(); ++i)
+    {
+    if (this->Viewports[i].Renderer == renderer)
+      {
+      return static_cast<int>(i);
+      }
+    }
+  return -1;
 }
 
 //----------------------------------------------------------------------------
@@ -384,18 +691,121 @@ void vtkMap::Update()
     return;
     }
 
-  // Compute the zoom level here
-  this->SetZoom(computeZoomLevel(this->Renderer->GetActiveCamera()));
+  // The view changes with the camera, the renderer size and the
+  // map settings (including the layers added or removed)
+  unsigned long updateTime = this->UpdateTime.GetMTime();
+  vtkCamera *camera = this->Renderer->GetActiveCamera();
+  int *size = this->Renderer->GetSize();
+  bool viewChanged = camera->GetMTime() > updateTime ||
+    this->GetMTime() > updateTime ||
+    size[0] != this->UpdateSize[0] || size[1] != this->UpdateSize[1];
+
+  // Compute the zoom level here, and bring views panned past the
+  // antimeridian back to the same view of the map (layers display
+  // the world copies around it)
+  if (viewChanged)
+    {
+    this->SetZoom(computeZoomLevel(camera, this->MaxZoom));
 
-  // Update the base layer first
-  this->BaseLayer->Update();
+    double *focalPoint = camera->GetFocalPoint();
+    double shift = wrapLongitude(focalPoint[0]) - focalPoint[0];
+    if (shift != 0.0)
+      {
+      double *position = camera->GetPosition();
+      camera->SetPosition(position[0] + shift, position[1], position[2]);
+      camera->SetFocalPoint(focalPoint[0] + shift, focalPoint[1],
+                            focalPoint[2]);
+      }
+    }
 
+  // Update the base layer first. Layers are modified by their own
+  // changes, e.g. new features or tiles.
+  std::vector<vtkLayer*> layers;
+  if (viewChanged || this->BaseLayer->GetMTime() > updateTime)
+    {
+    layers.push_back(this->BaseLayer);
+    }
   for (size_t i = 0; i < this->Layers.size(); ++i)
     {
-    this->Layers[i]->Update();
+    if (viewChanged || this->Layers[i]->GetMTime() > updateTime)
+      {
+      layers.push_back(this->Layers[i]);
+      }
+    }
+
+  // Prepare the layers concurrently, then change the render objects
+  // on this thread only
+  if (layers.size() > 1)
+    {
+    vtkNew<vtkMultiThreader> threader;
+    threader->SetNumberOfThreads(
+      std::min(static_cast<int>(layers.size()),
+               vtkMultiThreader::GetGlobalDefaultNumberOfThreads()));
+    threader->SetSingleMethod(StaticPrepareLayers, &layers);
+    threader->SingleMethodExecute();
+    }
+  else if (layers.size() == 1)
+    {
+    layers[0]->PrepareUpdate();
+    }
+  for (size_t i = 0; i < layers.size(); ++i)
+    {
+    layers[i]->Update();
+    }
+
+  bool markersChanged = this->MapMarkerSet->GetMTime() > updateTime;
+  if (viewChanged || markersChanged)
+    {
+    this->MapMarkerSet->Update(this->Zoom);
     }
 
-  this->MapMarkerSet->Update(this->Zoom);
+  this->UpdateViewports(viewChanged || markersChanged || !layers.empty());
+
+  this->UpdateTime.Modified();
+  this->UpdateSize[0] = size[0];
+  this->UpdateSize[1] = size[1];
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::UpdateViewports(bool mapUpdated)
+{
+  vtkActor *markers = this->MapMarkerSet->GetActor();
+  std::vector<Viewport>::iterator viewport = this->Viewports.begin();
+  for (; viewport != this->Viewports.end(); ++viewport)
+    {
+    vtkRenderer *renderer = viewport->Renderer;
+    vtkCamera *camera = renderer->GetActiveCamera();
+    if (viewport->Follow && mapUpdated)
+      {
+      double *focalPoint = this->Renderer->GetActiveCamera()->GetFocalPoint();
+      double zoom = this->Clip(this->GetFractionalZoom() + viewport->ZoomOffset,
+                               0.0, this->MaxZoom);
+      double x = focalPoint[0];
+      double y = focalPoint[1];
+      camera->SetPosition(x, y, computeCameraDistance(camera, zoom));
+      camera->SetFocalPoint(x, y, 0.0);
+      renderer->ResetCameraClippingRange();
+      }
+    else if (!mapUpdated &&
+             camera->GetMTime() <= viewport->UpdateTime.GetMTime())
+      {
+      continue;
+      }
+
+    if (this->BaseLayer)
+      {
+      this->BaseLayer->UpdateViewport(renderer);
+      }
+    for (size_t i = 0; i < this->Layers.size(); ++i)
+      {
+      this->Layers[i]->UpdateViewport(renderer);
+      }
+    if (markers && !renderer->HasViewProp(markers))
+      {
+      renderer->AddActor(markers);
+      }
+    viewport->UpdateTime.Modified();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -435,28 +845,6 @@ void vtkMap::Draw()
       vtksys::SystemTools::MakeDirectory(this->StorageDirectory);
       }
 
-    // Initialize polling timer if there are any asynchronous layers
-    std::vector<vtkLayer*> allLayers(this->Layers);
-    allLayers.push_back(this->BaseLayer);
-    for (size_t i = 0; i < allLayers.size(); ++i)
-      {
-      if (allLayers[i]->IsAsynchronous())
-        {
-        this->PollingCallbackCommand = vtkCallbackCommand::New();
-        this->PollingCallbackCommand->SetClientData(this);
-        this->PollingCallbackCommand->SetCallback(StaticPollingCallback);
-
-        vtkRenderWindowInteractor *interactor
-          = this->Renderer->GetRenderWindow()->GetInteractor();
-        interactor->CreateRepeatingTimer(31);  // prime number > 30 fps
-        interactor->AddObserver(vtkCommand::TimerEvent,
-                                this->PollingCallbackCommand);
-
-        break;
-        }
-      }
-
-
     // Initialize graphics
     double x = this->Center[1];
     double y = vtkMercator::lat2y(this->Center[0]);
@@ -466,8 +854,226 @@ void vtkMap::Draw()
     this->Renderer->GetActiveCamera()->SetFocalPoint(x, y, 0.0);
     this->Renderer->GetRenderWindow()->Render();
     }
+
+  // This draw serves any pending request
+  if (this->FrameTimerId)
+    {
+    vtkRenderWindowInteractor *interactor =
+      this->Renderer->GetRenderWindow()->GetInteractor();
+    if (interactor)
+      {
+      interactor->DestroyTimer(this->FrameTimerId);
+      }
+    this->FrameTimerId = 0;
+    }
+
+  if (this->Flying)
+    {
+    this->UpdateFlight();
+    }
+
   this->Update();
   this->Renderer->GetRenderWindow()->Render();
+
+  // Poll the asynchronous layers for the work the update queued
+  this->StartPolling();
+
+  if (this->Flying)
+    {
+    this->RequestDraw();
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkMap::GetFractionalZoom()
+{
+  if (!this->Renderer)
+    {
+    return this->Zoom;
+    }
+  return computeFractionalZoom(this->Renderer->GetActiveCamera(),
+                               this->MaxZoom);
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::RequestDraw()
+{
+  if (this->FrameTimerId)
+    {
+    // Already scheduled
+    return;
+    }
+
+  vtkRenderWindowInteractor *interactor = NULL;
+  if (this->Initialized && this->Renderer->GetRenderWindow())
+    {
+    interactor = this->Renderer->GetRenderWindow()->GetInteractor();
+    }
+  if (!interactor)
+    {
+    this->Draw();
+    return;
+    }
+
+  if (!this->FrameCallbackCommand)
+    {
+    this->FrameCallbackCommand = vtkCallbackCommand::New();
+    this->FrameCallbackCommand->SetClientData(this);
+    this->FrameCallbackCommand->SetCallback(StaticFrameCallback);
+    interactor->AddObserver(vtkCommand::TimerEvent,
+                            this->FrameCallbackCommand);
+    }
+  this->FrameTimerId = interactor->CreateOneShotTimer(this->FrameInterval);
+  if (!this->FrameTimerId)
+    {
+    // No timer support; flights end at once
+    this->FlightDuration = 0.0;
+    this->Draw();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::FrameCallback(int timerId)
+{
+  if (timerId != 0 && timerId == this->FrameTimerId)
+    {
+    this->FrameTimerId = 0;
+    this->Draw();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::FlyTo(double latitude, double longitude, double zoom,
+                   double duration)
+{
+  if (!this->Renderer || !this->Renderer->GetRenderWindow())
+    {
+    vtkErrorMacro("No renderer to fly in");
+    return;
+    }
+
+  double *focalPoint = this->Renderer->GetActiveCamera()->GetFocalPoint();
+  this->FlightStart[0] = focalPoint[0];
+  this->FlightStart[1] = focalPoint[1];
+  this->FlightStart[2] = this->GetFractionalZoom();
+  // Fly the shorter way around the world
+  this->FlightEnd[0] = this->FlightStart[0] +
+    wrapLongitude(wrapLongitude(longitude) - this->FlightStart[0]);
+  this->FlightEnd[1] =
+    vtkMercator::lat2y(this->Clip(latitude, -85.0511, 85.0511));
+  this->FlightEnd[2] = this->Clip(zoom, 0.0, this->MaxZoom);
+
+  // At mid flight, the view is at least twice as wide as the distance
+  // between the ends (the view at zoom is 360 / 2^zoom wide)
+  double distance = std::max(fabs(this->FlightEnd[0] - this->FlightStart[0]),
+                             fabs(this->FlightEnd[1] - this->FlightStart[1]));
+  this->FlightZoomOut = 0.0;
+  if (distance > 0.0)
+    {
+    double midZoom = std::max(0.0, log(180.0 / distance) / log(2.0));
+    this->FlightZoomOut = std::max(0.0,
+      0.5 * (this->FlightStart[2] + this->FlightEnd[2]) - midZoom);
+    }
+
+  this->Flying = true;
+  this->FlightStartTime = vtkTimerLog::GetUniversalTime();
+  this->FlightDuration = std::max(0.0, duration);
+  this->FlightKeyframe = 0;
+
+  // Requests are queued ahead of earlier ones: request the last
+  // keyframe first so that the first one is fetched first
+  int keyframes = this->FlightDuration > 0.0 ? FlightKeyframes : 1;
+  for (int i = keyframes; i > 0; --i)
+    {
+    this->PrefetchFlightView(static_cast<double>(i) / keyframes);
+    }
+
+  this->RequestDraw();
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::StopFlyTo()
+{
+  this->Flying = false;
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::ComputeFlightView(double t, double view[3])
+{
+  // Ease in and out between the ends, zooming out along a parabola
+  double s = t * t * (3.0 - 2.0 * t);
+  view[0] = this->FlightStart[0] + s * (this->FlightEnd[0] - this->FlightStart[0]);
+  view[1] = this->FlightStart[1] + s * (this->FlightEnd[1] - this->FlightStart[1]);
+  view[2] = this->FlightStart[2] + t * (this->FlightEnd[2] - this->FlightStart[2])
+    - 4.0 * t * (1.0 - t) * this->FlightZoomOut;
+  view[2] = std::max(0.0, view[2]);
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::UpdateFlight()
+{
+  // Without frame scheduling, the flight ends at once
+  double t = 1.0;
+  if (this->FlightDuration > 0.0 &&
+      this->Renderer->GetRenderWindow()->GetInteractor())
+    {
+    double elapsed = vtkTimerLog::GetUniversalTime() - this->FlightStartTime;
+    t = this->Clip(elapsed / this->FlightDuration, 0.0, 1.0);
+    }
+
+  double view[3];
+  this->ComputeFlightView(t, view);
+  vtkCamera *camera = this->Renderer->GetActiveCamera();
+  double distance = computeCameraDistance(camera, view[2]);
+  camera->SetPosition(view[0], view[1], distance);
+  camera->SetFocalPoint(view[0], view[1], 0.0);
+
+  // The current view is requested by the update; keep the next
+  // keyframe right behind it
+  int keyframe = static_cast<int>(t * FlightKeyframes) + 1;
+  if (keyframe > this->FlightKeyframe && keyframe <= FlightKeyframes)
+    {
+    this->FlightKeyframe = keyframe;
+    this->PrefetchFlightView(static_cast<double>(keyframe) / FlightKeyframes);
+    }
+
+  if (t >= 1.0)
+    {
+    this->Flying = false;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::PrefetchFlightView(double t)
+{
+  int *size = this->Renderer->GetSize();
+  if (size[0] <= 0 || size[1] <= 0)
+    {
+    return;
+    }
+
+  // The view angle is vertical
+  double view[3];
+  this->ComputeFlightView(t, view);
+  double angle = vtkMath::RadiansFromDegrees(
+    this->Renderer->GetActiveCamera()->GetViewAngle());
+  double distance = (360.0 / std::pow(2.0, view[2])) / sin(angle);
+  double height = 2.0 * distance * tan(0.5 * angle);
+  double width = height * size[0] / size[1];
+  double bounds[4] =
+    {
+    view[0] - 0.5 * width, view[0] + 0.5 * width,
+    view[1] - 0.5 * height, view[1] + 0.5 * height
+    };
+
+  if (this->BaseLayer)
+    {
+    this->BaseLayer->Prefetch(bounds, size[0]);
+    }
+  for (size_t i = 0; i < this->Layers.size(); ++i)
+    {
+    this->Layers[i]->Prefetch(bounds, size[0]);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -546,13 +1152,73 @@ void vtkMap::PollingCallback()
     }
   this->CurrentAsyncState = newState;
 
-  // Current strawman is to redraw on partial or full update
+  // Stop waking up once all work is done
+  if (newState == AsyncIdle)
+    {
+    this->StopPolling();
+    }
+
+  // Redraw on partial or full update, along with any interaction
   if (newState >= AsyncPartialUpdate)
     {
-    this->Draw();
+    this->RequestDraw();
     }
 }
 
+//----------------------------------------------------------------------------
+void vtkMap::StartPolling()
+{
+  if (this->PollingTimerId || !this->Renderer ||
+      !this->Renderer->GetRenderWindow())
+    {
+    return;
+    }
+  vtkRenderWindowInteractor *interactor =
+    this->Renderer->GetRenderWindow()->GetInteractor();
+  if (!interactor)
+    {
+    return;
+    }
+
+  // Only asynchronous layers need polling
+  bool hasAsyncLayers = this->BaseLayer && this->BaseLayer->IsAsynchronous();
+  for (size_t i = 0; i < this->Layers.size() && !hasAsyncLayers; ++i)
+    {
+    hasAsyncLayers = this->Layers[i]->IsAsynchronous();
+    }
+  if (!hasAsyncLayers)
+    {
+    return;
+    }
+
+  if (!this->PollingCallbackCommand)
+    {
+    this->PollingCallbackCommand = vtkCallbackCommand::New();
+    this->PollingCallbackCommand->SetClientData(this);
+    this->PollingCallbackCommand->SetCallback(StaticPollingCallback);
+    interactor->AddObserver(vtkCommand::TimerEvent,
+                            this->PollingCallbackCommand);
+    }
+  this->PollingTimerId =
+    interactor->CreateRepeatingTimer(31);  // prime number > 30 fps
+}
+
+//----------------------------------------------------------------------------
+void vtkMap::StopPolling()
+{
+  if (!this->PollingTimerId)
+    {
+    return;
+    }
+  vtkRenderWindowInteractor *interactor =
+    this->Renderer->GetRenderWindow()->GetInteractor();
+  if (interactor)
+    {
+    interactor->DestroyTimer(this->PollingTimerId);
+    }
+  this->PollingTimerId = 0;
+}
+
 //----------------------------------------------------------------------------
 vtkPoints* vtkMap::gcsToDisplay(vtkPoints* points, std::string srcProjection)
 {
@@ -560,65 +1226,84 @@ vtkPoints* vtkMap::gcsToDisplay(vtkPoints* points, std::string srcProjection)
    {
    vtkErrorMacro("Does not handle projections other than latlon");
    }
-  int noOfPoints = static_cast<int>(points->GetNumberOfPoints());
-  double inPoint[3];
-  double outPoint[3];
-  vtkPoints* newPoints = vtkPoints::New(VTK_DOUBLE);
-  newPoints->SetNumberOfPoints(noOfPoints);
-  double latitude, longitude;
-  double x, y;
-  for (int i = 0; i < noOfPoints; ++i)
-    {
-    points->GetPoint(i, inPoint);
-    latitude = inPoint[0];
-    longitude = inPoint[1];
-    x = longitude;
-    y = vtkMercator::lat2y(latitude);
-
-    inPoint[0] = vtkMercator::lat2y(inPoint[0]);
-    //this->Renderer->SetWorldPoint(inPoint[1], inPoint[0], inPoint[2], 1.0);
-    this->Renderer->SetWorldPoint(x, y, inPoint[2], 1.0);
-    this->Renderer->WorldToDisplay();
-    this->Renderer->GetDisplayPoint(outPoint);
-    newPoints->SetPoint(i, outPoint);
-    }
-
-  return newPoints;
+  return TransformPoints(this, points, true);
 }
 
 //----------------------------------------------------------------------------
 vtkPoints* vtkMap::displayToGcs(vtkPoints* points)
 {
-  double inPoint[3];
-  double outPoint[3];
-  int noOfPoints = static_cast<int>(points->GetNumberOfPoints());
-  vtkPoints* newPoints = vtkPoints::New(VTK_DOUBLE);
-  newPoints->SetNumberOfPoints(noOfPoints);
-  double wCoords[4];
-  for (int i = 0; i < noOfPoints; ++i)
-    {
-    points->GetPoint(i, inPoint);
-    this->Renderer->SetDisplayPoint(inPoint[0], inPoint[1], inPoint[2]);
-    this->Renderer->DisplayToWorld();
-    this->Renderer->GetWorldPoint(wCoords);
+  return TransformPoints(this, points, false);
+}
 
-    if (wCoords[3] != 0.0)
-      {
-      wCoords[0] /= wCoords[3];
-      wCoords[1] /= wCoords[3];
-      wCoords[2] /= wCoords[3];
-      wCoords[3] = 1.0;
-      }
+//----------------------------------------------------------------------------
+void vtkMap::gcsToDisplay(const double *gcsCoords, double *displayCoords,
+                          vtkIdType numberOfPoints, int components)
+{
+  this->TransformCoords(gcsCoords, displayCoords, numberOfPoints,
+                        components, true);
+}
 
-    double latitude = vtkMercator::y2lat(wCoords[1]);
-    double longitude = wCoords[0];
+//----------------------------------------------------------------------------
+void vtkMap::displayToGcs(const double *displayCoords, double *gcsCoords,
+                          vtkIdType numberOfPoints, int components)
+{
+  this->TransformCoords(displayCoords, gcsCoords, numberOfPoints,
+                        components, false);
+}
 
-    outPoint[0] = latitude;
-    outPoint[1] = longitude;
-    outPoint[2] = 0.0;
+//----------------------------------------------------------------------------
+void vtkMap::TransformCoords(const double *input, double *output,
+                             vtkIdType numberOfPoints, int components,
+                             bool toDisplay)
+{
+  if (components < 2 || components > 3)
+    {
+    vtkErrorMacro("Invalid number of components " << components);
+    return;
+    }
+  if (!this->Renderer || !this->Renderer->GetRenderWindow() ||
+      numberOfPoints <= 0)
+    {
+    return;
+    }
 
-    newPoints->SetPoint(i, outPoint);
+  // Same transforms as vtkRenderer::WorldToView() and
+  // vtkViewport::ViewToDisplay(), and their inverses
+  TransformJob job;
+  vtkNew<vtkMatrix4x4> matrix;
+  matrix->DeepCopy(this->Renderer->GetActiveCamera()->
+    GetCompositeProjectionTransformMatrix(
+      this->Renderer->GetTiledAspectRatio(), 0, 1));
+  if (!toDisplay)
+    {
+    matrix->Invert();
     }
+  vtkMatrix4x4::DeepCopy(job.Matrix, matrix.GetPointer());
 
-  return newPoints;
+  int *windowSize = this->Renderer->GetRenderWindow()->GetSize();
+  double *viewport = this->Renderer->GetViewport();
+  for (int i = 0; i < 2; ++i)
+    {
+    job.Scale[i] = 0.5 * windowSize[i] * (viewport[i + 2] - viewport[i]);
+    job.Offset[i] = windowSize[i] * viewport[i];
+    }
+  job.Input = input;
+  job.Output = output;
+  job.NumberOfPoints = numberOfPoints;
+  job.Components = components;
+  job.ToDisplay = toDisplay;
+
+  // Small batches are not worth starting threads
+  int numberOfThreads = static_cast<int>(std::min(
+    static_cast<vtkIdType>(vtkMultiThreader::GetGlobalDefaultNumberOfThreads()),
+    numberOfPoints / MinPointsPerThread));
+  if (numberOfThreads < 2)
+    {
+    TransformRange(job, 0, numberOfPoints);
+    return;
+    }
+  vtkNew<vtkMultiThreader> threader;
+  threader->SetNumberOfThreads(numberOfThreads);
+  threader->SetSingleMethod(StaticTransformThread, &job);
+  threader->SingleMethodExecute();
 }
@@ -83,6 +83,25 @@ public:
   vtkGetMacro(Zoom, int)
   vtkSetMacro(Zoom, int)
 
+  // Description:
+  // Get/Set the highest zoom level the map can be zoomed to. Tile
+  // layers magnify the tiles of their source's highest level past it.
+  // Default is 22.
+  vtkGetMacro(MaxZoom, int)
+  vtkSetClampMacro(MaxZoom, int, 0, 24)
+
+  // Description:
+  // Get the continuous zoom level of the current camera, in [0, MaxZoom].
+  // GetZoom() is this level rounded up.
+  double GetFractionalZoom();
+
+  // Description:
+  // Get/Set the zoom levels per mouse wheel step, in [0.05, 1].
+  // Default is 1; use smaller steps for smooth zooming, e.g. with
+  // trackpads, along with vtkOsmLayer::CrossFadeOn().
+  vtkGetMacro(ZoomStep, double)
+  vtkSetClampMacro(ZoomStep, double, 0.05, 1.0)
+
   // Description:
   // Get/Set center of the map
   void GetCenter(double (&latlngPoint)[2]);
@@ -117,14 +136,68 @@ public:
   // Update the renderer with relevant map content
   void Draw();
 
+  // Description:
+  // Schedule a Draw() for the next frame. Requests made before the
+  // frame is drawn, e.g. by bursts of interaction events and tile
+  // arrivals, are coalesced into a single update and render. Draws
+  // right away if the map has no interactor yet.
+  void RequestDraw();
+
+  // Description:
+  // Get/Set the minimum time between two scheduled draws, in
+  // milliseconds (default 16, about 60 frames per second)
+  vtkGetMacro(FrameInterval, int)
+  vtkSetClampMacro(FrameInterval, int, 1, 1000)
+
+  // Description:
+  // Add/Remove a renderer showing another view of the map, e.g. an
+  // overview inset in a corner of the render window. Viewports share
+  // the map's layers, tile cache and markers instead of duplicating
+  // them in a second vtkMap; tile layers select and cull the tiles of
+  // each viewport's camera, and feature layers add their features'
+  // actors to it (see vtkLayer::UpdateViewport()). If follow
+  // is true, the viewport's camera is centered on the map's view, at
+  // zoomOffset levels from it (e.g. -4 for an overview); otherwise the
+  // application moves it and calls Draw(). Markers are drawn with the
+  // cluster level and size of the map's view.
+  void AddViewport(vtkRenderer *renderer, bool follow = true,
+                   double zoomOffset = -4.0);
+  void RemoveViewport(vtkRenderer *renderer);
+  int GetNumberOfViewports();
+  vtkRenderer *GetViewport(int index);
+
+  // Description:
+  // Animate the view to center (latitude, longitude) at the fractional
+  // zoom level zoom, in duration seconds, zooming out along the way so
+  // that distant places come into view before zooming in. The tiles of
+  // keyframes along the flight are requested in order, ahead of other
+  // requests, from the asynchronous layers, before and during the
+  // flight. Frames are drawn by the frame scheduler; without an
+  // interactor, the view moves to the destination at once. Panning
+  // or zooming stops the flight.
+  void FlyTo(double latitude, double longitude, double zoom,
+             double duration = 1.0);
+  void StopFlyTo();
+  bool IsFlying() { return this->Flying; }
+
   // Description:
   // Returns info at specified display coordinates
   void PickPoint(int displayCoords[2], vtkMapPickResult* result);
 
   // Description:
-  // Periodically poll asynchronous layers
+  // Periodically poll asynchronous layers. Polling starts when a
+  // Draw() queues asynchronous work, and stops once all asynchronous
+  // layers are idle, so that an idle map doesn't wake up the CPU.
   void PollingCallback();
 
+  // Description:
+  // Id of the polling timer, 0 when not polling
+  vtkGetMacro(PollingTimerId, int)
+
+  // Description:
+  // Draw the frame scheduled by RequestDraw() when its timer expires
+  void FrameCallback(int timerId);
+
   // Description:
   // Current state of asynchronous layers
   enum AsyncState GetAsyncState();
@@ -143,6 +216,18 @@ public:
   // points will have the following format: [latitude, longitude, elevation]
   vtkPoints* displayToGcs(vtkPoints* points);
 
+  // Description:
+  // Batched transforms between [latitude, longitude, elevation] map
+  // coordinates and display coordinates, for numberOfPoints points of
+  // components (2 or 3) interleaved values each; a missing elevation
+  // or display z is taken as 0. The output array, which may be the
+  // input array, is provided by the caller. The projection is computed
+  // once per call, and large arrays are transformed on several threads.
+  void gcsToDisplay(const double *gcsCoords, double *displayCoords,
+                    vtkIdType numberOfPoints, int components = 3);
+  void displayToGcs(const double *displayCoords, double *gcsCoords,
+                    vtkIdType numberOfPoints, int components = 3);
+
 protected:
   vtkMap();
   ~vtkMap();
@@ -155,6 +240,12 @@ protected:
   void ComputeWorldCoords(double displayCoords[2], double z,
                           double worldCoords[3]);
 
+  // Description:
+  // Implements the batched gcsToDisplay() and displayToGcs()
+  void TransformCoords(const double *input, double *output,
+                       vtkIdType numberOfPoints, int components,
+                       bool toDisplay);
+
   // Description:
   // The renderer used to draw the maps
   vtkRenderer* Renderer;
@@ -171,6 +262,14 @@ protected:
   // Set Zoom level, which determines the level of detailing
   int Zoom;
 
+  // Description:
+  // Highest zoom level
+  int MaxZoom;
+
+  // Description:
+  // Zoom levels per mouse wheel step
+  double ZoomStep;
+
   // Description:
   // Center of the map
   double Center[2];
@@ -195,13 +294,79 @@ protected:
   // List of layers attached to the map
   std::vector<vtkLayer*> Layers;
 
+  // Description:
+  // Start/Stop the polling timer
+  void StartPolling();
+  void StopPolling();
+
   // Description:
   // Callback method for polling timer
   vtkCallbackCommand *PollingCallbackCommand;
+  int PollingTimerId;
 
   // Description:
   // Current state of asynchronous layers
   AsyncState CurrentAsyncState;
+
+  // Description:
+  // Time of the last Update(), and renderer size it was done for.
+  // Update() skips the layers and the marker set if neither the view
+  // nor they have changed since.
+  vtkTimeStamp UpdateTime;
+  int UpdateSize[2];
+
+  // Description:
+  // Frame scheduling: the one shot timer of the pending frame (0 if
+  // none) and the callback drawing it
+  int FrameInterval;
+  int FrameTimerId;
+  vtkCallbackCommand *FrameCallbackCommand;
+
+  // Description:
+  // Additional views of the map: renderer, whether its camera follows
+  // the map's view and at which zoom offset, and time of its last update
+  struct Viewport
+    {
+    vtkRenderer *Renderer;
+    bool Follow;
+    double ZoomOffset;
+    vtkTimeStamp UpdateTime;
+    };
+  std::vector<Viewport> Viewports;
+
+  // Description:
+  // Update the layers and markers of the viewports, all of them if
+  // the map's view was updated, else those whose camera has moved
+  void UpdateViewports(bool mapUpdated);
+
+  // Description:
+  // Index of the viewport of renderer, -1 if none
+  int GetViewportIndex(vtkRenderer *renderer);
+
+  // Description:
+  // Flight of FlyTo(): start and end views (x, y, fractional zoom),
+  // zoom out at mid flight, start time and duration in seconds, and
+  // last keyframe prefetched during the flight
+  bool Flying;
+  double FlightStart[3];
+  double FlightEnd[3];
+  double FlightZoomOut;
+  double FlightStartTime;
+  double FlightDuration;
+  int FlightKeyframe;
+
+  // Description:
+  // Compute the flight view (x, y, fractional zoom) at t in [0, 1]
+  void ComputeFlightView(double t, double view[3]);
+
+  // Description:
+  // Move the camera to the current view of the flight, ending it
+  // once it has reached its destination
+  void UpdateFlight();
+
+  // Description:
+  // Request the data of the flight view at t from the layers
+  void PrefetchFlightView(double t);
 private:
   vtkMap(const vtkMap&);  // Not implemented
   vtkMap& operator=(const vtkMap&); // Not implemented
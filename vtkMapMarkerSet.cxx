@@ -22,6 +22,7 @@
 #include <vtkDistanceToCamera.h>
 #include <vtkDoubleArray.h>
 #include <vtkIdTypeArray.h>
+#include <vtkIntArray.h>
 #include <vtkGlyph3D.h>
 #include <vtkNew.h>
 #include <vtkObjectFactory.h>
@@ -281,6 +282,7 @@ vtkIdType vtkMapMarkerSet::AddMarker(double latitude, double longitude)
     }
 
   this->Internals->MarkersChanged = true;
+  this->Modified();
 
   if (false)
     {
@@ -329,6 +331,7 @@ void vtkMapMarkerSet::RemoveMarkers()
   this->Internals->NumberOfMarkers = 0;
   this->Internals->NumberOfNodes = 0;
   this->Internals->MarkersChanged = true;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -386,13 +389,6 @@ void vtkMapMarkerSet::Update(int zoomLevel)
   unsigned char kwBlue[] = {0, 83, 155};
   unsigned char kwGreen[] = {0, 169, 179};
 
-  // Coefficients for scaling cluster size, using simple 2nd order model
-  // The equation is y = k*x^2 / (x^2 + b), where k,b are coefficients
-  // Logic hard-codes the min cluster factor to 1, i.e., y(2) = 1.0
-  // Max value is k, which sets the horizontal asymptote.
-  double k = this->MaxClusterScaleFactor;
-  double b = 4.0*k - 4.0;
-
   this->Internals->CurrentNodes.clear();
   std::set<ClusteringNode*> nodeSet = this->Internals->NodeTable[zoomLevel];
   std::set<ClusteringNode*>::const_iterator iter;
@@ -413,9 +409,7 @@ void vtkMapMarkerSet::Update(int zoomLevel)
       markerType = 1;
       types->InsertNextValue(markerType);
       colors->InsertNextTupleValue(kwGreen);
-      double x = static_cast<double>(node->NumberOfMarkers);
-      double scale = k*x*x / (x*x + b);
-      scales->InsertNextValue(scale);
+      scales->InsertNextValue(this->GetClusterScale(node->NumberOfMarkers));
       }
     }
   this->PolyData->Reset();
@@ -425,6 +419,51 @@ void vtkMapMarkerSet::Update(int zoomLevel)
   this->Internals->ZoomLevel = zoomLevel;
 }
 
+//----------------------------------------------------------------------------
+void vtkMapMarkerSet::GetMarkers(int zoomLevel, vtkPoints *points,
+                                 vtkIntArray *counts)
+{
+  points->Reset();
+  counts->Reset();
+  counts->SetNumberOfComponents(1);
+
+  // Same levels as Update()
+  zoomLevel = std::max(0, std::min(zoomLevel, NumberOfClusterLevels - 1));
+  if (!this->Clustering)
+    {
+    zoomLevel = 0;
+    }
+
+  const std::set<ClusteringNode*>& nodeSet =
+    this->Internals->NodeTable[zoomLevel];
+  std::set<ClusteringNode*>::const_iterator iter;
+  for (iter = nodeSet.begin(); iter != nodeSet.end(); iter++)
+    {
+    points->InsertNextPoint((*iter)->gcsCoords[0], (*iter)->gcsCoords[1],
+                            0.0);
+    counts->InsertNextValue((*iter)->NumberOfMarkers);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkMapMarkerSet::GetNumberOfClusterLevels()
+{
+  return NumberOfClusterLevels;
+}
+
+//----------------------------------------------------------------------------
+double vtkMapMarkerSet::GetClusterScale(int numberOfMarkers)
+{
+  // Coefficients for scaling cluster size, using simple 2nd order model
+  // The equation is y = k*x^2 / (x^2 + b), where k,b are coefficients
+  // Logic hard-codes the min cluster factor to 1, i.e., y(2) = 1.0
+  // Max value is k, which sets the horizontal asymptote.
+  double k = this->MaxClusterScaleFactor;
+  double b = 4.0*k - 4.0;
+  double x = static_cast<double>(numberOfMarkers);
+  return k*x*x / (x*x + b);
+}
+
 //----------------------------------------------------------------------------
 void vtkMapMarkerSet::
 PickPoint(vtkRenderer *renderer, vtkPicker *picker, int displayCoords[2],
@@ -23,10 +23,12 @@
 #include <set>
 
 class vtkActor;
+class vtkIntArray;
 class vtkMapClusteredMarkerSet;
 class vtkMapPickResult;
 class vtkMapper;
 class vtkPicker;
+class vtkPoints;
 class vtkPolyDataMapper;
 class vtkPolyData;
 class vtkRenderer;
@@ -70,6 +72,27 @@ public:
   // Update the marker geometry to draw the map
   void Update(int zoomLevel);
 
+  // Description:
+  // Get the actor drawing the markers, NULL until they are first drawn
+  vtkGetMacro(Actor, vtkActor*);
+
+  // Description:
+  // Get the markers drawn at zoomLevel, as world coordinates (longitude,
+  // Mercator y) in points, and the number of markers each one stands for
+  // in counts (more than 1 for clusters). Zoom levels are clipped to the
+  // cluster levels; all levels are the same without clustering.
+  void GetMarkers(int zoomLevel, vtkPoints *points, vtkIntArray *counts);
+
+  // Description:
+  // Returns the number of cluster levels. Zoom levels past the last one
+  // are drawn as the last one.
+  static int GetNumberOfClusterLevels();
+
+  // Description:
+  // Returns the size of a cluster marker relative to a single marker,
+  // given its number of markers (see MaxClusterScaleFactor)
+  double GetClusterScale(int numberOfMarkers);
+
   // Description:
   // Returns id of marker at specified display coordinates
   void PickPoint(vtkRenderer *renderer, vtkPicker *picker,
@@ -13,26 +13,53 @@
 =========================================================================*/
 
 #include "vtkMapTile.h"
+#include "vtkMapTileCodec.h"
 #include "vtkOsmLayer.h"
 
 // VTK Includes
 #include <vtkActor.h>
+#include <vtkImageData.h>
 #include <vtkObjectFactory.h>
 #include <vtkPlaneSource.h>
 #include <vtkPolyDataMapper.h>
-#include <vtkPNGReader.h>
 #include <vtkProperty.h>
+#include <vtkRenderer.h>
 #include <vtkTexture.h>
 #include <vtkTextureMapToPlane.h>
 #include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkAtomicInt.h>
+#include <vtksys/SystemTools.hxx>
 
 #include <curl/curl.h>
 
-#include <cstdio>  // for remove()
+#include <cstdio>  // for remove(), rename()
 #include <sstream>
 #include <fstream>
+#include <iterator>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define GETPID _getpid
+#else
+#include <unistd.h>
+#define GETPID getpid
+#endif
 
 vtkStandardNewMacro(vtkMapTile)
+vtkCxxSetObjectMacro(vtkMapTile, Image, vtkImageData)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Returns codec, or a new codec for the built-in formats if it is NULL
+vtkSmartPointer<vtkMapTileCodec> GetCodec(vtkMapTileCodec *codec)
+{
+  return codec ? vtkSmartPointer<vtkMapTileCodec>(codec) :
+    vtkSmartPointer<vtkMapTileCodec>::New();
+}
+}
 
 //----------------------------------------------------------------------------
 vtkMapTile::vtkMapTile()
@@ -41,10 +68,17 @@ vtkMapTile::vtkMapTile()
   TexturePlane = 0;
   Actor = 0;
   Mapper = 0;
+  this->Image = 0;
   this->Bin = Hidden;
+  this->Zoom = 0;
   this->VisibleFlag = false;
+  this->Fallback = false;
+  this->ReducedColor = false;
   this->Corners[0] = this->Corners[1] =
   this->Corners[2] = this->Corners[3] = 0.0;
+  this->TextureRange[0] = this->TextureRange[2] = 0.0;
+  this->TextureRange[1] = this->TextureRange[3] = 1.0;
+  this->CopyRange[0] = this->CopyRange[1] = 0;
 }
 
 //----------------------------------------------------------------------------
@@ -69,6 +103,14 @@ vtkMapTile::~vtkMapTile()
     {
     Mapper->Delete();
     }
+
+  std::map<int, vtkActor*>::iterator iter = this->CopyActors.begin();
+  for (; iter != this->CopyActors.end(); ++iter)
+    {
+    iter->second->Delete();
+    }
+
+  this->SetImage(0);
 }
 
 //----------------------------------------------------------------------------
@@ -81,18 +123,55 @@ void vtkMapTile::Build(const char* cacheDirectory)
   this->Plane->SetNormal(0, 0, 1);
 
   this->TexturePlane = vtkTextureMapToPlane::New();
-  this->InitializeDownload(cacheDirectory);
-
-  // Read the image which will be the texture
-  vtkNew<vtkPNGReader> pngReader;
-  pngReader->SetFileName (this->ImageFile.c_str());
-  pngReader->Update();
+  this->TexturePlane->SetSRange(this->TextureRange[0], this->TextureRange[1]);
+  this->TexturePlane->SetTRange(this->TextureRange[2], this->TextureRange[3]);
+  if (!this->Fallback && !this->Image)
+    {
+    this->InitializeDownload(cacheDirectory);
+    }
 
-  // Apply the texture
+  // Read the image which will be the texture,
+  // unless a decoded image was provided
+  if (!this->Image && !this->ImageFile.empty())
+    {
+    vtkImageData *image = vtkMapTile::ReadImageFile(this->ImageFile);
+    this->SetImage(image);
+    if (image)
+      {
+      image->Delete();
+      }
+    }
   vtkNew<vtkTexture> texture;
-  texture->SetInputConnection(pngReader->GetOutputPort());
-  texture->SetQualityTo32Bit();
-  texture->SetInterpolate(1);
+  bool hasImage = (this->Image != NULL);
+  if (hasImage)
+    {
+    // Layers expand indexed images in the tile service's image cache
+    // (see vtkMapTileService::ExpandImage()); expand images set
+    // otherwise here: mapping the indices through the texture would
+    // keep an RGBA copy besides them.
+    vtkImageData *expanded = vtkMapTileCodec::ExpandColors(this->Image);
+    if (expanded)
+      {
+      this->SetImage(expanded);
+      expanded->Delete();
+      }
+    texture->SetInputData(this->Image);
+
+    // Apply the texture
+    if (this->ReducedColor)
+      {
+      texture->SetQualityTo16Bit();
+      }
+    else
+      {
+      texture->SetQualityTo32Bit();
+      }
+    texture->SetInterpolate(1);
+    }
+  else if (!this->Fallback)
+    {
+    vtkWarningMacro("No image available for " << this->ImageSource);
+    }
   this->TexturePlane->SetInputConnection(Plane->GetOutputPort());
 
   this->Mapper = vtkPolyDataMapper::New();
@@ -100,12 +179,56 @@ void vtkMapTile::Build(const char* cacheDirectory)
 
   this->Actor = vtkActor::New();
   this->Actor->SetMapper(Mapper);
-  this->Actor->SetTexture(texture.GetPointer());
+  if (hasImage)
+    {
+    this->Actor->SetTexture(texture.GetPointer());
+    }
+  else
+    {
+    // Placeholder for tiles without imagery
+    this->Actor->GetProperty()->SetColor(0.85, 0.85, 0.85);
+    }
   this->Actor->PickableOff();
 
   this->BuildTime.Modified();
 }
 
+//----------------------------------------------------------------------------
+vtkActor *vtkMapTile::GetCopyActor(int copy)
+{
+  if (copy == 0 || !this->Actor)
+    {
+    return this->Actor;
+    }
+
+  std::map<int, vtkActor*>::iterator iter = this->CopyActors.find(copy);
+  if (iter != this->CopyActors.end())
+    {
+    return iter->second;
+    }
+
+  vtkActor *actor = vtkActor::New();
+  actor->SetMapper(this->Mapper);
+  actor->SetTexture(this->Actor->GetTexture());
+  actor->SetProperty(this->Actor->GetProperty());
+  actor->SetPosition(360.0 * copy, 0.0, 0.0);
+  actor->SetVisibility(this->Actor->GetVisibility());
+  actor->PickableOff();
+  this->CopyActors[copy] = actor;
+  return actor;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTile::RemoveActors(vtkRenderer *renderer)
+{
+  renderer->RemoveActor(this->Actor);
+  std::map<int, vtkActor*>::iterator iter = this->CopyActors.begin();
+  for (; iter != this->CopyActors.end(); ++iter)
+    {
+    renderer->RemoveActor(iter->second);
+    }
+}
+
 //----------------------------------------------------------------------------
 void vtkMapTile::SetVisible(bool val)
 {
@@ -133,12 +256,17 @@ bool vtkMapTile::IsVisible()
 //----------------------------------------------------------------------------
 void vtkMapTile::InitializeDownload(const char *cacheDirectory)
 {
-  // Generate destination file name
-  this->ImageFile = std::string(cacheDirectory) + "/" + this->ImageKey + ".png";
+  // Generate destination file name, unless already assigned
+  if (this->ImageFile.empty())
+    {
+    this->ImageFile =
+      std::string(cacheDirectory) + "/" + this->ImageKey + ".png";
+    }
 
   // Check if texture already exists.
   // If not, download
-  while(!this->IsImageDownloaded(this->ImageFile.c_str()))
+  if (!this->IsImageDownloaded(this->ImageFile.c_str()) &&
+      !this->ImageSource.empty())
     {
     std::cerr << "Downloading " << this->ImageSource.c_str() << std::endl;
     this->DownloadImage(this->ImageSource.c_str(), this->ImageFile.c_str());
@@ -148,57 +276,157 @@ void vtkMapTile::InitializeDownload(const char *cacheDirectory)
 //----------------------------------------------------------------------------
 bool vtkMapTile::IsImageDownloaded(const char *outfile)
 {
-  // Check if file can be opened
-  // Additional checks to confirm existence of correct
-  // texture can be added
-  std::ifstream file(outfile);
-  if ( file.is_open() )
+  if (!vtksys::SystemTools::FileExists(outfile, true))
     {
-    file.close();
-    return true;
+    return false;
     }
-  else
+
+  // Remove files left over from an interrupted or failed download,
+  // so that they are fetched again instead of failing to decode
+  if (!vtkMapTile::IsImageFileValid(outfile))
     {
-    file.close();
+    vtkWarningMacro("Removing invalid image file " << outfile);
+    remove(outfile);
     return false;
     }
+
+  return true;
 }
 
 //----------------------------------------------------------------------------
 void vtkMapTile::DownloadImage(const char *url, const char *outfilename)
 {
-  // Download file from url and store in outfilename
+  std::string errorMessage;
+  if (vtkMapTile::DownloadImageFile(url, outfilename, errorMessage) !=
+      DownloadOK)
+    {
+    vtkWarningMacro(<< errorMessage);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTile::DownloadImageFile(const std::string& url,
+                                   const std::string& outfile,
+                                   std::string& errorMessage,
+                                   vtkMapTileCodec *codec)
+{
+  // Download file from url into a temporary file next to outfile,
+  // so that the final rename stays on the same file system.
+  // Process id and counter keep names unique across threads and
+  // processes sharing the cache directory.
+  static vtkAtomicInt<vtkTypeInt32> tempFileCounter;
+  std::stringstream oss;
+  oss << outfile << ".part" << GETPID() << "." << tempFileCounter++;
+  std::string tempfile = oss.str();
+
   // Uses libcurl
   CURL* curl;
   FILE* fp;
   CURLcode res;
   char errorBuffer[CURL_ERROR_SIZE];
+  long httpStatus = 0;
   curl = curl_easy_init();
-
-  if(curl)
+  if (!curl)
     {
-    fp = fopen(outfilename, "wb");
-    if(!fp)
-      {
-      vtkErrorMacro( << "Not Open")
-      return;
-      }
+    errorMessage = "curl_easy_init() failed";
+    return DownloadFailed;
+    }
 
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    res = curl_easy_perform(curl);
+  fp = fopen(tempfile.c_str(), "wb");
+  if(!fp)
+    {
     curl_easy_cleanup(curl);
-    fclose(fp);
+    errorMessage = "Cannot open file " + tempfile;
+    return DownloadFailed;
+    }
 
-    //if curl failed remove the file
-    if (res != CURLE_OK)
+  errorBuffer[0] = '\0';
+  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
+  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
+  curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
+  curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);  // required for threads
+  res = curl_easy_perform(curl);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &httpStatus);
+  curl_easy_cleanup(curl);
+  bool writeOK = (fclose(fp) == 0);
+
+  // Check transfer, http status (0 for non-http urls) and content
+  int status = DownloadFailed;
+  oss.str("");
+  if (res != CURLE_OK)
+    {
+    oss << "Download " << url << " failed: " << errorBuffer;
+    }
+  else if (httpStatus != 200 && httpStatus != 0)
+    {
+    oss << "Download " << url << " returned http status " << httpStatus;
+    if (httpStatus == 404 || httpStatus == 410)
       {
-      remove(outfilename);
-      vtkWarningMacro(<<errorBuffer);
+      status = DownloadMissing;
       }
     }
+  else if (!writeOK)
+    {
+    oss << "Cannot write file " << tempfile;
+    }
+  else if (!vtkMapTile::IsImageFileValid(tempfile.c_str(), codec))
+    {
+    oss << "Download " << url << " is not a valid image";
+    }
+  else if (rename(tempfile.c_str(), outfile.c_str()) != 0)
+    {
+    // Windows does not replace existing files; that is fine if
+    // another thread or process already stored a valid copy
+    if (!vtkMapTile::IsImageFileValid(outfile.c_str(), codec))
+      {
+      oss << "Cannot rename " << tempfile << " to " << outfile;
+      }
+    }
+
+  errorMessage = oss.str();
+  remove(tempfile.c_str());  // no-op if renamed
+  return errorMessage.empty() ? DownloadOK : status;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTile::IsImageFileValid(const char *filename, vtkMapTileCodec *codec)
+{
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    {
+    return false;
+    }
+
+  unsigned char head[vtkMapTileCodec::CheckLength];
+  unsigned char tail[vtkMapTileCodec::CheckLength];
+  file.read(reinterpret_cast<char*>(head), sizeof(head));
+  file.seekg(-static_cast<int>(sizeof(tail)), std::ios::end);
+  file.read(reinterpret_cast<char*>(tail), sizeof(tail));
+  return file && GetCodec(codec)->CheckImage(head, tail);
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTile::DecodeImage(const unsigned char *data,
+                                      size_t length, vtkMapTileCodec *codec)
+{
+  return GetCodec(codec)->Decode(data, length);
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTile::ReadImageFile(const std::string& filename,
+                                        vtkMapTileCodec *codec)
+{
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    {
+    return NULL;
+    }
+
+  std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  return data.empty() ? NULL :
+    vtkMapTile::DecodeImage(&data[0], data.size(), codec);
 }
 
 //----------------------------------------------------------------------------
@@ -222,7 +450,7 @@ void vtkMapTile::Init()
 //----------------------------------------------------------------------------
 void vtkMapTile::CleanUp()
 {
-  this->Layer->GetRenderer()->RemoveActor(this->Actor);
+  this->RemoveActors(this->Layer->GetRenderer());
   this->SetLayer(0);
 }
 
@@ -230,5 +458,10 @@ void vtkMapTile::CleanUp()
 void vtkMapTile::Update()
 {
   this->Actor->SetVisibility(this->IsVisible());
+  std::map<int, vtkActor*>::iterator iter = this->CopyActors.begin();
+  for (; iter != this->CopyActors.end(); ++iter)
+    {
+    iter->second->SetVisibility(this->IsVisible());
+    }
   this->UpdateTime.Modified();
 }
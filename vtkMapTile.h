@@ -21,15 +21,29 @@
 #include "vtkFeature.h"
 #include "vtkmap_export.h"
 
+#include <map>
+
 class vtkStdString;
+class vtkImageData;
 class vtkPlaneSource;
 class vtkActor;
+class vtkMapTileCodec;
 class vtkPolyDataMapper;
+class vtkRenderer;
 class vtkTextureMapToPlane;
 
 class VTKMAP_EXPORT vtkMapTile : public vtkFeature
 {
 public:
+  // Description:
+  // Result of DownloadImageFile()
+  enum DownloadStatus
+    {
+    DownloadOK = 0,
+    DownloadMissing,   // server reports that the tile doesn't exist
+    DownloadFailed     // network or server error, or invalid content
+    };
+
   static vtkMapTile* New();
   virtual void PrintSelf(ostream &os, vtkIndent indent);
   vtkTypeMacro (vtkMapTile, vtkFeature)
@@ -44,11 +58,59 @@ public:
   void  SetImageSource(const std::string& imgSrc) {this->ImageSource= imgSrc;}
   std::string GetImageSource() {return this->ImageSource;}
 
+  // Description:
+  // Get/Set the (cached) image file used as texture.
+  // If not set, it is generated from the cache directory and image key.
+  void SetImageFile(const std::string& file) {this->ImageFile = file;}
+  std::string GetImageFile() {return this->ImageFile;}
+
+  // Description:
+  // Get/Set a decoded image to use as texture instead of ImageFile,
+  // for tile sources that don't store tiles as files (see
+  // vtkMapTileSource::ReadTileImage())
+  vtkSetObjectMacro(Image, vtkImageData)
+  vtkGetObjectMacro(Image, vtkImageData)
+
+  // Description:
+  // Get/Set the portion of the image used as texture, as
+  // [smin, smax, tmin, tmax] in normalized image coordinates.
+  // The default is the whole image [0, 1, 0, 1].
+  vtkGetVector4Macro(TextureRange, double);
+  vtkSetVector4Macro(TextureRange, double);
+
+  // Description:
+  // Get/Set whether the tile is drawn with substitute imagery (part of
+  // an ancestor tile's image, or a placeholder if ImageFile is empty)
+  // because its own image is not available. Fallback tiles don't
+  // download their image.
+  vtkGetMacro(Fallback, bool);
+  vtkSetMacro(Fallback, bool);
+
+  // Description:
+  // Get/Set whether the texture is uploaded with 16 bits per pixel
+  // (RGB5, or RGBA4 with alpha) rather than 32. Indexed images (see
+  // vtkMapTileCodec::IndexColors()) are replaced by their expanded
+  // colors when the tile is built, in either case.
+  vtkGetMacro(ReducedColor, bool);
+  vtkSetMacro(ReducedColor, bool);
+
+  // Description:
+  // Get/Set the zoom level of the tile
+  vtkGetMacro(Zoom, int);
+  vtkSetMacro(Zoom, int);
+
   // Description:
   // Get/Set corners of the tile (lowerleft, upper right)
   vtkGetVector4Macro(Corners, double);
   vtkSetVector4Macro(Corners, double);
 
+  // Description:
+  // Get/Set the world copies the tile is displayed in, as the first
+  // and last multiple of 360 degrees it is translated by in x, e.g.
+  // [-1, 0] when the view spans the antimeridian. Default is [0, 0].
+  vtkGetVector2Macro(CopyRange, int);
+  vtkSetVector2Macro(CopyRange, int);
+
   // Description:
   // Get/Set bin of the tile
   vtkGetMacro(Bin, int);
@@ -59,6 +121,17 @@ public:
   vtkGetMacro(Actor, vtkActor*)
   vtkGetMacro(Mapper, vtkPolyDataMapper*)
 
+  // Description:
+  // Actor of the tile translated by copy * 360 degrees in x, created
+  // on first use; the tile's actor for copy 0. Copies share the
+  // mapper, texture and property of the tile's actor, so they cost
+  // no download, decoding or texture upload of their own.
+  vtkActor *GetCopyActor(int copy);
+
+  // Description:
+  // Remove the actors of the tile and its copies from renderer
+  void RemoveActors(vtkRenderer *renderer);
+
   // Description:
   // Get/Set position of the tile
   void SetCenter(double* center);
@@ -81,6 +154,38 @@ public:
   // Update the map tile
   virtual void Update();
 
+  // Description:
+  // Download the image at url and store it in outfile.
+  // The response is written to a temporary file next to outfile and
+  // renamed into place only if the http status is OK and the content
+  // is a complete image, so the cache never holds a partial tile.
+  // Returns a DownloadStatus value; errorMessage is set on failure.
+  // The image formats accepted are those of codec, or the built-in
+  // formats (PNG and JPEG) if codec is NULL, as for the methods below.
+  static int DownloadImageFile(const std::string& url,
+                                const std::string& outfile,
+                                std::string& errorMessage,
+                                vtkMapTileCodec *codec = NULL);
+
+  // Description:
+  // Check that a cached file holds a complete image
+  // (see vtkMapTileCodec::CheckImage())
+  static bool IsImageFileValid(const char *filename,
+                               vtkMapTileCodec *codec = NULL);
+
+  // Description:
+  // Decode an image held in memory (e.g. a blob from a tile package).
+  // Returns a new image that the caller must Delete(), or NULL if the
+  // data is not a complete image. Thread safe.
+  static vtkImageData *DecodeImage(const unsigned char *data, size_t length,
+                                   vtkMapTileCodec *codec = NULL);
+
+  // Description:
+  // Read and decode an image file. Returns a new image that the caller
+  // must Delete(), or NULL if the file is not a complete image.
+  // Thread safe.
+  static vtkImageData *ReadImageFile(const std::string& filename,
+                                     vtkMapTileCodec *codec = NULL);
 
 protected:
   vtkMapTile();
@@ -89,7 +194,8 @@ protected:
   void Build(const char* cacheDirectory);
 
   // Description:
-  // Check if the corresponding image is downloaded
+  // Check if the corresponding image is downloaded.
+  // Invalid (truncated or non-image) files are removed.
   bool IsImageDownloaded(const char* outfile);
 
   // Description:
@@ -98,7 +204,8 @@ protected:
 
   // Description:
   // Generate url of tile and output file from QuadKey, and download the texture
-  // if not already downloaded.
+  // if not already downloaded. Makes a single attempt; retries are left to
+  // the layer (see vtkMapTileFailureCache).
   void InitializeDownload(const char *cacheDirectory);
 
   // Description:
@@ -106,15 +213,22 @@ protected:
   std::string ImageSource;
   std::string ImageFile;
   std::string ImageKey;
+  vtkImageData *Image;
 
   vtkPlaneSource* Plane;
   vtkTextureMapToPlane* TexturePlane;
   vtkActor* Actor;
   vtkPolyDataMapper* Mapper;
+  std::map<int, vtkActor*> CopyActors;
 
   int Bin;
+  int Zoom;
   bool VisibleFlag;
+  bool Fallback;
+  bool ReducedColor;
   double Corners[4];
+  double TextureRange[4];
+  int CopyRange[2];
 
 private:
   vtkMapTile(const vtkMapTile&);  // Not implemented
@@ -0,0 +1,53 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileClock.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileClock.h"
+
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtksys/SystemTools.hxx>
+
+vtkStandardNewMacro(vtkMapTileClock)
+
+//----------------------------------------------------------------------------
+vtkMapTileClock::vtkMapTileClock()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileClock::~vtkMapTileClock()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileClock::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+}
+
+//----------------------------------------------------------------------------
+double vtkMapTileClock::GetTime()
+{
+  return vtkTimerLog::GetUniversalTime();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileClock::Sleep(double seconds)
+{
+  if (seconds > 0.0)
+    {
+    vtksys::SystemTools::Delay(static_cast<unsigned int>(1000.0 * seconds));
+    }
+}
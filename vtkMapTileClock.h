@@ -0,0 +1,53 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileClock.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileClock - time source for tile request throttling
+// .SECTION Description
+// Tells the time, and waits, for vtkMapTileRateLimiter and
+// vtkMapTileFailureCache. The default clock uses the system time. To
+// run them on another time, e.g. a simulated one in tests, subclass
+// vtkMapTileClock, override GetTime() and Sleep(), and set an instance
+// as their clock.
+
+#ifndef __vtkMapTileClock_h
+#define __vtkMapTileClock_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+class VTKMAP_EXPORT vtkMapTileClock : public vtkObject
+{
+public:
+  static vtkMapTileClock *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileClock, vtkObject)
+
+  // Description:
+  // Returns the current time in seconds. Thread safe.
+  virtual double GetTime();
+
+  // Description:
+  // Wait for the specified number of seconds. Thread safe.
+  virtual void Sleep(double seconds);
+
+protected:
+  vtkMapTileClock();
+  ~vtkMapTileClock();
+
+private:
+  vtkMapTileClock(const vtkMapTileClock&);  // Not implemented
+  vtkMapTileClock& operator=(const vtkMapTileClock&); // Not implemented
+};
+
+#endif // __vtkMapTileClock_h
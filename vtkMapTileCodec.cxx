@@ -0,0 +1,288 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileCodec.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileCodec.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkJPEGReader.h>
+#include <vtkLookupTable.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPNGReader.h>
+#include <vtkPointData.h>
+
+#include <algorithm>
+#include <cstring>  // for memcmp(), memcpy()
+#include <map>
+#include <vector>
+
+vtkStandardNewMacro(vtkMapTileCodec)
+
+//----------------------------------------------------------------------------
+namespace
+{
+const unsigned char pngSignature[] =
+  {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+// IEND chunk type and crc
+const unsigned char pngTrailer[] =
+  {'I', 'E', 'N', 'D', 0xae, 0x42, 0x60, 0x82};
+
+// Start of image marker, followed by the first marker of the header
+const unsigned char jpegSignature[] = {0xff, 0xd8, 0xff};
+// End of image marker
+const unsigned char jpegTrailer[] = {0xff, 0xd9};
+
+// Some encoders pad JPEG images after the end of image marker,
+// so look for it anywhere in the tail
+bool HasJPEGTrailer(const unsigned char *tail)
+{
+  for (int i = vtkMapTileCodec::CheckLength - sizeof(jpegTrailer);
+       i >= 0; --i)
+    {
+    if (memcmp(tail + i, jpegTrailer, sizeof(jpegTrailer)) == 0)
+      {
+      return true;
+      }
+    }
+  return false;
+}
+
+// Decode an in-memory image with reader. Each call uses its own
+// reader, so decoding can run on worker threads.
+template <class Reader>
+vtkImageData *DecodeWith(const unsigned char *data, size_t length)
+{
+  vtkNew<Reader> reader;
+  reader->SetMemoryBuffer(const_cast<unsigned char*>(data));
+  reader->SetMemoryBufferLength(static_cast<vtkIdType>(length));
+  reader->Update();
+
+  vtkImageData *image = vtkImageData::New();
+  image->ShallowCopy(reader->GetOutput());
+  return image;
+}
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileCodec::vtkMapTileCodec()
+{
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileCodec::~vtkMapTileCodec()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileCodec::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileCodec::GetImageFormat(const unsigned char *head)
+{
+  if (memcmp(head, pngSignature, sizeof(pngSignature)) == 0)
+    {
+    return FormatPNG;
+    }
+  if (memcmp(head, jpegSignature, sizeof(jpegSignature)) == 0)
+    {
+    return FormatJPEG;
+    }
+  return FormatUnknown;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileCodec::CheckImage(const unsigned char *head,
+                                 const unsigned char *tail)
+{
+  switch (vtkMapTileCodec::GetImageFormat(head))
+    {
+    case FormatPNG:
+      return memcmp(tail, pngTrailer, sizeof(pngTrailer)) == 0;
+    case FormatJPEG:
+      return HasJPEGTrailer(tail);
+    default:
+      return false;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileCodec::IsImageComplete(const unsigned char *data,
+                                      size_t length)
+{
+  return data && length >= 2 * CheckLength &&
+    this->CheckImage(data, data + length - CheckLength);
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileCodec::Decode(const unsigned char *data,
+                                      size_t length)
+{
+  if (!this->IsImageComplete(data, length))
+    {
+    return NULL;
+    }
+
+  switch (vtkMapTileCodec::GetImageFormat(data))
+    {
+    case FormatPNG:
+      return DecodeWith<vtkPNGReader>(data, length);
+    case FormatJPEG:
+      return DecodeWith<vtkJPEGReader>(data, length);
+    default:
+      return NULL;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileCodec::IndexColors(vtkImageData *image)
+{
+  int components = image->GetNumberOfScalarComponents();
+  if (image->GetScalarType() != VTK_UNSIGNED_CHAR ||
+      components < 2 || components > 4)
+    {
+    return NULL;
+    }
+
+  int dims[3];
+  image->GetDimensions(dims);
+  vtkIdType numberOfPixels =
+    static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  const unsigned char *pixel =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  if (!pixel || numberOfPixels == 0)
+    {
+    return NULL;
+    }
+
+  // Assign indices in order of appearance. Tiles have runs of the
+  // same color, so the previous pixel's color is checked first.
+  std::vector<unsigned char> indices(numberOfPixels);
+  std::vector<vtkTypeUInt32> colors;
+  std::map<vtkTypeUInt32, unsigned char> colorIndices;
+  vtkTypeUInt32 previous = 0;
+  for (vtkIdType i = 0; i < numberOfPixels; ++i, pixel += components)
+    {
+    vtkTypeUInt32 color = 0;
+    for (int c = 0; c < components; ++c)
+      {
+      color = (color << 8) | pixel[c];
+      }
+
+    if (i > 0 && color == previous)
+      {
+      indices[i] = indices[i - 1];
+      continue;
+      }
+    std::map<vtkTypeUInt32, unsigned char>::iterator iter =
+      colorIndices.find(color);
+    if (iter == colorIndices.end())
+      {
+      if (colors.size() == 256)
+        {
+        return NULL;
+        }
+      iter = colorIndices.insert(std::make_pair(
+        color, static_cast<unsigned char>(colors.size()))).first;
+      colors.push_back(color);
+      }
+    indices[i] = iter->second;
+    previous = color;
+    }
+
+  // Centering the table range on the indices maps each index to
+  // its own table value
+  vtkLookupTable *table = vtkLookupTable::New();
+  int numberOfColors = static_cast<int>(colors.size());
+  table->SetNumberOfTableValues(numberOfColors);
+  table->SetTableRange(-0.5, numberOfColors - 0.5);
+  for (int i = 0; i < numberOfColors; ++i)
+    {
+    unsigned char rgba[4];
+    vtkTypeUInt32 color = colors[i];
+    for (int c = components - 1; c >= 0; --c, color >>= 8)
+      {
+      rgba[c] = static_cast<unsigned char>(color & 0xff);
+      }
+    if (components < 3)
+      {
+      // Gray and alpha
+      rgba[3] = rgba[1];
+      rgba[1] = rgba[2] = rgba[0];
+      }
+    else if (components == 3)
+      {
+      rgba[3] = 255;
+      }
+    table->SetTableValue(i, rgba[0] / 255.0, rgba[1] / 255.0,
+                         rgba[2] / 255.0, rgba[3] / 255.0);
+    }
+
+  vtkImageData *indexed = vtkImageData::New();
+  indexed->SetDimensions(dims[0], dims[1], dims[2]);
+  indexed->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  memcpy(indexed->GetScalarPointer(), &indices[0], indices.size());
+  indexed->GetPointData()->GetScalars()->SetLookupTable(table);
+  table->Delete();
+  return indexed;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileCodec::ExpandColors(vtkImageData *image)
+{
+  vtkDataArray *scalars = image->GetPointData()->GetScalars();
+  vtkLookupTable *table = scalars ? scalars->GetLookupTable() : NULL;
+  if (!table || image->GetScalarType() != VTK_UNSIGNED_CHAR ||
+      image->GetNumberOfScalarComponents() != 1)
+    {
+    return NULL;
+    }
+
+  // Opaque tiles don't need the alpha channel
+  vtkIdType numberOfColors =
+    std::min(static_cast<vtkIdType>(256), table->GetNumberOfTableValues());
+  int components = 3;
+  std::vector<unsigned char> colors(4 * 256, 0);
+  for (vtkIdType i = 0; i < numberOfColors; ++i)
+    {
+    double rgba[4];
+    table->GetTableValue(i, rgba);
+    for (int c = 0; c < 4; ++c)
+      {
+      colors[4 * i + c] = static_cast<unsigned char>(rgba[c] * 255.0 + 0.5);
+      }
+    components = colors[4 * i + 3] < 255 ? 4 : components;
+    }
+
+  int dims[3];
+  image->GetDimensions(dims);
+  vtkIdType numberOfPixels =
+    static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  vtkImageData *expanded = vtkImageData::New();
+  expanded->SetDimensions(dims[0], dims[1], dims[2]);
+  expanded->AllocateScalars(VTK_UNSIGNED_CHAR, components);
+  const unsigned char *index =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  unsigned char *pixel =
+    static_cast<unsigned char*>(expanded->GetScalarPointer());
+  for (vtkIdType i = 0; i < numberOfPixels; ++i, pixel += components)
+    {
+    memcpy(pixel, &colors[4 * index[i]], components);
+    }
+  return expanded;
+}
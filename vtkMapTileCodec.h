@@ -0,0 +1,109 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileCodec.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileCodec - decoder for encoded tile images
+// .SECTION Description
+// Recognizes complete tile images and decodes them. The format is
+// detected from the content, not the file name: PNG is read with
+// vtkPNGReader and JPEG, common for satellite imagery, with
+// vtkJPEGReader.
+//
+// Each tile source has a codec (see vtkMapTileSource::SetCodec()).
+// To support other formats, subclass vtkMapTileCodec, override
+// CheckImage() and Decode(), falling back to the superclass for the
+// built-in formats, and set an instance as the source's codec.
+//
+// Cached files and downloads are validated by checking the start and
+// the end of the image, which catches truncated files without
+// decoding them.
+
+#ifndef __vtkMapTileCodec_h
+#define __vtkMapTileCodec_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+#include <cstddef>  // for size_t
+
+class vtkImageData;
+
+class VTKMAP_EXPORT vtkMapTileCodec : public vtkObject
+{
+public:
+  // Description:
+  // Built-in image formats
+  enum ImageFormat
+    {
+    FormatUnknown = 0,
+    FormatPNG,
+    FormatJPEG
+    };
+
+  // Description:
+  // Number of bytes at the start (head) and at the end (tail)
+  // of an encoded image that CheckImage() looks at
+  enum { CheckLength = 8 };
+
+  static vtkMapTileCodec *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileCodec, vtkObject)
+
+  // Description:
+  // Returns the built-in ImageFormat of an encoded image,
+  // given its first CheckLength bytes
+  static int GetImageFormat(const unsigned char *head);
+
+  // Description:
+  // Returns true if head and tail, the first and last CheckLength
+  // bytes of an encoded image, are those of a complete image in a
+  // supported format. Thread safe.
+  virtual bool CheckImage(const unsigned char *head,
+                          const unsigned char *tail);
+
+  // Description:
+  // Returns true if data holds a complete image in a supported format
+  bool IsImageComplete(const unsigned char *data, size_t length);
+
+  // Description:
+  // Decode a complete image. Returns a new image that the caller
+  // must Delete(), or NULL if the data is not a complete image in a
+  // supported format. Thread safe.
+  virtual vtkImageData *Decode(const unsigned char *data, size_t length);
+
+  // Description:
+  // Convert an 8 bit image with 2 to 4 components and at most 256
+  // colors, such as a decoded palettised PNG, to an image of color
+  // indices, one byte per pixel. The colors are stored in a
+  // vtkLookupTable attached to the scalars. Returns a new image that
+  // the caller must Delete(), or NULL if the image has more colors.
+  // Thread safe.
+  static vtkImageData *IndexColors(vtkImageData *image);
+
+  // Description:
+  // Convert an image of color indices made by IndexColors() back to
+  // RGB, or RGBA if any of its colors is translucent. Returns a new
+  // image that the caller must Delete(), or NULL if the image has no
+  // lookup table. Thread safe.
+  static vtkImageData *ExpandColors(vtkImageData *image);
+
+protected:
+  vtkMapTileCodec();
+  ~vtkMapTileCodec();
+
+private:
+  vtkMapTileCodec(const vtkMapTileCodec&);  // Not implemented
+  vtkMapTileCodec& operator=(const vtkMapTileCodec&); // Not implemented
+};
+
+#endif // __vtkMapTileCodec_h
@@ -0,0 +1,296 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileFailureCache.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileClock.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+#include <algorithm>
+#include <map>
+
+vtkStandardNewMacro(vtkMapTileFailureCache)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Failure history of one tile
+struct TileFailure
+{
+  int Count;           // consecutive failures
+  double RetryTime;    // earliest time for next request
+};
+
+// Circuit breaker state of one host
+struct HostState
+{
+  int FailureCount;    // consecutive failures
+  int OpenCount;       // consecutive times the breaker opened
+  double RetryTime;    // earliest time for probe request, if open
+  bool Open;
+  bool ProbeInFlight;
+
+  HostState()
+    : FailureCount(0), OpenCount(0), RetryTime(0.0), Open(false),
+      ProbeInFlight(false) {}
+};
+
+// Double the retry delay of failure from initialDelay, up to maxDelay
+void BackOff(TileFailure& failure, double now, double initialDelay,
+             double maxDelay)
+{
+  failure.Count = failure.RetryTime > 0.0 ? failure.Count + 1 : 1;
+  double delay = initialDelay;
+  for (int i = 1; i < failure.Count && delay < maxDelay; ++i)
+    {
+    delay *= 2.0;
+    }
+  failure.RetryTime = now + std::min(delay, maxDelay);
+}
+
+// Pack tile indices into one key (zoom < 32, x & y < 2^29)
+inline vtkTypeUInt64 TileKey(int zoom, int x, int y)
+{
+  return (static_cast<vtkTypeUInt64>(zoom) << 58) |
+    (static_cast<vtkTypeUInt64>(x) << 29) | static_cast<vtkTypeUInt64>(y);
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileFailureCache::vtkMapTileFailureCacheInternals
+{
+public:
+  std::map<vtkTypeUInt64, TileFailure> Tiles;
+  std::map<std::string, HostState> Hosts;
+  vtkMutexLock *Lock;
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileFailureCache::vtkMapTileFailureCache()
+{
+  this->InitialRetryDelay = 2.0;
+  this->MaxRetryDelay = 600.0;
+  this->MissingTileTTL = 86400.0;
+  this->HostFailureThreshold = 5;
+  this->HostRetryDelay = 30.0;
+  this->Clock = vtkMapTileClock::New();
+
+  this->Internals = new vtkMapTileFailureCacheInternals;
+  this->Internals->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileFailureCache::~vtkMapTileFailureCache()
+{
+  this->Internals->Lock->Delete();
+  delete this->Internals;
+  this->Clock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  this->Internals->Lock->Lock();
+  os << indent << "InitialRetryDelay: " << this->InitialRetryDelay << "\n"
+     << indent << "MaxRetryDelay: " << this->MaxRetryDelay << "\n"
+     << indent << "MissingTileTTL: " << this->MissingTileTTL << "\n"
+     << indent << "HostFailureThreshold: " << this->HostFailureThreshold << "\n"
+     << indent << "HostRetryDelay: " << this->HostRetryDelay << "\n"
+     << indent << "Clock: " << this->Clock->GetClassName() << "\n"
+     << indent << "Failed tiles: " << this->Internals->Tiles.size() << "\n";
+  std::map<std::string, HostState>::const_iterator iter =
+    this->Internals->Hosts.begin();
+  for (; iter != this->Internals->Hosts.end(); iter++)
+    {
+    os << indent << "Host " << iter->first << ": "
+       << (iter->second.Open ? "suspended" : "ok") << "\n";
+    }
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::SetClock(vtkMapTileClock *clock)
+{
+  if (!clock || clock == this->Clock)
+    {
+    return;
+    }
+
+  clock->Register(this);
+  this->Clock->UnRegister(this);
+  this->Clock = clock;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::IsTileAvailable(int zoom, int x, int y)
+{
+  double now = this->Clock->GetTime();
+  bool result = true;
+
+  this->Internals->Lock->Lock();
+  std::map<vtkTypeUInt64, TileFailure>::iterator iter =
+    this->Internals->Tiles.find(TileKey(zoom, x, y));
+  if (iter != this->Internals->Tiles.end() && now < iter->second.RetryTime)
+    {
+    result = false;
+    }
+  this->Internals->Lock->Unlock();
+
+  return result;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileFailureCache::
+CanRequest(int zoom, int x, int y, const std::string& host)
+{
+  if (!this->IsTileAvailable(zoom, x, y))
+    {
+    return false;
+    }
+
+  double now = this->Clock->GetTime();
+  bool result = true;
+
+  this->Internals->Lock->Lock();
+  std::map<std::string, HostState>::iterator iter =
+    this->Internals->Hosts.find(host);
+  if (iter != this->Internals->Hosts.end() && iter->second.Open)
+    {
+    HostState& state = iter->second;
+    if (state.ProbeInFlight || now < state.RetryTime)
+      {
+      result = false;
+      }
+    else
+      {
+      // Let this request through as the probe
+      state.ProbeInFlight = true;
+      }
+    }
+  this->Internals->Lock->Unlock();
+
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::
+RecordFailure(int zoom, int x, int y, const std::string& host, bool missing)
+{
+  double now = this->Clock->GetTime();
+
+  this->Internals->Lock->Lock();
+
+  // Tile backoff: fixed TTL for missing tiles, exponential otherwise
+  TileFailure& failure = this->Internals->Tiles[TileKey(zoom, x, y)];
+  if (missing)
+    {
+    failure.Count = 1;
+    failure.RetryTime = now + this->MissingTileTTL;
+    }
+  else
+    {
+    BackOff(failure, now, this->InitialRetryDelay, this->MaxRetryDelay);
+    }
+
+  // A missing tile means the server is working, so it doesn't count
+  // against the host. Other failures may open the circuit breaker.
+  HostState& state = this->Internals->Hosts[host];
+  if (missing)
+    {
+    state.FailureCount = 0;
+    }
+  else
+    {
+    state.FailureCount++;
+    }
+  if (state.Open && state.ProbeInFlight && !missing)
+    {
+    // Probe failed, wait longer
+    state.OpenCount++;
+    }
+  else if (!state.Open && state.FailureCount >= this->HostFailureThreshold)
+    {
+    state.Open = true;
+    state.OpenCount = 1;
+    vtkWarningMacro("Suspending requests to " << host << " after "
+                    << state.FailureCount << " failures");
+    }
+  else if (state.Open && missing)
+    {
+    state.Open = false;
+    state.OpenCount = 0;
+    }
+  state.ProbeInFlight = false;
+
+  if (state.Open)
+    {
+    double delay = this->HostRetryDelay;
+    for (int i = 1; i < state.OpenCount && delay < this->MaxRetryDelay; ++i)
+      {
+      delay *= 2.0;
+      }
+    state.RetryTime = now + std::min(delay, this->MaxRetryDelay);
+    }
+
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::RecordTileFailure(int zoom, int x, int y)
+{
+  double now = this->Clock->GetTime();
+
+  this->Internals->Lock->Lock();
+  BackOff(this->Internals->Tiles[TileKey(zoom, x, y)], now,
+          this->InitialRetryDelay, this->MaxRetryDelay);
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::
+RecordSuccess(int zoom, int x, int y, const std::string& host)
+{
+  this->Internals->Lock->Lock();
+  this->Internals->Tiles.erase(TileKey(zoom, x, y));
+
+  std::map<std::string, HostState>::iterator iter =
+    this->Internals->Hosts.find(host);
+  if (iter != this->Internals->Hosts.end())
+    {
+    this->Internals->Hosts.erase(iter);
+    }
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileFailureCache::Clear()
+{
+  this->Internals->Lock->Lock();
+  this->Internals->Tiles.clear();
+  this->Internals->Hosts.clear();
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileFailureCache::GetHost(const std::string& url)
+{
+  std::string::size_type start = url.find("://");
+  start = (start == std::string::npos) ? 0 : start + 3;
+  std::string::size_type end = url.find('/', start);
+  return url.substr(start, end == std::string::npos ? end : end - start);
+}
@@ -0,0 +1,133 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileFailureCache.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileFailureCache - negative cache for map tile requests
+// .SECTION Description
+// Keeps track of tile requests that failed, so that tile layers do not
+// request them again every time they come into view. Tiles the server
+// reports as missing are skipped until MissingTileTTL expires. Tiles that
+// failed for other reasons (network errors, server errors, invalid
+// content) are retried with exponential backoff, starting at
+// InitialRetryDelay and doubling up to MaxRetryDelay.
+//
+// The class also acts as a circuit breaker for each tile server (host):
+// after HostFailureThreshold consecutive failures, all requests to that
+// host are suspended for HostRetryDelay seconds. After that, a single
+// probe request is let through; if it succeeds the host is closed again,
+// otherwise the delay is doubled (up to MaxRetryDelay).
+//
+// All methods are thread safe. Times are in seconds.
+
+#ifndef __vtkMapTileFailureCache_h
+#define __vtkMapTileFailureCache_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+#include <string>
+
+class vtkMapTileClock;
+
+class VTKMAP_EXPORT vtkMapTileFailureCache : public vtkObject
+{
+public:
+  static vtkMapTileFailureCache *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileFailureCache, vtkObject)
+
+  // Description:
+  // Retry delay after the first failure of a tile, default is 2 seconds
+  vtkSetMacro(InitialRetryDelay, double)
+  vtkGetMacro(InitialRetryDelay, double)
+
+  // Description:
+  // Upper limit for retry delays, default is 600 seconds
+  vtkSetMacro(MaxRetryDelay, double)
+  vtkGetMacro(MaxRetryDelay, double)
+
+  // Description:
+  // How long tiles reported missing by the server are skipped,
+  // default is 86400 seconds (one day)
+  vtkSetMacro(MissingTileTTL, double)
+  vtkGetMacro(MissingTileTTL, double)
+
+  // Description:
+  // Number of consecutive failures that suspends a host, default is 5
+  vtkSetMacro(HostFailureThreshold, int)
+  vtkGetMacro(HostFailureThreshold, int)
+
+  // Description:
+  // How long a suspended host is skipped, default is 30 seconds
+  vtkSetMacro(HostRetryDelay, double)
+  vtkGetMacro(HostRetryDelay, double)
+
+  // Description:
+  // Get/Set the clock telling the time of failures and retries. The
+  // default one uses the system time.
+  vtkGetObjectMacro(Clock, vtkMapTileClock)
+  void SetClock(vtkMapTileClock *clock);
+
+  // Description:
+  // Returns true if tile (zoom, x, y) may be requested from host now.
+  // If the host is waiting for a probe request, the first caller gets
+  // the probe and must report its result.
+  bool CanRequest(int zoom, int x, int y, const std::string& host);
+
+  // Description:
+  // Returns true if tile (zoom, x, y) is neither backed off nor missing.
+  // Unlike CanRequest(), this does not consider the host state.
+  bool IsTileAvailable(int zoom, int x, int y);
+
+  // Description:
+  // Record the result of a tile request.
+  // Set missing to true if the server reported that the tile does not exist.
+  void RecordFailure(int zoom, int x, int y, const std::string& host,
+                     bool missing);
+  void RecordSuccess(int zoom, int x, int y, const std::string& host);
+
+  // Description:
+  // Back off tile (zoom, x, y) as after a failed request, without
+  // counting against any host, e.g. when all its hosts are suspended
+  // or its image cannot be decoded.
+  void RecordTileFailure(int zoom, int x, int y);
+
+  // Description:
+  // Forget all failures
+  void Clear();
+
+  // Description:
+  // Extract host name from url, e.g. "tile.openstreetmap.org"
+  // for "http://tile.openstreetmap.org/1/0/0.png"
+  static std::string GetHost(const std::string& url);
+
+protected:
+  vtkMapTileFailureCache();
+  ~vtkMapTileFailureCache();
+
+  double InitialRetryDelay;
+  double MaxRetryDelay;
+  double MissingTileTTL;
+  int HostFailureThreshold;
+  double HostRetryDelay;
+  vtkMapTileClock *Clock;
+
+  class vtkMapTileFailureCacheInternals;
+  vtkMapTileFailureCacheInternals *Internals;
+
+private:
+  vtkMapTileFailureCache(const vtkMapTileFailureCache&);  // Not implemented
+  vtkMapTileFailureCache& operator=(const vtkMapTileFailureCache&); // Not implemented
+};
+
+#endif // __vtkMapTileFailureCache_h
@@ -0,0 +1,1134 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRasterizer.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileRasterizer.h"
+#include "vtkFeatureLayer.h"
+#include "vtkMapMarkerSet.h"
+#include "vtkPolydataFeature.h"
+
+#include <vtkAtomicInt.h>
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkNew.h>
+#include <vtkObjectFactory.h>
+#include <vtkPNGWriter.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkProperty.h>
+#include <vtkTimeStamp.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtk_sqlite.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+vtkStandardNewMacro(vtkMapTileRasterizer)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Highest tile zoom level
+const int MaxTileZoom = 30;
+
+// Shape types, by how they are drawn
+enum ShapeType
+  {
+  ShapeDot = 0,   // disk of diameter Size
+  ShapeLine,      // polyline of width Size
+  ShapePolygon,   // filled polygon
+  ShapeMarker,    // teardrop of height Size, tip at the point
+  ShapeCluster    // disk of radius Size
+  };
+
+// One thing to draw, in world coordinates (longitude, Mercator y)
+struct Shape
+{
+  int Type;
+  double Bounds[4];   // xmin, xmax, ymin, ymax
+  double Padding[4];  // pixels drawn past Bounds: left, right, below, above
+  int MinZoom;        // tile levels the shape is drawn at
+  int MaxZoom;
+  size_t First;       // first point in the coordinates array
+  size_t Count;       // number of points
+  double Size;
+  unsigned char Color[4];
+};
+
+// Per pixel coverage of a shape, in [0, 1], rows from the top
+struct CoverageMask
+{
+  int Size;
+  std::vector<float> Values;
+  int Box[4];  // covered pixels: columns Box[0]-Box[1], rows Box[2]-Box[3]
+
+  CoverageMask(int size) : Size(size), Values(size * size, 0.0f)
+  {
+    this->Box[0] = this->Box[2] = size;
+    this->Box[1] = this->Box[3] = -1;
+  }
+
+  // Clip a pixel coordinate box to the tile, returns false if empty
+  bool Clip(double x0, double x1, double y0, double y1, int box[4])
+  {
+    if (x1 < 0.0 || y1 < 0.0 || x0 >= this->Size || y0 >= this->Size)
+      {
+      return false;
+      }
+    box[0] = std::max(0, static_cast<int>(floor(x0)));
+    box[1] = std::min(this->Size - 1, static_cast<int>(floor(x1)));
+    box[2] = std::max(0, static_cast<int>(floor(y0)));
+    box[3] = std::min(this->Size - 1, static_cast<int>(floor(y1)));
+    this->Box[0] = std::min(this->Box[0], box[0]);
+    this->Box[1] = std::max(this->Box[1], box[1]);
+    this->Box[2] = std::min(this->Box[2], box[2]);
+    this->Box[3] = std::max(this->Box[3], box[3]);
+    return box[0] <= box[1] && box[2] <= box[3];
+  }
+
+  void Cover(int i, int row, double coverage)
+  {
+    float& value = this->Values[row * this->Size + i];
+    value = std::max(value, static_cast<float>(std::min(coverage, 1.0)));
+  }
+};
+
+//----------------------------------------------------------------------------
+// Anti-aliased disk centered on (cx, cy)
+void CoverDisk(CoverageMask& mask, double cx, double cy, double radius)
+{
+  int box[4];
+  if (!mask.Clip(cx - radius - 1.0, cx + radius + 1.0,
+                 cy - radius - 1.0, cy + radius + 1.0, box))
+    {
+    return;
+    }
+  for (int row = box[2]; row <= box[3]; ++row)
+    {
+    double dy = row + 0.5 - cy;
+    for (int i = box[0]; i <= box[1]; ++i)
+      {
+      double dx = i + 0.5 - cx;
+      double coverage = radius + 0.5 - sqrt(dx * dx + dy * dy);
+      if (coverage > 0.0)
+        {
+        mask.Cover(i, row, coverage);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Anti-aliased segment with round caps
+void CoverSegment(CoverageMask& mask, double x0, double y0,
+                  double x1, double y1, double halfWidth)
+{
+  int box[4];
+  double pad = halfWidth + 1.0;
+  if (!mask.Clip(std::min(x0, x1) - pad, std::max(x0, x1) + pad,
+                 std::min(y0, y1) - pad, std::max(y0, y1) + pad, box))
+    {
+    return;
+    }
+  double dx = x1 - x0;
+  double dy = y1 - y0;
+  double length2 = dx * dx + dy * dy;
+  for (int row = box[2]; row <= box[3]; ++row)
+    {
+    double py = row + 0.5;
+    for (int i = box[0]; i <= box[1]; ++i)
+      {
+      double px = i + 0.5;
+      double t = length2 > 0.0 ?
+        ((px - x0) * dx + (py - y0) * dy) / length2 : 0.0;
+      t = std::max(0.0, std::min(t, 1.0));
+      double ex = px - (x0 + t * dx);
+      double ey = py - (y0 + t * dy);
+      double coverage = halfWidth + 0.5 - sqrt(ex * ex + ey * ey);
+      if (coverage > 0.0)
+        {
+        mask.Cover(i, row, coverage);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Polygon (x, y pairs) filled with the even-odd rule, sampled at pixel
+// centers. Edges are not anti-aliased, so that triangulated polygons
+// show no seams.
+void CoverPolygon(CoverageMask& mask, const double *points, size_t count)
+{
+  double xmin = points[0], xmax = points[0];
+  double ymin = points[1], ymax = points[1];
+  for (size_t k = 1; k < count; ++k)
+    {
+    xmin = std::min(xmin, points[2 * k]);
+    xmax = std::max(xmax, points[2 * k]);
+    ymin = std::min(ymin, points[2 * k + 1]);
+    ymax = std::max(ymax, points[2 * k + 1]);
+    }
+  int box[4];
+  if (!mask.Clip(xmin, xmax, ymin, ymax, box))
+    {
+    return;
+    }
+
+  std::vector<double> crossings;
+  for (int row = box[2]; row <= box[3]; ++row)
+    {
+    double py = row + 0.5;
+    crossings.clear();
+    for (size_t k = 0; k < count; ++k)
+      {
+      const double *p0 = points + 2 * k;
+      const double *p1 = points + 2 * ((k + 1) % count);
+      if ((p0[1] <= py && py < p1[1]) || (p1[1] <= py && py < p0[1]))
+        {
+        crossings.push_back(
+          p0[0] + (py - p0[1]) * (p1[0] - p0[0]) / (p1[1] - p0[1]));
+        }
+      }
+    std::sort(crossings.begin(), crossings.end());
+    for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+      {
+      // Pixels with centers in [crossings[k], crossings[k + 1])
+      double first = std::max(0.0, ceil(crossings[k] - 0.5));
+      double last = std::min(mask.Size - 1.0, ceil(crossings[k + 1] - 0.5) - 1.0);
+      for (int i = static_cast<int>(first); i <= last; ++i)
+        {
+        mask.Cover(i, row, 1.0);
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Blend color over the RGBA image (rows from the bottom) where the mask
+// covers it, and clear the mask. Returns true if any pixel changed.
+bool Composite(unsigned char *image, CoverageMask& mask,
+               const unsigned char color[4])
+{
+  bool drawn = false;
+  for (int row = mask.Box[2]; row <= mask.Box[3]; ++row)
+    {
+    float *values = &mask.Values[row * mask.Size];
+    unsigned char *out = image + 4 * (mask.Size - 1 - row) * mask.Size;
+    for (int i = mask.Box[0]; i <= mask.Box[1]; ++i)
+      {
+      double alpha = values[i] * (color[3] / 255.0);
+      values[i] = 0.0f;
+      if (alpha <= 0.0)
+        {
+        continue;
+        }
+
+      // Non-premultiplied "over" operator, as in vtkCompositeTileSource
+      unsigned char *pixel = out + 4 * i;
+      double below = (pixel[3] / 255.0) * (1.0 - alpha);
+      double outAlpha = alpha + below;
+      for (int c = 0; c < 3; ++c)
+        {
+        pixel[c] = static_cast<unsigned char>(
+          (color[c] * alpha + pixel[c] * below) / outAlpha + 0.5);
+        }
+      pixel[3] = static_cast<unsigned char>(255.0 * outAlpha + 0.5);
+      drawn = true;
+      }
+    }
+  mask.Box[0] = mask.Box[2] = mask.Size;
+  mask.Box[1] = mask.Box[3] = -1;
+  return drawn;
+}
+
+//----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE StaticRasterizeThreadExecute(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkMapTileRasterizer *self =
+    static_cast<vtkMapTileRasterizer*>(info->UserData);
+  self->RasterizeThreadExecute();
+  return VTK_THREAD_RETURN_VALUE;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileRasterizer::vtkMapTileRasterizerInternals
+{
+public:
+  std::vector<vtkMapMarkerSet*> MarkerSets;
+  std::vector<vtkFeatureLayer*> FeatureLayers;
+
+  // Shapes to draw, and their points
+  std::vector<Shape> Shapes;
+  std::vector<double> Coordinates;
+  vtkTimeStamp BuildTime;
+
+  // Tile (Zoom, X, Y) with the shapes overlapping it, alone or with
+  // its subtree
+  struct Task
+  {
+    int Zoom, X, Y;
+    std::vector<vtkIdType> Shapes;
+    bool Subtree;
+  };
+  std::vector<Task> Tasks;
+
+  vtkAtomicInt<vtkTypeInt64> NextTask;
+  vtkAtomicInt<vtkTypeInt64> TasksDone;
+  vtkAtomicInt<vtkTypeInt64> Stored;
+  vtkAtomicInt<vtkTypeInt64> Empty;
+  vtkAtomicInt<vtkTypeInt64> Failed;
+  vtkAtomicInt<vtkTypeInt32> ActiveThreads;
+  vtkAtomicInt<vtkTypeInt32> Aborted;
+
+  // MBTiles output
+  vtk_sqlite3 *Package;
+  vtk_sqlite3_stmt *InsertStatement;
+  vtkMutexLock *PackageLock;
+
+  void AddShape(int type, size_t first, int minZoom, int maxZoom,
+                double size, const unsigned char color[4]);
+  bool Overlaps(const Shape& shape, int zoom, int x, int y, int tileSize);
+  void SelectShapes(int zoom, int x, int y, int tileSize,
+                    const std::vector<vtkIdType>& shapes,
+                    std::vector<vtkIdType>& selected);
+  vtkImageData *Render(int zoom, int x, int y, int tileSize,
+                       const std::vector<vtkIdType>& shapes);
+
+  bool OpenPackage(const char *filename, const char *name,
+                   std::string& errorMessage);
+  void ClosePackage();
+};
+
+//----------------------------------------------------------------------------
+// Add a shape with the points from first to the end of Coordinates,
+// and compute its bounds and padding
+void vtkMapTileRasterizer::vtkMapTileRasterizerInternals::
+AddShape(int type, size_t first, int minZoom, int maxZoom, double size,
+         const unsigned char color[4])
+{
+  Shape shape;
+  shape.Type = type;
+  shape.First = first;
+  shape.Count = (this->Coordinates.size() - 2 * first) / 2;
+  shape.MinZoom = minZoom;
+  shape.MaxZoom = maxZoom;
+  shape.Size = size;
+  std::copy(color, color + 4, shape.Color);
+
+  const double *point = &this->Coordinates[2 * first];
+  shape.Bounds[0] = shape.Bounds[1] = point[0];
+  shape.Bounds[2] = shape.Bounds[3] = point[1];
+  for (size_t k = 1; k < shape.Count; ++k)
+    {
+    shape.Bounds[0] = std::min(shape.Bounds[0], point[2 * k]);
+    shape.Bounds[1] = std::max(shape.Bounds[1], point[2 * k]);
+    shape.Bounds[2] = std::min(shape.Bounds[2], point[2 * k + 1]);
+    shape.Bounds[3] = std::max(shape.Bounds[3], point[2 * k + 1]);
+    }
+
+  // One more pixel for anti-aliasing
+  double pad = 1.0;
+  switch (type)
+    {
+    case ShapeDot:
+    case ShapeLine:
+      pad += 0.5 * size;
+      break;
+    case ShapeCluster:
+      pad += size;
+      break;
+    }
+  std::fill(shape.Padding, shape.Padding + 4, pad);
+  if (type == ShapeMarker)
+    {
+    // Teardrop above the point
+    shape.Padding[0] = shape.Padding[1] = 0.25 * size + 1.0;
+    shape.Padding[3] = size + 1.0;
+    }
+  this->Shapes.push_back(shape);
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRasterizer::vtkMapTileRasterizerInternals::
+Overlaps(const Shape& shape, int zoom, int x, int y, int tileSize)
+{
+  // Tile bounds and pixel size in world coordinates. Tile rows count
+  // down from the north.
+  double width = 360.0 / ldexp(1.0, zoom);
+  double pixel = width / tileSize;
+  double x0 = -180.0 + x * width;
+  double y1 = 180.0 - y * width;
+  return shape.Bounds[0] - shape.Padding[0] * pixel < x0 + width &&
+    shape.Bounds[1] + shape.Padding[1] * pixel > x0 &&
+    shape.Bounds[2] - shape.Padding[2] * pixel < y1 &&
+    shape.Bounds[3] + shape.Padding[3] * pixel > y1 - width;
+}
+
+//----------------------------------------------------------------------------
+// Select the shapes drawn in tile (zoom, x, y) or its subtree. The
+// padded bounds of a shape shrink with the zoom level, so that shapes
+// missing a tile also miss all its descendants.
+void vtkMapTileRasterizer::vtkMapTileRasterizerInternals::
+SelectShapes(int zoom, int x, int y, int tileSize,
+             const std::vector<vtkIdType>& shapes,
+             std::vector<vtkIdType>& selected)
+{
+  selected.clear();
+  for (size_t i = 0; i < shapes.size(); ++i)
+    {
+    const Shape& shape = this->Shapes[shapes[i]];
+    if (zoom <= shape.MaxZoom && this->Overlaps(shape, zoom, x, y, tileSize))
+      {
+      selected.push_back(shapes[i]);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileRasterizer::vtkMapTileRasterizerInternals::
+Render(int zoom, int x, int y, int tileSize,
+       const std::vector<vtkIdType>& shapes)
+{
+  vtkImageData *image = vtkImageData::New();
+  image->SetDimensions(tileSize, tileSize, 1);
+  image->AllocateScalars(VTK_UNSIGNED_CHAR, 4);
+  unsigned char *pixels =
+    static_cast<unsigned char*>(image->GetScalarPointer());
+  std::fill(pixels, pixels + 4 * tileSize * tileSize, 0);
+
+  // World to pixel coordinates, rows from the top of the tile
+  double scale = ldexp(1.0, zoom) * tileSize / 360.0;
+  double left = static_cast<double>(x) * tileSize;
+  double top = static_cast<double>(y) * tileSize;
+
+  CoverageMask mask(tileSize);
+  std::vector<double> points;
+  bool drawn = false;
+  for (size_t s = 0; s < shapes.size(); ++s)
+    {
+    const Shape& shape = this->Shapes[shapes[s]];
+    if (zoom < shape.MinZoom || zoom > shape.MaxZoom)
+      {
+      continue;
+      }
+
+    points.resize(2 * shape.Count);
+    const double *world = &this->Coordinates[2 * shape.First];
+    for (size_t k = 0; k < shape.Count; ++k)
+      {
+      points[2 * k] = (world[2 * k] + 180.0) * scale - left;
+      points[2 * k + 1] = (180.0 - world[2 * k + 1]) * scale - top;
+      }
+
+    double size = shape.Size;
+    switch (shape.Type)
+      {
+      case ShapeDot:
+        CoverDisk(mask, points[0], points[1], 0.5 * size);
+        break;
+
+      case ShapeLine:
+        for (size_t k = 0; k + 1 < shape.Count; ++k)
+          {
+          CoverSegment(mask, points[2 * k], points[2 * k + 1],
+                       points[2 * k + 2], points[2 * k + 3], 0.5 * size);
+          }
+        break;
+
+      case ShapePolygon:
+        CoverPolygon(mask, &points[0], shape.Count);
+        break;
+
+      case ShapeMarker:
+        {
+        // Head of radius size/4 centered 3/4 of size above the tip, as
+        // vtkTeardropSource, and a tail down to the tip
+        double head = points[1] - 0.75 * size;
+        CoverDisk(mask, points[0], head, 0.25 * size);
+        double tail[6] = { points[0], points[1],
+                           points[0] - 0.25 * size, head,
+                           points[0] + 0.25 * size, head };
+        CoverPolygon(mask, tail, 3);
+        }
+        break;
+
+      case ShapeCluster:
+        CoverDisk(mask, points[0], points[1], size);
+        break;
+      }
+    drawn = Composite(pixels, mask, shape.Color) || drawn;
+    }
+
+  if (!drawn)
+    {
+    image->Delete();
+    return NULL;
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRasterizer::vtkMapTileRasterizerInternals::
+OpenPackage(const char *filename, const char *name, std::string& errorMessage)
+{
+  // Schema of https://github.com/mapbox/mbtiles-spec, as vtkMapTileSeeder
+  std::string sql =
+    "CREATE TABLE IF NOT EXISTS metadata (name text, value text);"
+    "CREATE TABLE IF NOT EXISTS tiles (zoom_level integer,"
+    " tile_column integer, tile_row integer, tile_data blob);"
+    "CREATE UNIQUE INDEX IF NOT EXISTS tile_index"
+    " ON tiles (zoom_level, tile_column, tile_row);"
+    "INSERT INTO metadata SELECT 'format', 'png'"
+    " WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE name='format');"
+    "INSERT INTO metadata SELECT 'type', 'overlay'"
+    " WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE name='type');";
+  std::string quotedName(name);
+  std::string::size_type pos = quotedName.find('\'');
+  while (pos != std::string::npos)
+    {
+    quotedName.insert(pos, 1, '\'');
+    pos = quotedName.find('\'', pos + 2);
+    }
+  sql += "INSERT INTO metadata SELECT 'name', '" + quotedName + "'"
+    " WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE name='name');";
+
+  // Other processes may be writing to the package: wait for their locks
+  bool ok =
+    vtk_sqlite3_open_v2(filename, &this->Package,
+                        VTK_SQLITE_OPEN_READWRITE | VTK_SQLITE_OPEN_CREATE,
+                        NULL) == VTK_SQLITE_OK &&
+    vtk_sqlite3_busy_timeout(this->Package, 60000) == VTK_SQLITE_OK &&
+    vtk_sqlite3_exec(this->Package, sql.c_str(), NULL, NULL, NULL) ==
+    VTK_SQLITE_OK &&
+    vtk_sqlite3_prepare_v2(this->Package,
+                           "INSERT OR REPLACE INTO tiles"
+                           " VALUES (?1, ?2, ?3, ?4)", -1,
+                           &this->InsertStatement, NULL) == VTK_SQLITE_OK;
+  if (!ok)
+    {
+    errorMessage = std::string("Cannot write MBTiles file ") + filename +
+      ": " + (this->Package ?
+              vtk_sqlite3_errmsg(this->Package) : "out of memory");
+    this->ClosePackage();
+    }
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::vtkMapTileRasterizerInternals::ClosePackage()
+{
+  if (this->InsertStatement)
+    {
+    vtk_sqlite3_finalize(this->InsertStatement);
+    this->InsertStatement = NULL;
+    }
+  if (this->Package)
+    {
+    vtk_sqlite3_close(this->Package);
+    this->Package = NULL;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRasterizer::vtkMapTileRasterizer()
+{
+  this->MarkerSize = 50.0;
+  // Same as vtkMapMarkerSet
+  this->MarkerColor[0] = 0.0;
+  this->MarkerColor[1] = 83.0 / 255.0;
+  this->MarkerColor[2] = 155.0 / 255.0;
+  this->ClusterColor[0] = 0.0;
+  this->ClusterColor[1] = 169.0 / 255.0;
+  this->ClusterColor[2] = 179.0 / 255.0;
+  this->MinZoom = 0;
+  this->MaxZoom = 10;
+  this->TileSize = 256;
+  this->OutputDirectory = NULL;
+  this->PackageFileName = NULL;
+  this->Name = NULL;
+  this->SetName("overlay");
+  this->NumberOfThreads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->NumberOfProcesses = 1;
+  this->ProcessIndex = 0;
+
+  this->Internals = new vtkMapTileRasterizerInternals;
+  this->Internals->Package = NULL;
+  this->Internals->InsertStatement = NULL;
+  this->Internals->PackageLock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRasterizer::~vtkMapTileRasterizer()
+{
+  this->RemoveAllInputs();
+  this->SetOutputDirectory(NULL);
+  this->SetPackageFileName(NULL);
+  this->SetName(NULL);
+  this->Internals->ClosePackage();
+  this->Internals->PackageLock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "MarkerSets: " << this->Internals->MarkerSets.size() << "\n"
+     << indent << "FeatureLayers: " << this->Internals->FeatureLayers.size()
+     << "\n"
+     << indent << "Zoom: " << this->MinZoom << " to " << this->MaxZoom << "\n"
+     << indent << "TileSize: " << this->TileSize << "\n"
+     << indent << "MarkerSize: " << this->MarkerSize << "\n"
+     << indent << "OutputDirectory: "
+     << (this->OutputDirectory ? this->OutputDirectory : "(none)") << "\n"
+     << indent << "PackageFileName: "
+     << (this->PackageFileName ? this->PackageFileName : "(none)") << "\n"
+     << indent << "Name: " << (this->Name ? this->Name : "(none)") << "\n"
+     << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n"
+     << indent << "Process: " << this->ProcessIndex << " of "
+     << this->NumberOfProcesses << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::AddMarkerSet(vtkMapMarkerSet *markerSet)
+{
+  if (!markerSet)
+    {
+    return;
+    }
+
+  markerSet->Register(this);
+  this->Internals->MarkerSets.push_back(markerSet);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::AddFeatureLayer(vtkFeatureLayer *layer)
+{
+  if (!layer)
+    {
+    return;
+    }
+
+  layer->Register(this);
+  this->Internals->FeatureLayers.push_back(layer);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::RemoveAllInputs()
+{
+  for (size_t i = 0; i < this->Internals->MarkerSets.size(); ++i)
+    {
+    this->Internals->MarkerSets[i]->UnRegister(this);
+    }
+  for (size_t i = 0; i < this->Internals->FeatureLayers.size(); ++i)
+    {
+    this->Internals->FeatureLayers[i]->UnRegister(this);
+    }
+  this->Internals->MarkerSets.clear();
+  this->Internals->FeatureLayers.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::BuildShapes()
+{
+  // Rebuild when the settings or the inputs changed
+  unsigned long mtime = this->GetMTime();
+  for (size_t i = 0; i < this->Internals->MarkerSets.size(); ++i)
+    {
+    mtime = std::max(mtime, this->Internals->MarkerSets[i]->GetMTime());
+    }
+  for (size_t i = 0; i < this->Internals->FeatureLayers.size(); ++i)
+    {
+    mtime = std::max(mtime, this->Internals->FeatureLayers[i]->GetMTime());
+    }
+  if (this->Internals->BuildTime.GetMTime() > mtime)
+    {
+    return;
+    }
+
+  std::vector<Shape>& shapes = this->Internals->Shapes;
+  std::vector<double>& coords = this->Internals->Coordinates;
+  shapes.clear();
+  coords.clear();
+
+  // Features, drawn at all levels
+  for (size_t i = 0; i < this->Internals->FeatureLayers.size(); ++i)
+    {
+    vtkFeatureLayer *layer = this->Internals->FeatureLayers[i];
+    for (int f = 0; f < layer->GetNumberOfFeatures(); ++f)
+      {
+      vtkPolydataFeature *feature =
+        vtkPolydataFeature::SafeDownCast(layer->GetFeature(f));
+      vtkPolyData *polyData = feature ? feature->GetMapper()->GetInput() : NULL;
+      if (!polyData || !polyData->GetPoints() || !feature->GetVisibility())
+        {
+        continue;
+        }
+
+      vtkProperty *property = feature->GetActor()->GetProperty();
+      double rgb[3];
+      property->GetColor(rgb);
+      unsigned char color[4];
+      for (int c = 0; c < 3; ++c)
+        {
+        color[c] = static_cast<unsigned char>(255.0 * rgb[c] + 0.5);
+        }
+      color[3] = static_cast<unsigned char>(
+        255.0 * property->GetOpacity() + 0.5);
+
+      vtkPoints *points = polyData->GetPoints();
+      vtkCellArray *cells[3] =
+        { polyData->GetVerts(), polyData->GetLines(), polyData->GetPolys() };
+      for (int type = ShapeDot; type <= ShapePolygon; ++type)
+        {
+        if (!cells[type])
+          {
+          continue;
+          }
+        vtkIdType count;
+        vtkIdType *ids;
+        cells[type]->InitTraversal();
+        while (cells[type]->GetNextCell(count, ids))
+          {
+          // Vertex cells may hold several points, drawn as dots
+          vtkIdType step = type == ShapeDot ? 1 : count;
+          if ((type == ShapeLine && count < 2) ||
+              (type == ShapePolygon && count < 3))
+            {
+            continue;
+            }
+          for (vtkIdType k = 0; k < count; k += step)
+            {
+            size_t first = coords.size() / 2;
+            for (vtkIdType p = k; p < k + step; ++p)
+              {
+              double point[3];
+              points->GetPoint(ids[p], point);
+              coords.push_back(point[0]);
+              coords.push_back(point[1]);
+              }
+            this->Internals->AddShape(
+              type, first, 0, MaxTileZoom,
+              type == ShapeDot ? property->GetPointSize() :
+              property->GetLineWidth(), color);
+            }
+          }
+        }
+      }
+    }
+
+  // Markers, over the features. Cluster level L is shown at tile level
+  // L + 1; the first and last levels also cover the levels past them.
+  unsigned char markerColor[4];
+  unsigned char clusterColor[4];
+  for (int c = 0; c < 3; ++c)
+    {
+    markerColor[c] =
+      static_cast<unsigned char>(255.0 * this->MarkerColor[c] + 0.5);
+    clusterColor[c] =
+      static_cast<unsigned char>(255.0 * this->ClusterColor[c] + 0.5);
+    }
+  markerColor[3] = clusterColor[3] = 255;
+  int lastLevel = vtkMapMarkerSet::GetNumberOfClusterLevels() - 1;
+  vtkNew<vtkPoints> points;
+  vtkNew<vtkIntArray> counts;
+  for (size_t i = 0; i < this->Internals->MarkerSets.size(); ++i)
+    {
+    vtkMapMarkerSet *markerSet = this->Internals->MarkerSets[i];
+    int levels = markerSet->GetClustering() ? lastLevel + 1 : 1;
+    for (int level = 0; level < levels; ++level)
+      {
+      int minZoom = level == 0 ? 0 : level + 1;
+      int maxZoom = (level == levels - 1) ? MaxTileZoom : level + 1;
+      if (maxZoom < this->MinZoom || minZoom > this->MaxZoom)
+        {
+        continue;
+        }
+
+      markerSet->GetMarkers(level, points.GetPointer(), counts.GetPointer());
+      for (vtkIdType k = 0; k < points->GetNumberOfPoints(); ++k)
+        {
+        double point[3];
+        points->GetPoint(k, point);
+        size_t first = coords.size() / 2;
+        coords.push_back(point[0]);
+        coords.push_back(point[1]);
+        int numberOfMarkers = counts->GetValue(k);
+        if (numberOfMarkers > 1)
+          {
+          double radius = 0.25 * this->MarkerSize *
+            markerSet->GetClusterScale(numberOfMarkers);
+          this->Internals->AddShape(ShapeCluster, first, minZoom, maxZoom,
+                                    radius, clusterColor);
+          }
+        else
+          {
+          this->Internals->AddShape(ShapeMarker, first, minZoom, maxZoom,
+                                    this->MarkerSize, markerColor);
+          }
+        }
+      }
+    }
+
+  this->Internals->BuildTime.Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileRasterizer::RasterizeTile(int zoom, int x, int y)
+{
+  int last = (1 << zoom) - 1;
+  if (zoom < 0 || zoom > MaxTileZoom || x < 0 || x > last ||
+      y < 0 || y > last)
+    {
+    vtkErrorMacro("Invalid tile " << zoom << "/" << x << "/" << y);
+    return NULL;
+    }
+
+  this->BuildShapes();
+  std::vector<vtkIdType> all(this->Internals->Shapes.size());
+  for (size_t i = 0; i < all.size(); ++i)
+    {
+    all[i] = static_cast<vtkIdType>(i);
+    }
+  std::vector<vtkIdType> shapes;
+  this->Internals->SelectShapes(zoom, x, y, this->TileSize, all, shapes);
+  if (shapes.empty())
+    {
+    return NULL;
+    }
+  return this->Internals->Render(zoom, x, y, this->TileSize, shapes);
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::BuildTasks()
+{
+  typedef vtkMapTileRasterizerInternals::Task Task;
+  std::vector<Task>& tasks = this->Internals->Tasks;
+  tasks.clear();
+
+  // Walk down the pyramid, keeping non-empty tiles only, until a level
+  // has enough tiles to keep all threads of all processes busy. Levels
+  // above are rendered one tile per task.
+  size_t enough = 4 * static_cast<size_t>(this->NumberOfThreads) *
+    this->NumberOfProcesses;
+  std::vector<Task> level(1);
+  level[0].Zoom = level[0].X = level[0].Y = 0;
+  std::vector<vtkIdType> all(this->Internals->Shapes.size());
+  for (size_t i = 0; i < all.size(); ++i)
+    {
+    all[i] = static_cast<vtkIdType>(i);
+    }
+  this->Internals->SelectShapes(0, 0, 0, this->TileSize, all,
+                                level[0].Shapes);
+  if (level[0].Shapes.empty())
+    {
+    level.clear();
+    }
+
+  int maxZoom = std::max(this->MinZoom, this->MaxZoom);
+  while (!level.empty())
+    {
+    int zoom = level[0].Zoom;
+    bool subtrees = zoom >= this->MinZoom &&
+      (zoom == maxZoom || level.size() >= enough);
+    if (zoom >= this->MinZoom)
+      {
+      for (size_t i = 0; i < level.size(); ++i)
+        {
+        level[i].Subtree = subtrees;
+        tasks.push_back(level[i]);
+        }
+      }
+    if (subtrees)
+      {
+      break;
+      }
+
+    std::vector<Task> next;
+    for (size_t i = 0; i < level.size(); ++i)
+      {
+      for (int child = 0; child < 4; ++child)
+        {
+        Task task;
+        task.Zoom = zoom + 1;
+        task.X = 2 * level[i].X + (child & 1);
+        task.Y = 2 * level[i].Y + (child >> 1);
+        this->Internals->SelectShapes(task.Zoom, task.X, task.Y,
+                                      this->TileSize, level[i].Shapes,
+                                      task.Shapes);
+        if (!task.Shapes.empty())
+          {
+          next.push_back(task);
+          }
+        }
+      }
+    level.swap(next);
+    }
+
+  // Keep this process' share
+  if (this->NumberOfProcesses > 1)
+    {
+    std::vector<Task> share;
+    for (size_t i = this->ProcessIndex; i < tasks.size();
+         i += this->NumberOfProcesses)
+      {
+      share.push_back(tasks[i]);
+      }
+    tasks.swap(share);
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRasterizer::Rasterize()
+{
+  if (!this->OutputDirectory && !this->PackageFileName)
+    {
+    vtkErrorMacro("No OutputDirectory or PackageFileName specified");
+    return false;
+    }
+  if (this->ProcessIndex >= this->NumberOfProcesses)
+    {
+    vtkErrorMacro("Invalid ProcessIndex " << this->ProcessIndex << " for "
+                  << this->NumberOfProcesses << " processes");
+    return false;
+    }
+
+  this->BuildShapes();
+  this->BuildTasks();
+  this->Internals->NextTask = 0;
+  this->Internals->TasksDone = 0;
+  this->Internals->Stored = 0;
+  this->Internals->Empty = 0;
+  this->Internals->Failed = 0;
+  this->Internals->Aborted = 0;
+
+  if (this->PackageFileName)
+    {
+    std::string errorMessage;
+    if (!this->Internals->OpenPackage(this->PackageFileName,
+                                      this->Name ? this->Name : "",
+                                      errorMessage))
+      {
+      vtkErrorMacro(<< errorMessage);
+      return false;
+      }
+    }
+  else if (!vtksys::SystemTools::MakeDirectory(this->OutputDirectory))
+    {
+    vtkErrorMacro("Cannot create directory " << this->OutputDirectory);
+    return false;
+    }
+
+  // Render on spawned threads, and report progress from this one,
+  // so that observers are called on the caller's thread
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  std::vector<int> threadIds;
+  this->Internals->ActiveThreads = this->NumberOfThreads;
+  for (int i = 0; i < this->NumberOfThreads; ++i)
+    {
+    threadIds.push_back(
+      threader->SpawnThread(StaticRasterizeThreadExecute, this));
+    }
+
+  vtkTypeInt64 total = static_cast<vtkTypeInt64>(this->Internals->Tasks.size());
+  double progress = 0.0;
+  this->InvokeEvent(vtkCommand::StartEvent);
+  while (this->Internals->ActiveThreads > 0)
+    {
+    vtksys::SystemTools::Delay(250);
+    vtkTypeInt64 done = this->Internals->TasksDone;
+    progress = total > 0 ? static_cast<double>(done) / total : 1.0;
+    this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+    }
+
+  for (size_t i = 0; i < threadIds.size(); ++i)
+    {
+    threader->TerminateThread(threadIds[i]);
+    }
+  threader->Delete();
+  this->Internals->ClosePackage();
+  this->Internals->Tasks.clear();
+  this->InvokeEvent(vtkCommand::EndEvent);
+
+  return !this->Internals->Aborted && this->Internals->Failed == 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::Abort()
+{
+  this->Internals->Aborted = 1;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRasterizer::GetNumberOfStoredTiles()
+{
+  return this->Internals->Stored;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRasterizer::GetNumberOfEmptyTiles()
+{
+  return this->Internals->Empty;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileRasterizer::GetNumberOfFailedTiles()
+{
+  return this->Internals->Failed;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::RasterizeThreadExecute()
+{
+  vtkTypeInt64 count = static_cast<vtkTypeInt64>(this->Internals->Tasks.size());
+  while (!this->Internals->Aborted)
+    {
+    vtkTypeInt64 index = this->Internals->NextTask++;
+    if (index >= count)
+      {
+      break;
+      }
+
+    vtkMapTileRasterizerInternals::Task& task = this->Internals->Tasks[index];
+    this->RasterizeTiles(task.Zoom, task.X, task.Y, task.Shapes,
+                         task.Subtree);
+    this->Internals->TasksDone++;
+    }
+
+  this->Internals->ActiveThreads--;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRasterizer::
+RasterizeTiles(int zoom, int x, int y, const std::vector<vtkIdType>& shapes,
+               bool subtree)
+{
+  if (this->Internals->Aborted)
+    {
+    return;
+    }
+
+  if (zoom >= this->MinZoom)
+    {
+    vtkImageData *image =
+      this->Internals->Render(zoom, x, y, this->TileSize, shapes);
+    std::string errorMessage;
+    if (!image)
+      {
+      this->Internals->Empty++;
+      }
+    else if (this->StoreTile(zoom, x, y, image, errorMessage))
+      {
+      this->Internals->Stored++;
+      }
+    else
+      {
+      vtkWarningMacro(<< errorMessage);
+      this->Internals->Failed++;
+      }
+    if (image)
+      {
+      image->Delete();
+      }
+    }
+
+  if (!subtree || zoom >= this->MaxZoom)
+    {
+    return;
+    }
+
+  // Only descend into children with content
+  std::vector<vtkIdType> selected;
+  for (int child = 0; child < 4; ++child)
+    {
+    int childX = 2 * x + (child & 1);
+    int childY = 2 * y + (child >> 1);
+    this->Internals->SelectShapes(zoom + 1, childX, childY, this->TileSize,
+                                  shapes, selected);
+    if (!selected.empty())
+      {
+      this->RasterizeTiles(zoom + 1, childX, childY, selected, true);
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileRasterizer::StoreTile(int zoom, int x, int y,
+                                     vtkImageData *image,
+                                     std::string& errorMessage)
+{
+  vtkNew<vtkPNGWriter> writer;
+  writer->WriteToMemoryOn();
+  writer->SetInputData(image);
+  writer->Write();
+  vtkUnsignedCharArray *data = writer->GetResult();
+  if (!data || data->GetNumberOfTuples() == 0)
+    {
+    std::stringstream oss;
+    oss << "Cannot encode tile " << zoom << "/" << x << "/" << y;
+    errorMessage = oss.str();
+    return false;
+    }
+  const unsigned char *bytes = data->GetPointer(0);
+  size_t length = static_cast<size_t>(data->GetNumberOfTuples());
+
+  if (this->PackageFileName)
+    {
+    // MBTiles rows count up from the bottom
+    this->Internals->PackageLock->Lock();
+    vtk_sqlite3_stmt *insert = this->Internals->InsertStatement;
+    vtk_sqlite3_bind_int(insert, 1, zoom);
+    vtk_sqlite3_bind_int(insert, 2, x);
+    vtk_sqlite3_bind_int(insert, 3, (1 << zoom) - 1 - y);
+    vtk_sqlite3_bind_blob(insert, 4, bytes, static_cast<int>(length),
+                          VTK_SQLITE_STATIC);
+    bool ok = vtk_sqlite3_step(insert) == VTK_SQLITE_DONE;
+    vtk_sqlite3_reset(insert);
+    if (!ok)
+      {
+      errorMessage = vtk_sqlite3_errmsg(this->Internals->Package);
+      }
+    this->Internals->PackageLock->Unlock();
+    return ok;
+    }
+
+  std::stringstream directory;
+  directory << this->OutputDirectory << "/" << zoom << "/" << x;
+  std::stringstream filename;
+  filename << directory.str() << "/" << y << ".png";
+  vtksys::SystemTools::MakeDirectory(directory.str().c_str());
+  std::ofstream file(filename.str().c_str(),
+                     std::ios::out | std::ios::binary);
+  file.write(reinterpret_cast<const char*>(bytes),
+             static_cast<std::streamsize>(length));
+  if (!file)
+    {
+    errorMessage = "Cannot write " + filename.str();
+    return false;
+    }
+  return true;
+}
@@ -0,0 +1,198 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRasterizer.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileRasterizer - render map overlays into image tiles
+// .SECTION Description
+// Renders markers and features into transparent PNG tiles, on the CPU,
+// so that clients without OpenGL (e.g. web pages) can show the overlays
+// of a vtkMap on top of their base map. Markers are drawn as single or
+// cluster markers, at the cluster level vtkMapMarkerSet shows one level
+// below the tile level (see vtkMapTileSeeder). Features are drawn with
+// the color, opacity, line width and point size of their actor's
+// property; scalar colors are not used.
+//
+// Tiles are stored either in a directory, as <zoom>/<x>/<y>.png (readable
+// with a "file://<directory>/{z}/{x}/{y}.png" vtkMapTileSource, or
+// served as is by a web server), or in an MBTiles package that can be read
+// with vtkMBTilesTileSource. Existing tiles are replaced.
+//
+// The pyramid is walked as a quadtree: each tile only keeps the shapes
+// overlapping it, so subtrees without content are skipped without visiting
+// their tiles, and tiles without content are not written. Tiles are
+// rendered on several threads, and can be split between processes with
+// NumberOfProcesses and ProcessIndex (all processes must be given the
+// same input). Rasterize() invokes vtkCommand::ProgressEvent periodically,
+// with the fraction of work done as call data (a double*).
+
+#ifndef __vtkMapTileRasterizer_h
+#define __vtkMapTileRasterizer_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+#include <string>
+#include <vector>
+
+class vtkFeatureLayer;
+class vtkImageData;
+class vtkMapMarkerSet;
+
+class VTKMAP_EXPORT vtkMapTileRasterizer : public vtkObject
+{
+public:
+  static vtkMapTileRasterizer *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileRasterizer, vtkObject)
+
+  // Description:
+  // Add markers or features to render. Inputs are drawn in the order
+  // they are added, except that markers are drawn over the features.
+  void AddMarkerSet(vtkMapMarkerSet *markerSet);
+  void AddFeatureLayer(vtkFeatureLayer *layer);
+  void RemoveAllInputs();
+
+  // Description:
+  // Get/Set the range of tile zoom levels to render. Default is 0 to 10.
+  vtkSetClampMacro(MinZoom, int, 0, 30)
+  vtkGetMacro(MinZoom, int)
+  vtkSetClampMacro(MaxZoom, int, 0, 30)
+  vtkGetMacro(MaxZoom, int)
+
+  // Description:
+  // Get/Set the width and height of the tiles, in pixels. Default is 256.
+  vtkSetClampMacro(TileSize, int, 1, 4096)
+  vtkGetMacro(TileSize, int)
+
+  // Description:
+  // Get/Set the height of single markers, in pixels. Cluster markers
+  // are half as wide, scaled up by vtkMapMarkerSet::GetClusterScale().
+  // Default is 50, as drawn by vtkMapMarkerSet.
+  vtkSetClampMacro(MarkerSize, double, 1.0, 1000.0)
+  vtkGetMacro(MarkerSize, double)
+
+  // Description:
+  // Get/Set the colors of single and cluster markers, RGB in [0, 1].
+  // Defaults are those of vtkMapMarkerSet.
+  vtkSetVector3Macro(MarkerColor, double)
+  vtkGetVector3Macro(MarkerColor, double)
+  vtkSetVector3Macro(ClusterColor, double)
+  vtkGetVector3Macro(ClusterColor, double)
+
+  // Description:
+  // Get/Set the directory to write <zoom>/<x>/<y>.png tiles to
+  vtkSetStringMacro(OutputDirectory)
+  vtkGetStringMacro(OutputDirectory)
+
+  // Description:
+  // Get/Set the MBTiles package to write instead of the directory.
+  // The package is created if it doesn't exist.
+  vtkSetStringMacro(PackageFileName)
+  vtkGetStringMacro(PackageFileName)
+
+  // Description:
+  // Get/Set the name of the tile set, stored in new packages.
+  // Default is "overlay".
+  vtkSetStringMacro(Name)
+  vtkGetStringMacro(Name)
+
+  // Description:
+  // Get/Set the number of rendering threads. Default is the number
+  // of cores.
+  vtkSetClampMacro(NumberOfThreads, int, 1, 64)
+  vtkGetMacro(NumberOfThreads, int)
+
+  // Description:
+  // Get/Set the number of processes sharing the work, and the index of
+  // this one. Each process renders its share of the pyramid, so that
+  // several processes, e.g. on several hosts, can fill the same directory
+  // or package. Default is 1 and 0.
+  vtkSetClampMacro(NumberOfProcesses, int, 1, VTK_INT_MAX)
+  vtkGetMacro(NumberOfProcesses, int)
+  vtkSetClampMacro(ProcessIndex, int, 0, VTK_INT_MAX)
+  vtkGetMacro(ProcessIndex, int)
+
+  // Description:
+  // Render tile (zoom, x, y), with rows counted from the north as in
+  // tile urls. Returns a new RGBA image that the caller must Delete(),
+  // or NULL if the tile has no content.
+  vtkImageData *RasterizeTile(int zoom, int x, int y);
+
+  // Description:
+  // Render and store the tiles. Blocks until all tiles are done or
+  // Abort() is called. Returns false if tiles could not be stored or
+  // the rendering was aborted.
+  bool Rasterize();
+
+  // Description:
+  // Stop rendering as soon as the current tiles are done.
+  // May be called from a progress observer or another thread.
+  void Abort();
+
+  // Description:
+  // Counts of tiles processed by Rasterize(): stored, rendered without
+  // content, and failed to store. Tiles skipped through the index are
+  // not counted.
+  vtkTypeInt64 GetNumberOfStoredTiles();
+  vtkTypeInt64 GetNumberOfEmptyTiles();
+  vtkTypeInt64 GetNumberOfFailedTiles();
+
+  // Description:
+  // Thread entry point; not intended for general use
+  void RasterizeThreadExecute();
+
+protected:
+  vtkMapTileRasterizer();
+  ~vtkMapTileRasterizer();
+
+  // Description:
+  // Convert the markers and features to shapes in world coordinates
+  void BuildShapes();
+
+  // Description:
+  // Split the pyramid into tasks, balanced between threads and processes
+  void BuildTasks();
+
+  // Description:
+  // Render and store tile (zoom, x, y) with the shapes overlapping it,
+  // then its children if subtree is true
+  void RasterizeTiles(int zoom, int x, int y,
+                      const std::vector<vtkIdType>& shapes, bool subtree);
+
+  // Description:
+  // Store the image of tile (zoom, x, y). Returns false on failure.
+  bool StoreTile(int zoom, int x, int y, vtkImageData *image,
+                 std::string& errorMessage);
+
+  double MarkerSize;
+  double MarkerColor[3];
+  double ClusterColor[3];
+  int MinZoom;
+  int MaxZoom;
+  int TileSize;
+  char *OutputDirectory;
+  char *PackageFileName;
+  char *Name;
+  int NumberOfThreads;
+  int NumberOfProcesses;
+  int ProcessIndex;
+
+  class vtkMapTileRasterizerInternals;
+  vtkMapTileRasterizerInternals *Internals;
+
+private:
+  vtkMapTileRasterizer(const vtkMapTileRasterizer&);  // Not implemented
+  vtkMapTileRasterizer& operator=(const vtkMapTileRasterizer&); // Not implemented
+};
+
+#endif // __vtkMapTileRasterizer_h
@@ -0,0 +1,229 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRateLimiter.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileRateLimiter.h"
+#include "vtkMapTileClock.h"
+
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+#include <algorithm>
+#include <map>
+
+vtkStandardNewMacro(vtkMapTileRateLimiter)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Longest sleep while waiting, so that new requests and
+// setting changes are picked up
+const double MaxWaitInterval = 0.1;
+
+// Token bucket, refilled at a constant rate up to its capacity
+struct Bucket
+{
+  double Tokens;
+  double Time;  // of last refill
+  bool Unused;  // fill on first use
+
+  Bucket() : Tokens(0.0), Time(0.0), Unused(true) {}
+
+  void Refill(double rate, double capacity, double now)
+  {
+    if (this->Unused)
+      {
+      this->Tokens = capacity;
+      this->Unused = false;
+      }
+    else if (rate > 0.0)
+      {
+      this->Tokens = std::min(capacity,
+                              this->Tokens + rate * (now - this->Time));
+      }
+    this->Time = now;
+  }
+
+  // Seconds until the bucket holds the specified number of tokens
+  double GetWaitTime(double rate, double tokens) const
+  {
+    return (rate > 0.0 && this->Tokens < tokens) ?
+      (tokens - this->Tokens) / rate : 0.0;
+  }
+};
+
+struct HostBuckets
+{
+  Bucket Requests;
+  Bucket Bytes;
+  int Waiting[vtkMapTileRateLimiter::NumberOfPriorities];
+
+  HostBuckets()
+  {
+    std::fill(this->Waiting,
+              this->Waiting + vtkMapTileRateLimiter::NumberOfPriorities, 0);
+  }
+};
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileRateLimiter::vtkMapTileRateLimiterInternals
+{
+public:
+  std::map<std::string, HostBuckets> Hosts;
+  Bucket Bytes;  // over all hosts
+  int Waiting[NumberOfPriorities];  // over all hosts
+  vtkMutexLock *Lock;
+};
+
+//----------------------------------------------------------------------------
+vtkMapTileRateLimiter::vtkMapTileRateLimiter()
+{
+  this->RequestsPerSecondPerHost = 10.0;
+  this->BytesPerSecondPerHost = 0.0;
+  this->MaxBytesPerSecond = 0.0;
+  this->BurstDuration = 1.0;
+
+  this->Clock = vtkMapTileClock::New();
+  this->Internals = new vtkMapTileRateLimiterInternals;
+  std::fill(this->Internals->Waiting,
+            this->Internals->Waiting + NumberOfPriorities, 0);
+  this->Internals->Lock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileRateLimiter::~vtkMapTileRateLimiter()
+{
+  this->Internals->Lock->Delete();
+  delete this->Internals;
+  this->Clock->Delete();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRateLimiter::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "RequestsPerSecondPerHost: "
+     << this->RequestsPerSecondPerHost << "\n"
+     << indent << "BytesPerSecondPerHost: "
+     << this->BytesPerSecondPerHost << "\n"
+     << indent << "MaxBytesPerSecond: " << this->MaxBytesPerSecond << "\n"
+     << indent << "BurstDuration: " << this->BurstDuration << "\n"
+     << indent << "Clock: " << this->Clock->GetClassName() << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRateLimiter::SetClock(vtkMapTileClock *clock)
+{
+  if (!clock || clock == this->Clock)
+    {
+    return;
+    }
+
+  clock->Register(this);
+  this->Clock->UnRegister(this);
+  this->Clock = clock;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRateLimiter::Acquire(const std::string& host, int priority)
+{
+  priority = std::max(0, std::min(priority, NumberOfPriorities - 1));
+
+  this->Internals->Lock->Lock();
+  HostBuckets& buckets = this->Internals->Hosts[host];
+  buckets.Waiting[priority]++;
+  this->Internals->Waiting[priority]++;
+  while (true)
+    {
+    double requestRate = this->RequestsPerSecondPerHost;
+    double hostByteRate = this->BytesPerSecondPerHost;
+    double byteRate = this->MaxBytesPerSecond;
+    double burst = std::max(this->BurstDuration, 0.0);
+    double now = this->Clock->GetTime();
+    buckets.Requests.Refill(requestRate, std::max(1.0, requestRate * burst),
+                            now);
+    buckets.Bytes.Refill(hostByteRate, hostByteRate * burst, now);
+    this->Internals->Bytes.Refill(byteRate, byteRate * burst, now);
+
+    // Let higher priority requests go first
+    bool yield = false;
+    for (int i = 0; i < priority; ++i)
+      {
+      yield = yield || buckets.Waiting[i] > 0 ||
+        (byteRate > 0.0 && this->Internals->Waiting[i] > 0);
+      }
+
+    double wait = MaxWaitInterval;
+    if (!yield)
+      {
+      wait = std::max(buckets.Requests.GetWaitTime(requestRate, 1.0),
+               std::max(buckets.Bytes.GetWaitTime(hostByteRate, 0.0),
+                 this->Internals->Bytes.GetWaitTime(byteRate, 0.0)));
+      if (wait <= 0.0)
+        {
+        if (requestRate > 0.0)
+          {
+          buckets.Requests.Tokens -= 1.0;
+          }
+        break;
+        }
+      }
+
+    this->Internals->Lock->Unlock();
+    this->Clock->Sleep(std::min(wait, MaxWaitInterval) + 0.001);
+    this->Internals->Lock->Lock();
+    }
+  buckets.Waiting[priority]--;
+  this->Internals->Waiting[priority]--;
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRateLimiter::RecordBytes(const std::string& host, double bytes)
+{
+  this->Internals->Lock->Lock();
+  double now = this->Clock->GetTime();
+  double burst = std::max(this->BurstDuration, 0.0);
+  HostBuckets& buckets = this->Internals->Hosts[host];
+  buckets.Bytes.Refill(this->BytesPerSecondPerHost,
+                       this->BytesPerSecondPerHost * burst, now);
+  this->Internals->Bytes.Refill(this->MaxBytesPerSecond,
+                                this->MaxBytesPerSecond * burst, now);
+  if (this->BytesPerSecondPerHost > 0.0)
+    {
+    buckets.Bytes.Tokens -= bytes;
+    }
+  if (this->MaxBytesPerSecond > 0.0)
+    {
+    this->Internals->Bytes.Tokens -= bytes;
+    }
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileRateLimiter::Reset()
+{
+  this->Internals->Lock->Lock();
+  std::map<std::string, HostBuckets>::iterator iter =
+    this->Internals->Hosts.begin();
+  for (; iter != this->Internals->Hosts.end(); iter++)
+    {
+    iter->second.Requests = Bucket();
+    iter->second.Bytes = Bucket();
+    }
+  this->Internals->Bytes = Bucket();
+  this->Internals->Lock->Unlock();
+}
@@ -0,0 +1,120 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileRateLimiter.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileRateLimiter - bandwidth throttling for tile requests
+// .SECTION Description
+// Token buckets that limit the rate of tile requests, so that tile
+// servers' usage policies are respected and metered links aren't
+// saturated. Each host has a bucket for requests per second and one
+// for bytes per second, and one more bucket limits the bytes per second
+// over all hosts. Buckets hold up to BurstDuration seconds of tokens.
+//
+// The size of a tile isn't known before it is downloaded, so
+// RecordBytes() debits the byte buckets afterwards; requests wait
+// while a bucket is in debt.
+//
+// Requests are queued by priority: requests for visible tiles are
+// served before prefetch requests to the same host, and before any
+// prefetch request when MaxBytesPerSecond is set.
+//
+// Rates of zero mean no limit. All methods are thread safe.
+
+#ifndef __vtkMapTileRateLimiter_h
+#define __vtkMapTileRateLimiter_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+#include <string>
+
+class vtkMapTileClock;
+
+class VTKMAP_EXPORT vtkMapTileRateLimiter : public vtkObject
+{
+public:
+  // Description:
+  // Request priorities, highest first
+  enum Priority
+    {
+    PriorityVisible = 0,  // tiles in view
+    PriorityPrefetch,     // tiles that may be needed later
+    NumberOfPriorities
+    };
+
+  static vtkMapTileRateLimiter *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileRateLimiter, vtkObject)
+
+  // Description:
+  // Get/Set the maximum number of requests per second to each host.
+  // Default is 10.
+  vtkSetMacro(RequestsPerSecondPerHost, double)
+  vtkGetMacro(RequestsPerSecondPerHost, double)
+
+  // Description:
+  // Get/Set the maximum number of bytes per second from each host.
+  // Default is 0 (no limit).
+  vtkSetMacro(BytesPerSecondPerHost, double)
+  vtkGetMacro(BytesPerSecondPerHost, double)
+
+  // Description:
+  // Get/Set the maximum number of bytes per second over all hosts.
+  // Default is 0 (no limit).
+  vtkSetMacro(MaxBytesPerSecond, double)
+  vtkGetMacro(MaxBytesPerSecond, double)
+
+  // Description:
+  // Get/Set the number of seconds of tokens a bucket can save up,
+  // which sets the size of bursts after idle periods. Default is 1.
+  vtkSetMacro(BurstDuration, double)
+  vtkGetMacro(BurstDuration, double)
+
+  // Description:
+  // Get/Set the clock telling the time, and waiting for tokens. The
+  // default one uses the system time.
+  vtkGetObjectMacro(Clock, vtkMapTileClock)
+  void SetClock(vtkMapTileClock *clock);
+
+  // Description:
+  // Wait until a request to host is allowed, and take a request token.
+  // Priority is a Priority value.
+  void Acquire(const std::string& host, int priority = PriorityVisible);
+
+  // Description:
+  // Debit the bytes received from host
+  void RecordBytes(const std::string& host, double bytes);
+
+  // Description:
+  // Reset all buckets to full
+  void Reset();
+
+protected:
+  vtkMapTileRateLimiter();
+  ~vtkMapTileRateLimiter();
+
+  double RequestsPerSecondPerHost;
+  double BytesPerSecondPerHost;
+  double MaxBytesPerSecond;
+  double BurstDuration;
+  vtkMapTileClock *Clock;
+
+  class vtkMapTileRateLimiterInternals;
+  vtkMapTileRateLimiterInternals *Internals;
+
+private:
+  vtkMapTileRateLimiter(const vtkMapTileRateLimiter&);  // Not implemented
+  vtkMapTileRateLimiter& operator=(const vtkMapTileRateLimiter&); // Not implemented
+};
+
+#endif // __vtkMapTileRateLimiter_h
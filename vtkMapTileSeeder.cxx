@@ -0,0 +1,569 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSeeder.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileSeeder.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileSource.h"
+#include "vtkMercator.h"
+
+#include <vtkAtomicInt.h>
+#include <vtkCommand.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkTimerLog.h>
+#include <vtk_sqlite.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <algorithm>
+#include <cstdio>  // for remove()
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkMapTileSeeder)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Latitude range covered by web mercator tiles
+const double MaxLatitude = 85.0511287798;
+
+// Pack tile indices into one key (zoom < 64, x and y < 2^29)
+vtkTypeInt64 TileKey(int zoom, int x, int y)
+{
+  return (static_cast<vtkTypeInt64>(zoom) << 58) |
+    (static_cast<vtkTypeInt64>(x) << 29) | static_cast<vtkTypeInt64>(y);
+}
+
+VTK_THREAD_RETURN_TYPE StaticSeedThreadExecute(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkMapTileSeeder *self = static_cast<vtkMapTileSeeder*>(info->UserData);
+  self->SeedThreadExecute();
+  return VTK_THREAD_RETURN_VALUE;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileSeeder::vtkMapTileSeederInternals
+{
+public:
+  // Tiles [X0, X1] x [Y0, Y1] at Zoom, numbered from Offset
+  struct TileRange
+  {
+    int Zoom;
+    int X0, X1, Y0, Y1;
+    vtkTypeInt64 Offset;
+  };
+  std::vector<TileRange> Ranges;
+  vtkTypeInt64 NumberOfTiles;
+
+  vtkAtomicInt<vtkTypeInt64> NextTile;
+  vtkAtomicInt<vtkTypeInt64> Downloaded;
+  vtkAtomicInt<vtkTypeInt64> Skipped;
+  vtkAtomicInt<vtkTypeInt64> Missing;
+  vtkAtomicInt<vtkTypeInt64> Failed;
+  vtkAtomicInt<vtkTypeInt32> ActiveThreads;
+  vtkAtomicInt<vtkTypeInt32> Aborted;
+
+  vtkMutexLock *RateLock;
+  double NextRequestTime;
+
+  // MBTiles output
+  vtk_sqlite3 *Package;
+  vtk_sqlite3_stmt *InsertStatement;
+  std::set<vtkTypeInt64> PackagedTiles;
+  vtkMutexLock *PackageLock;
+
+  bool OpenPackage(const char *filename, const char *name,
+                   std::string& errorMessage);
+  void ClosePackage();
+  bool IsPackaged(int zoom, int x, int y);
+  bool AddToPackage(int zoom, int x, int y, const std::string& imageFile,
+                    std::string& errorMessage);
+};
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::vtkMapTileSeederInternals::
+OpenPackage(const char *filename, const char *name, std::string& errorMessage)
+{
+  // Schema of https://github.com/mapbox/mbtiles-spec, with a unique index
+  // so that tiles can be replaced
+  std::string sql =
+    "CREATE TABLE IF NOT EXISTS metadata (name text, value text);"
+    "CREATE TABLE IF NOT EXISTS tiles (zoom_level integer,"
+    " tile_column integer, tile_row integer, tile_data blob);"
+    "CREATE UNIQUE INDEX IF NOT EXISTS tile_index"
+    " ON tiles (zoom_level, tile_column, tile_row);"
+    "INSERT INTO metadata SELECT 'format', 'png'"
+    " WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE name='format');";
+  std::string quotedName(name);
+  std::string::size_type pos = quotedName.find('\'');
+  while (pos != std::string::npos)
+    {
+    quotedName.insert(pos, 1, '\'');
+    pos = quotedName.find('\'', pos + 2);
+    }
+  sql += "INSERT INTO metadata SELECT 'name', '" + quotedName + "'"
+    " WHERE NOT EXISTS (SELECT 1 FROM metadata WHERE name='name');";
+
+  vtk_sqlite3_stmt *select = NULL;
+  bool ok =
+    vtk_sqlite3_open_v2(filename, &this->Package,
+                        VTK_SQLITE_OPEN_READWRITE | VTK_SQLITE_OPEN_CREATE,
+                        NULL) == VTK_SQLITE_OK &&
+    vtk_sqlite3_exec(this->Package, sql.c_str(), NULL, NULL, NULL) ==
+    VTK_SQLITE_OK &&
+    vtk_sqlite3_prepare_v2(this->Package,
+                           "SELECT zoom_level, tile_column, tile_row"
+                           " FROM tiles", -1, &select, NULL) ==
+    VTK_SQLITE_OK &&
+    vtk_sqlite3_prepare_v2(this->Package,
+                           "INSERT OR REPLACE INTO tiles"
+                           " VALUES (?1, ?2, ?3, ?4)", -1,
+                           &this->InsertStatement, NULL) == VTK_SQLITE_OK;
+
+  // Remember the tiles already packaged, to resume seeding.
+  // MBTiles rows count up from the bottom.
+  this->PackagedTiles.clear();
+  while (ok && vtk_sqlite3_step(select) == VTK_SQLITE_ROW)
+    {
+    int zoom = vtk_sqlite3_column_int(select, 0);
+    int x = vtk_sqlite3_column_int(select, 1);
+    int row = vtk_sqlite3_column_int(select, 2);
+    this->PackagedTiles.insert(TileKey(zoom, x, (1 << zoom) - 1 - row));
+    }
+  if (select)
+    {
+    vtk_sqlite3_finalize(select);
+    }
+
+  if (!ok)
+    {
+    errorMessage = std::string("Cannot write MBTiles file ") + filename +
+      ": " + (this->Package ?
+              vtk_sqlite3_errmsg(this->Package) : "out of memory");
+    this->ClosePackage();
+    }
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::vtkMapTileSeederInternals::ClosePackage()
+{
+  if (this->InsertStatement)
+    {
+    vtk_sqlite3_finalize(this->InsertStatement);
+    this->InsertStatement = NULL;
+    }
+  if (this->Package)
+    {
+    vtk_sqlite3_close(this->Package);
+    this->Package = NULL;
+    }
+  this->PackagedTiles.clear();
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::vtkMapTileSeederInternals::
+IsPackaged(int zoom, int x, int y)
+{
+  this->PackageLock->Lock();
+  bool result = this->PackagedTiles.count(TileKey(zoom, x, y)) > 0;
+  this->PackageLock->Unlock();
+  return result;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::vtkMapTileSeederInternals::
+AddToPackage(int zoom, int x, int y, const std::string& imageFile,
+             std::string& errorMessage)
+{
+  std::ifstream file(imageFile.c_str(), std::ios::in | std::ios::binary);
+  std::vector<char> data((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+  if (data.empty())
+    {
+    errorMessage = "Cannot read " + imageFile;
+    return false;
+    }
+
+  this->PackageLock->Lock();
+  vtk_sqlite3_stmt *insert = this->InsertStatement;
+  vtk_sqlite3_bind_int(insert, 1, zoom);
+  vtk_sqlite3_bind_int(insert, 2, x);
+  vtk_sqlite3_bind_int(insert, 3, (1 << zoom) - 1 - y);
+  vtk_sqlite3_bind_blob(insert, 4, &data[0], static_cast<int>(data.size()),
+                        VTK_SQLITE_STATIC);
+  bool ok = vtk_sqlite3_step(insert) == VTK_SQLITE_DONE;
+  vtk_sqlite3_reset(insert);
+  if (ok)
+    {
+    this->PackagedTiles.insert(TileKey(zoom, x, y));
+    }
+  else
+    {
+    errorMessage = vtk_sqlite3_errmsg(this->Package);
+    }
+  this->PackageLock->Unlock();
+  return ok;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSeeder::vtkMapTileSeeder()
+{
+  this->TileSource = vtkMapTileSource::New();
+  this->Bounds[0] = this->Bounds[1] = this->Bounds[2] = this->Bounds[3] = 0.0;
+  this->MinZoom = 0;
+  this->MaxZoom = 10;
+  this->CacheDirectory = NULL;
+  this->PackageFileName = NULL;
+  this->NumberOfThreads = 6;
+  this->MaxRequestsPerSecond = 2.0;
+  this->MaxAttempts = 3;
+
+  this->Internals = new vtkMapTileSeederInternals;
+  this->Internals->NumberOfTiles = 0;
+  this->Internals->RateLock = vtkMutexLock::New();
+  this->Internals->NextRequestTime = 0.0;
+  this->Internals->Package = NULL;
+  this->Internals->InsertStatement = NULL;
+  this->Internals->PackageLock = vtkMutexLock::New();
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSeeder::~vtkMapTileSeeder()
+{
+  this->TileSource->Delete();
+  this->SetCacheDirectory(NULL);
+  this->SetPackageFileName(NULL);
+  this->Internals->ClosePackage();
+  this->Internals->RateLock->Delete();
+  this->Internals->PackageLock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Bounds: " << this->Bounds[0] << ", " << this->Bounds[1]
+     << ", " << this->Bounds[2] << ", " << this->Bounds[3] << "\n"
+     << indent << "Zoom: " << this->MinZoom << " to " << this->MaxZoom << "\n"
+     << indent << "CacheDirectory: "
+     << (this->CacheDirectory ? this->CacheDirectory : "(none)") << "\n"
+     << indent << "PackageFileName: "
+     << (this->PackageFileName ? this->PackageFileName : "(none)") << "\n"
+     << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n"
+     << indent << "MaxRequestsPerSecond: " << this->MaxRequestsPerSecond
+     << "\n"
+     << indent << "MaxAttempts: " << this->MaxAttempts << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::SetTileSource(vtkMapTileSource *source)
+{
+  if (!source || source == this->TileSource)
+    {
+    return;
+    }
+
+  source->Register(this);
+  this->TileSource->UnRegister(this);
+  this->TileSource = source;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::ComputeTileRanges()
+{
+  double lat0 = std::min(this->Bounds[0], this->Bounds[2]);
+  double lat1 = std::max(this->Bounds[0], this->Bounds[2]);
+  double lon0 = std::min(this->Bounds[1], this->Bounds[3]);
+  double lon1 = std::max(this->Bounds[1], this->Bounds[3]);
+  lat0 = std::max(lat0, -MaxLatitude);
+  lat1 = std::min(lat1, MaxLatitude);
+  lon0 = std::max(lon0, -180.0);
+  lon1 = std::min(lon1, 180.0);
+
+  this->Internals->Ranges.clear();
+  this->Internals->NumberOfTiles = 0;
+  // The source has no tiles past its MaxZoom
+  int maxZoom = std::min(this->MaxZoom, this->TileSource->GetMaxZoom());
+  for (int zoom = this->MinZoom; zoom <= maxZoom; ++zoom)
+    {
+    // Tile rows count down from the north
+    int last = (1 << zoom) - 1;
+    vtkMapTileSeederInternals::TileRange range;
+    range.Zoom = zoom;
+    range.X0 = std::max(0, vtkMercator::long2tilex(lon0, zoom));
+    range.X1 = std::min(last, vtkMercator::long2tilex(lon1, zoom));
+    range.Y0 = std::max(0, vtkMercator::lat2tiley(lat1, zoom));
+    range.Y1 = std::min(last, vtkMercator::lat2tiley(lat0, zoom));
+    range.Offset = this->Internals->NumberOfTiles;
+    this->Internals->Ranges.push_back(range);
+    this->Internals->NumberOfTiles +=
+      static_cast<vtkTypeInt64>(range.X1 - range.X0 + 1) *
+      (range.Y1 - range.Y0 + 1);
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfTiles()
+{
+  this->ComputeTileRanges();
+  return this->Internals->NumberOfTiles;
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSeeder::Seed()
+{
+  if (!this->CacheDirectory && !this->PackageFileName)
+    {
+    vtkErrorMacro("No CacheDirectory or PackageFileName specified");
+    return false;
+    }
+  if (this->TileSource->ProvidesImages() ||
+      !this->TileSource->GetUrlTemplate())
+    {
+    vtkErrorMacro("Tile source " << this->TileSource->GetName()
+                  << " has nothing to download");
+    return false;
+    }
+
+  this->ComputeTileRanges();
+  this->Internals->NextTile = 0;
+  this->Internals->Downloaded = 0;
+  this->Internals->Skipped = 0;
+  this->Internals->Missing = 0;
+  this->Internals->Failed = 0;
+  this->Internals->Aborted = 0;
+  this->Internals->NextRequestTime = 0.0;
+
+  if (this->PackageFileName)
+    {
+    std::string errorMessage;
+    if (!this->Internals->OpenPackage(this->PackageFileName,
+                                      this->TileSource->GetName(),
+                                      errorMessage))
+      {
+      vtkErrorMacro(<< errorMessage);
+      return false;
+      }
+    }
+  else if (!vtksys::SystemTools::MakeDirectory(this->CacheDirectory))
+    {
+    vtkErrorMacro("Cannot create directory " << this->CacheDirectory);
+    return false;
+    }
+
+  // Run the downloads on spawned threads, and report progress
+  // from this one, so that observers are called on the caller's thread
+  vtkMultiThreader *threader = vtkMultiThreader::New();
+  std::vector<int> threadIds;
+  this->Internals->ActiveThreads = this->NumberOfThreads;
+  for (int i = 0; i < this->NumberOfThreads; ++i)
+    {
+    threadIds.push_back(threader->SpawnThread(StaticSeedThreadExecute, this));
+    }
+
+  vtkTypeInt64 total = this->Internals->NumberOfTiles;
+  double progress = 0.0;
+  this->InvokeEvent(vtkCommand::StartEvent);
+  while (this->Internals->ActiveThreads > 0)
+    {
+    vtksys::SystemTools::Delay(250);
+    vtkTypeInt64 done = this->Internals->Downloaded +
+      this->Internals->Skipped + this->Internals->Missing +
+      this->Internals->Failed;
+    progress = total > 0 ? static_cast<double>(done) / total : 1.0;
+    this->InvokeEvent(vtkCommand::ProgressEvent, &progress);
+    }
+
+  for (size_t i = 0; i < threadIds.size(); ++i)
+    {
+    threader->TerminateThread(threadIds[i]);
+    }
+  threader->Delete();
+  this->Internals->ClosePackage();
+  this->InvokeEvent(vtkCommand::EndEvent);
+
+  return !this->Internals->Aborted;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::Abort()
+{
+  this->Internals->Aborted = 1;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfDownloadedTiles()
+{
+  return this->Internals->Downloaded;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfSkippedTiles()
+{
+  return this->Internals->Skipped;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfMissingTiles()
+{
+  return this->Internals->Missing;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeInt64 vtkMapTileSeeder::GetNumberOfFailedTiles()
+{
+  return this->Internals->Failed;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::SeedThreadExecute()
+{
+  // Take the next tile, in order of zoom level, until all are done
+  std::vector<vtkMapTileSeederInternals::TileRange>& ranges =
+    this->Internals->Ranges;
+  size_t rangeIndex = 0;
+  while (!this->Internals->Aborted)
+    {
+    vtkTypeInt64 index = this->Internals->NextTile++;
+    if (index >= this->Internals->NumberOfTiles)
+      {
+      break;
+      }
+
+    while (rangeIndex + 1 < ranges.size() &&
+           ranges[rangeIndex + 1].Offset <= index)
+      {
+      rangeIndex++;
+      }
+    vtkMapTileSeederInternals::TileRange& range = ranges[rangeIndex];
+    vtkTypeInt64 width = range.X1 - range.X0 + 1;
+    vtkTypeInt64 local = index - range.Offset;
+    int x = range.X0 + static_cast<int>(local % width);
+    int y = range.Y0 + static_cast<int>(local / width);
+    this->SeedTile(range.Zoom, x, y);
+    }
+
+  this->Internals->ActiveThreads--;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::SeedTile(int zoom, int x, int y)
+{
+  // Download to the cache, or to a temporary file for the package
+  std::string filename;
+  bool stored;
+  if (this->PackageFileName)
+    {
+    std::stringstream oss;
+    oss << this->PackageFileName << "." << zoom << "-" << x << "-" << y
+        << ".png";
+    filename = oss.str();
+    stored = this->Internals->IsPackaged(zoom, x, y);
+    }
+  else
+    {
+    filename = this->TileSource->GetCacheTileFile(this->CacheDirectory,
+                                                   zoom, x, y);
+    stored = vtkMapTile::IsImageFileValid(filename.c_str(),
+                                          this->TileSource->GetCodec());
+    }
+  if (stored)
+    {
+    this->Internals->Skipped++;
+    return;
+    }
+
+  std::string errorMessage;
+  int status = vtkMapTile::DownloadFailed;
+  for (int attempt = 0; attempt < this->MaxAttempts; ++attempt)
+    {
+    if (attempt > 0)
+      {
+      // Back off: 1, 2, 4... seconds
+      vtksys::SystemTools::Delay(1000 << std::min(attempt - 1, 6));
+      }
+    if (this->Internals->Aborted)
+      {
+      return;
+      }
+
+    this->WaitForRequestSlot();
+    std::string url = this->TileSource->GetTileUrl(
+      zoom, x, y, this->TileSource->GetNextSubdomainIndex());
+    status = this->TileSource->DownloadTile(
+      url, filename, errorMessage, vtkMapTileRateLimiter::PriorityPrefetch);
+    if (status != vtkMapTile::DownloadFailed)
+      {
+      break;
+      }
+    }
+
+  if (status == vtkMapTile::DownloadOK && this->PackageFileName)
+    {
+    if (!this->Internals->AddToPackage(zoom, x, y, filename, errorMessage))
+      {
+      status = vtkMapTile::DownloadFailed;
+      }
+    remove(filename.c_str());
+    }
+
+  switch (status)
+    {
+    case vtkMapTile::DownloadOK:
+      this->Internals->Downloaded++;
+      break;
+
+    case vtkMapTile::DownloadMissing:
+      this->Internals->Missing++;
+      break;
+
+    default:
+      vtkWarningMacro(<< errorMessage);
+      this->Internals->Failed++;
+      break;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSeeder::WaitForRequestSlot()
+{
+  if (this->MaxRequestsPerSecond <= 0.0)
+    {
+    return;
+    }
+
+  // Reserve the next slot, spaced 1/MaxRequestsPerSecond apart
+  this->Internals->RateLock->Lock();
+  double now = vtkTimerLog::GetUniversalTime();
+  double slot = std::max(now, this->Internals->NextRequestTime);
+  this->Internals->NextRequestTime = slot + 1.0 / this->MaxRequestsPerSecond;
+  this->Internals->RateLock->Unlock();
+
+  if (slot > now)
+    {
+    vtksys::SystemTools::Delay(
+      static_cast<unsigned int>(1000.0 * (slot - now)));
+    }
+}
@@ -0,0 +1,158 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSeeder.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileSeeder - download map tiles ahead of time
+// .SECTION Description
+// Downloads all tiles covering a lat-lon bounding box over a range of
+// zoom levels, for use without network access. Tiles are stored either
+// in a tile cache directory, in the same layout vtkOsmLayer uses, or in
+// an MBTiles package that can be read with vtkMBTilesTileSource.
+//
+// Tiles already in the cache directory or package are skipped, so an
+// interrupted run is resumed by running it again. Seeding a local
+// (file://) tile source into a package packs a tile directory.
+//
+// Downloads run on several threads, limited to MaxRequestsPerSecond
+// overall and by the tile source's host and rate limits, at prefetch
+// priority so that map layers sharing the source go first. Seed()
+// invokes vtkCommand::ProgressEvent periodically, with the fraction of
+// tiles done as call data (a double*).
+
+#ifndef __vtkMapTileSeeder_h
+#define __vtkMapTileSeeder_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+class vtkMapTileSource;
+
+class VTKMAP_EXPORT vtkMapTileSeeder : public vtkObject
+{
+public:
+  static vtkMapTileSeeder *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileSeeder, vtkObject)
+
+  // Description:
+  // Get/Set the source of the tile images, OpenStreetMap by default
+  vtkGetObjectMacro(TileSource, vtkMapTileSource)
+  void SetTileSource(vtkMapTileSource *source);
+
+  // Description:
+  // Get/Set the area to seed, as [latitude1, longitude1,
+  // latitude2, longitude2] (same as vtkMap::SetVisibleBounds())
+  vtkSetVector4Macro(Bounds, double)
+  vtkGetVector4Macro(Bounds, double)
+
+  // Description:
+  // Get/Set the range of zoom levels to seed. Note that vtkOsmLayer
+  // picks the tile level from the screen resolution, usually one or two
+  // levels above the vtkMap zoom for 256 pixel tiles. Levels past the
+  // MaxZoom of the tile source are not seeded. Default is 0 to 10.
+  vtkSetClampMacro(MinZoom, int, 0, 30)
+  vtkGetMacro(MinZoom, int)
+  vtkSetClampMacro(MaxZoom, int, 0, 30)
+  vtkGetMacro(MaxZoom, int)
+
+  // Description:
+  // Get/Set the tile cache directory to fill, typically
+  // <vtkMap storage directory>/<tile source name>
+  vtkSetStringMacro(CacheDirectory)
+  vtkGetStringMacro(CacheDirectory)
+
+  // Description:
+  // Get/Set the MBTiles package to fill instead of the cache directory.
+  // The package is created if it doesn't exist.
+  vtkSetStringMacro(PackageFileName)
+  vtkGetStringMacro(PackageFileName)
+
+  // Description:
+  // Get/Set the number of download threads. Default is 6.
+  vtkSetClampMacro(NumberOfThreads, int, 1, 64)
+  vtkGetMacro(NumberOfThreads, int)
+
+  // Description:
+  // Get/Set the maximum number of requests per second, over all threads.
+  // Zero means no limit. Default is 2; check the tile server's usage
+  // policy before raising it.
+  vtkSetMacro(MaxRequestsPerSecond, double)
+  vtkGetMacro(MaxRequestsPerSecond, double)
+
+  // Description:
+  // Get/Set the number of download attempts per tile. Tiles reported
+  // missing by the server are not retried. Default is 3.
+  vtkSetClampMacro(MaxAttempts, int, 1, 100)
+  vtkGetMacro(MaxAttempts, int)
+
+  // Description:
+  // Returns the number of tiles covering Bounds over the zoom range
+  vtkTypeInt64 GetNumberOfTiles();
+
+  // Description:
+  // Download the tiles. Blocks until all tiles are processed or Abort()
+  // is called. Returns false if seeding could not start or was aborted.
+  bool Seed();
+
+  // Description:
+  // Stop seeding as soon as the current downloads complete.
+  // May be called from a progress observer or another thread.
+  void Abort();
+
+  // Description:
+  // Counts of tiles processed by Seed(): downloaded, skipped because
+  // already stored, missing on the server, and failed
+  vtkTypeInt64 GetNumberOfDownloadedTiles();
+  vtkTypeInt64 GetNumberOfSkippedTiles();
+  vtkTypeInt64 GetNumberOfMissingTiles();
+  vtkTypeInt64 GetNumberOfFailedTiles();
+
+  // Description:
+  // Thread entry point; not intended for general use
+  void SeedThreadExecute();
+
+protected:
+  vtkMapTileSeeder();
+  ~vtkMapTileSeeder();
+
+  // Description:
+  // Compute the tile index ranges for each zoom level
+  void ComputeTileRanges();
+
+  // Description:
+  // Process tile (zoom, x, y): skip, download or record failure
+  void SeedTile(int zoom, int x, int y);
+
+  // Description:
+  // Wait until a request is allowed by MaxRequestsPerSecond
+  void WaitForRequestSlot();
+
+  vtkMapTileSource *TileSource;
+  double Bounds[4];
+  int MinZoom;
+  int MaxZoom;
+  char *CacheDirectory;
+  char *PackageFileName;
+  int NumberOfThreads;
+  double MaxRequestsPerSecond;
+  int MaxAttempts;
+
+  class vtkMapTileSeederInternals;
+  vtkMapTileSeederInternals *Internals;
+
+private:
+  vtkMapTileSeeder(const vtkMapTileSeeder&);  // Not implemented
+  vtkMapTileSeeder& operator=(const vtkMapTileSeeder&); // Not implemented
+};
+
+#endif // __vtkMapTileSeeder_h
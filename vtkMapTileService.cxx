@@ -0,0 +1,539 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileService.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileService.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileCodec.h"
+#include "vtkMapTileSpecInternal.h"
+#include "vtkMultiThreadedOsmLayer.h"
+
+#include <vtkConditionVariable.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMultiThreader.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <map>
+#include <set>
+
+vtkStandardNewMacro(vtkMapTileService)
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Cached image, with its position in the least-recently-used list
+struct ImageEntry
+{
+  vtkImageData *Image;
+  std::list<std::string>::iterator Position;
+};
+
+// Tile spec requested by a layer. Key identifies the tile image,
+// so that requests from several layers download it once.
+struct Request
+{
+  vtkMultiThreadedOsmLayer *Layer;
+  vtkMapTileSpecInternal Spec;
+  std::string Key;
+
+  Request() : Layer(NULL) {}
+};
+
+// Remove the requests from layer in requests
+template <typename Container>
+int RemoveRequests(Container& requests, vtkOsmLayer *layer)
+{
+  Container kept;
+  typename Container::iterator iter = requests.begin();
+  for (; iter != requests.end(); iter++)
+    {
+    if (iter->Layer != layer)
+      {
+      kept.push_back(*iter);
+      }
+    }
+  int count = static_cast<int>(requests.size() - kept.size());
+  requests.swap(kept);
+  return count;
+}
+}
+
+//----------------------------------------------------------------------------
+class vtkMapTileService::vtkMapTileServiceInternals
+{
+public:
+  // Image cache, most recently used first in ImageOrder
+  std::map<std::string, ImageEntry> Images;
+  std::list<std::string> ImageOrder;
+  vtkMutexLock *ImageLock;
+
+  // Requests to look up in the image caches, then to download
+  std::deque<Request> Lookups;
+  std::deque<Request> Downloads;
+
+  // Keys being looked up or downloaded, and requests waiting for them
+  std::set<std::string> ActiveKeys;
+  std::map<std::string, std::vector<Request> > WaitingRequests;
+
+  // Per layer counts of unresolved and in progress requests
+  std::map<vtkOsmLayer*, int> PendingRequests;
+  std::map<vtkOsmLayer*, int> ActiveRequests;
+  std::set<vtkOsmLayer*> CancelingLayers;
+
+  vtkMutexLock *RequestLock;
+  vtkConditionVariable *RequestCondition;  // new requests or stop
+  vtkConditionVariable *IdleCondition;  // request completed
+
+  vtkMultiThreader *Threader;
+  std::vector<int> ThreadIds;
+  bool ThreadingEnabled;
+};
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE StaticRequestThreadExecute(void *arg)
+{
+  vtkMultiThreader::ThreadInfo *info =
+    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
+  vtkMapTileService *self = static_cast<vtkMapTileService*>(info->UserData);
+  self->RequestThreadExecute();
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileService::vtkMapTileService()
+{
+  this->NumberOfThreads = 6;
+  this->MaxNumberOfImages = 256;
+
+  this->Internals = new vtkMapTileServiceInternals;
+  this->Internals->ImageLock = vtkMutexLock::New();
+  this->Internals->RequestLock = vtkMutexLock::New();
+  this->Internals->RequestCondition = vtkConditionVariable::New();
+  this->Internals->IdleCondition = vtkConditionVariable::New();
+  this->Internals->Threader = vtkMultiThreader::New();
+  this->Internals->ThreadingEnabled = true;
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileService::~vtkMapTileService()
+{
+  // Layers cancel their requests before releasing the service,
+  // so the threads are idle
+  this->Internals->RequestLock->Lock();
+  this->Internals->ThreadingEnabled = false;
+  this->Internals->RequestCondition->Broadcast();
+  this->Internals->RequestLock->Unlock();
+
+  std::vector<int>::iterator idIter = this->Internals->ThreadIds.begin();
+  for (; idIter != this->Internals->ThreadIds.end(); idIter++)
+    {
+    this->Internals->Threader->TerminateThread(*idIter);
+    }
+
+  this->ClearImages();
+
+  this->Internals->Threader->Delete();
+  this->Internals->IdleCondition->Delete();
+  this->Internals->RequestCondition->Delete();
+  this->Internals->RequestLock->Delete();
+  this->Internals->ImageLock->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << "\n"
+     << indent << "MaxNumberOfImages: " << this->MaxNumberOfImages << "\n"
+     << indent << "NumberOfImages: " << this->GetNumberOfImages()
+     << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::SetMaxNumberOfImages(int count)
+{
+  count = std::max(0, count);
+  if (count == this->MaxNumberOfImages)
+    {
+    return;
+    }
+
+  this->Internals->ImageLock->Lock();
+  this->MaxNumberOfImages = count;
+  this->TrimImages();
+  this->Internals->ImageLock->Unlock();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileService::GetImage(const std::string& key)
+{
+  vtkImageData *image = NULL;
+  this->Internals->ImageLock->Lock();
+  std::map<std::string, ImageEntry>::iterator iter =
+    this->Internals->Images.find(key);
+  if (iter != this->Internals->Images.end())
+    {
+    // Move to the front of the least-recently-used list
+    this->Internals->ImageOrder.splice(this->Internals->ImageOrder.begin(),
+                                       this->Internals->ImageOrder,
+                                       iter->second.Position);
+    image = iter->second.Image;
+    image->Register(NULL);
+    }
+  this->Internals->ImageLock->Unlock();
+  return image;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileService::AddImage(const std::string& key,
+                                          vtkImageData *image)
+{
+  if (!image)
+    {
+    return NULL;
+    }
+
+  this->Internals->ImageLock->Lock();
+  std::map<std::string, ImageEntry>::iterator iter =
+    this->Internals->Images.find(key);
+  if (iter != this->Internals->Images.end())
+    {
+    image = iter->second.Image;
+    }
+  else
+    {
+    this->Internals->ImageOrder.push_front(key);
+    ImageEntry& entry = this->Internals->Images[key];
+    entry.Image = image;
+    entry.Position = this->Internals->ImageOrder.begin();
+    image->Register(this);
+    this->TrimImages();
+    }
+  image->Register(NULL);
+  this->Internals->ImageLock->Unlock();
+  return image;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileService::ExpandImage(const std::string& key,
+                                             vtkImageData *image)
+{
+  if (!image)
+    {
+    return NULL;
+    }
+  vtkImageData *expanded = vtkMapTileCodec::ExpandColors(image);
+  if (!expanded)
+    {
+    image->Register(NULL);
+    return image;
+    }
+
+  this->Internals->ImageLock->Lock();
+  std::map<std::string, ImageEntry>::iterator iter =
+    this->Internals->Images.find(key);
+  if (iter != this->Internals->Images.end())
+    {
+    vtkImageData *cached = iter->second.Image;
+    vtkDataArray *scalars = cached->GetPointData()->GetScalars();
+    if (cached == image)
+      {
+      expanded->Register(this);
+      iter->second.Image = expanded;
+      image->UnRegister(this);
+      }
+    else if (!scalars || !scalars->GetLookupTable())
+      {
+      // Another thread expanded it first
+      expanded->Delete();
+      expanded = cached;
+      expanded->Register(NULL);
+      }
+    }
+  this->Internals->ImageLock->Unlock();
+  return expanded;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileService::LoadImageFile(const std::string& filename,
+                                               vtkMapTileCodec *codec,
+                                               bool indexColors)
+{
+  vtkImageData *image = this->GetImage(filename);
+  if (image)
+    {
+    return image;
+    }
+
+  // Decode without holding the lock. Threads loading the same file
+  // at the same time end up sharing the image added first.
+  vtkImageData *decoded = vtkMapTile::ReadImageFile(filename, codec);
+  if (!decoded)
+    {
+    return NULL;
+    }
+  if (indexColors)
+    {
+    vtkImageData *indexed = vtkMapTileCodec::IndexColors(decoded);
+    if (indexed)
+      {
+      decoded->Delete();
+      decoded = indexed;
+      }
+    }
+
+  image = this->AddImage(filename, decoded);
+  decoded->Delete();
+  return image;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::ClearImages()
+{
+  this->Internals->ImageLock->Lock();
+  std::map<std::string, ImageEntry>::iterator iter =
+    this->Internals->Images.begin();
+  for (; iter != this->Internals->Images.end(); iter++)
+    {
+    iter->second.Image->UnRegister(this);
+    }
+  this->Internals->Images.clear();
+  this->Internals->ImageOrder.clear();
+  this->Internals->ImageLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfImages()
+{
+  this->Internals->ImageLock->Lock();
+  int count = static_cast<int>(this->Internals->Images.size());
+  this->Internals->ImageLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::TrimImages()
+{
+  while (this->Internals->Images.size() >
+         static_cast<size_t>(this->MaxNumberOfImages))
+    {
+    std::map<std::string, ImageEntry>::iterator iter =
+      this->Internals->Images.find(this->Internals->ImageOrder.back());
+    iter->second.Image->UnRegister(this);
+    this->Internals->Images.erase(iter);
+    this->Internals->ImageOrder.pop_back();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::
+RequestTiles(vtkMultiThreadedOsmLayer *layer,
+             const std::vector<vtkMapTileSpecInternal>& specs)
+{
+  if (!layer || specs.empty())
+    {
+    return;
+    }
+
+  std::vector<Request> requests(specs.size());
+  for (size_t i = 0; i < specs.size(); ++i)
+    {
+    requests[i].Layer = layer;
+    requests[i].Spec = specs[i];
+    requests[i].Key = layer->GetTileKey(requests[i].Spec);
+    }
+
+  this->StartThreads();
+  this->Internals->RequestLock->Lock();
+  this->Internals->Lookups.insert(this->Internals->Lookups.begin(),
+                                  requests.begin(), requests.end());
+  this->Internals->PendingRequests[layer] += static_cast<int>(specs.size());
+  this->Internals->RequestCondition->Broadcast();
+  this->Internals->RequestLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileService::GetNumberOfPendingTiles(vtkOsmLayer *layer)
+{
+  this->Internals->RequestLock->Lock();
+  std::map<vtkOsmLayer*, int>::iterator iter =
+    this->Internals->PendingRequests.find(layer);
+  int count = iter != this->Internals->PendingRequests.end() ?
+    iter->second : 0;
+  this->Internals->RequestLock->Unlock();
+  return count;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::CancelRequests(vtkOsmLayer *layer)
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->RequestLock->Lock();
+  RemoveRequests(internals->Lookups, layer);
+  RemoveRequests(internals->Downloads, layer);
+  std::map<std::string, std::vector<Request> >::iterator waiting =
+    internals->WaitingRequests.begin();
+  while (waiting != internals->WaitingRequests.end())
+    {
+    RemoveRequests(waiting->second, layer);
+    if (waiting->second.empty())
+      {
+      internals->WaitingRequests.erase(waiting++);
+      }
+    else
+      {
+      waiting++;
+      }
+    }
+
+  // Requests in progress are dropped when they complete
+  internals->CancelingLayers.insert(layer);
+  while (internals->ActiveRequests[layer] > 0)
+    {
+    internals->IdleCondition->Wait(internals->RequestLock);
+    }
+  internals->CancelingLayers.erase(layer);
+  internals->ActiveRequests.erase(layer);
+  internals->PendingRequests.erase(layer);
+  internals->RequestLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileService::StartThreads()
+{
+  this->Internals->RequestLock->Lock();
+  if (this->Internals->ThreadIds.empty())
+    {
+    for (int i = 0; i < this->NumberOfThreads; ++i)
+      {
+      this->Internals->ThreadIds.push_back(
+        this->Internals->Threader->SpawnThread(
+          StaticRequestThreadExecute, this));
+      }
+    }
+  this->Internals->RequestLock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+// Serves lookups before downloads, so that cached tiles appear while
+// other tiles are downloading
+void vtkMapTileService::RequestThreadExecute()
+{
+  vtkMapTileServiceInternals *internals = this->Internals;
+  internals->RequestLock->Lock();
+  while (internals->ThreadingEnabled)
+    {
+    Request request;
+    bool download = false;
+    if (!internals->Lookups.empty())
+      {
+      request = internals->Lookups.front();
+      internals->Lookups.pop_front();
+      }
+    else if (!internals->Downloads.empty())
+      {
+      request = internals->Downloads.front();
+      internals->Downloads.pop_front();
+      download = true;
+      }
+    else
+      {
+      internals->RequestCondition->Wait(internals->RequestLock);
+      continue;
+      }
+    if (internals->ActiveKeys.count(request.Key))
+      {
+      // Look the tile up again when the other request completes, so
+      // that it is decoded and downloaded once
+      internals->WaitingRequests[request.Key].push_back(request);
+      continue;
+      }
+    internals->ActiveKeys.insert(request.Key);
+    internals->ActiveRequests[request.Layer]++;
+    internals->RequestLock->Unlock();
+
+    bool resolved = true;
+    if (download)
+      {
+      request.Layer->FetchTile(request.Spec);
+      }
+    else
+      {
+      resolved = request.Layer->LookupTile(request.Spec);
+      }
+    if (resolved)
+      {
+      TileSpecList newTiles(1, request.Spec);
+      request.Layer->UpdateNewTiles(newTiles);
+      }
+
+    internals->RequestLock->Lock();
+
+    // Look up the other requests for the same key again, whether they
+    // wait for this request or, for downloads, are queued behind it
+    internals->ActiveKeys.erase(request.Key);
+    std::vector<Request> sameKey;
+    std::map<std::string, std::vector<Request> >::iterator waiting =
+      internals->WaitingRequests.find(request.Key);
+    if (waiting != internals->WaitingRequests.end())
+      {
+      sameKey.swap(waiting->second);
+      internals->WaitingRequests.erase(waiting);
+      }
+    if (download)
+      {
+      std::deque<Request>::iterator queued = internals->Downloads.begin();
+      while (queued != internals->Downloads.end())
+        {
+        if (queued->Key == request.Key)
+          {
+          sameKey.push_back(*queued);
+          queued = internals->Downloads.erase(queued);
+          }
+        else
+          {
+          queued++;
+          }
+        }
+      }
+    if (!sameKey.empty())
+      {
+      internals->Lookups.insert(internals->Lookups.begin(),
+                                sameKey.begin(), sameKey.end());
+      internals->RequestCondition->Broadcast();
+      }
+    if (!internals->CancelingLayers.count(request.Layer))
+      {
+      if (resolved)
+        {
+        internals->PendingRequests[request.Layer]--;
+        }
+      else
+        {
+        internals->Downloads.push_front(request);
+        }
+      }
+    internals->ActiveRequests[request.Layer]--;
+    internals->IdleCondition->Broadcast();
+    }
+  internals->RequestLock->Unlock();
+}
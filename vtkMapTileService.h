@@ -0,0 +1,151 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileService.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileService - tile images and requests shared by layers
+// .SECTION Description
+// Holds the state that map layers can share, so that several layers
+// (in the same or different vtkMap instances) showing the same tiles
+// don't decode and download them once each:
+//
+//  * a cache of decoded tile images, bounded by MaxNumberOfImages
+//    (least recently used images are dropped first)
+//  * the queue of tile requests from vtkMultiThreadedOsmLayer
+//    instances, and the pool of threads serving it. Requests for
+//    tiles found in a cache are served before downloads, the most
+//    recent requests first, and a tile requested by several layers is
+//    served by one thread at a time, so that it is decoded and
+//    downloaded once.
+//
+// Every vtkOsmLayer has a service; to share one, pass it to the other
+// layers with vtkOsmLayer::SetTileService(). The service is reference
+// counted, and its threads stop when the last layer releases it.
+// All methods are thread safe.
+
+#ifndef __vtkMapTileService_h
+#define __vtkMapTileService_h
+
+#include <vtkObject.h>
+#include "vtkmap_export.h"
+
+#include <string>
+#include <vector>
+
+class vtkImageData;
+class vtkMapTileCodec;
+class vtkMapTileSpecInternal;
+class vtkMultiThreadedOsmLayer;
+class vtkOsmLayer;
+
+class VTKMAP_EXPORT vtkMapTileService : public vtkObject
+{
+public:
+  static vtkMapTileService *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileService, vtkObject)
+
+  // Description:
+  // Get/Set the number of request threads. Only takes effect before
+  // the first request. Default is 6.
+  vtkSetClampMacro(NumberOfThreads, int, 1, 64)
+  vtkGetMacro(NumberOfThreads, int)
+
+  // Description:
+  // Get/Set the maximum number of decoded images kept in the cache,
+  // in addition to those used by tiles. Default is 256.
+  void SetMaxNumberOfImages(int count);
+  vtkGetMacro(MaxNumberOfImages, int)
+
+  // Description:
+  // Returns the cached image for key, or NULL. The caller must
+  // Delete() the returned image.
+  vtkImageData *GetImage(const std::string& key);
+
+  // Description:
+  // Add image to the cache under key. If another thread added an
+  // image for key first, that one is kept. Returns the cached image,
+  // which the caller must Delete().
+  vtkImageData *AddImage(const std::string& key, vtkImageData *image);
+
+  // Description:
+  // Returns image, cached under key, with its colors expanded if it is
+  // indexed (see vtkMapTileCodec::ExpandColors()), or image itself.
+  // The expanded image replaces the indexed one in the cache, so that
+  // tiles displaying it share it with the cache instead of holding a
+  // second copy. The caller must Delete() the returned image.
+  vtkImageData *ExpandImage(const std::string& key, vtkImageData *image);
+
+  // Description:
+  // Returns the decoded image file, read from the cache or decoded and
+  // added to it, or NULL if the file is not a valid image. The file
+  // name is the key. Files are decoded with codec, or the built-in
+  // formats if it is NULL. If indexColors is true, images with at most
+  // 256 colors are cached as indexed images, which is lossless (see
+  // vtkMapTileCodec::IndexColors()). The caller must Delete() the
+  // returned image.
+  vtkImageData *LoadImageFile(const std::string& filename,
+                              vtkMapTileCodec *codec = NULL,
+                              bool indexColors = false);
+
+  // Description:
+  // Remove all images from the cache
+  void ClearImages();
+
+  // Description:
+  // Returns the number of images in the cache
+  int GetNumberOfImages();
+
+  // Description:
+  // Queue tile specs for layer, ahead of earlier requests. Resolved
+  // tiles are passed back with vtkMultiThreadedOsmLayer::UpdateNewTiles().
+  void RequestTiles(vtkMultiThreadedOsmLayer *layer,
+                    const std::vector<vtkMapTileSpecInternal>& specs);
+
+  // Description:
+  // Returns the number of tiles requested by layer not resolved yet
+  int GetNumberOfPendingTiles(vtkOsmLayer *layer);
+
+  // Description:
+  // Drop the queued requests from layer and wait for the ones in
+  // progress to complete
+  void CancelRequests(vtkOsmLayer *layer);
+
+  // Description:
+  // Thread entry point; not intended for general use
+  void RequestThreadExecute();
+
+protected:
+  vtkMapTileService();
+  ~vtkMapTileService();
+
+  // Description:
+  // Drop least recently used images beyond MaxNumberOfImages.
+  // Called with the lock held.
+  void TrimImages();
+
+  // Description:
+  // Start the request threads, if not started yet
+  void StartThreads();
+
+  int NumberOfThreads;
+  int MaxNumberOfImages;
+
+  class vtkMapTileServiceInternals;
+  vtkMapTileServiceInternals *Internals;
+
+private:
+  vtkMapTileService(const vtkMapTileService&);  // Not implemented
+  vtkMapTileService& operator=(const vtkMapTileService&); // Not implemented
+};
+
+#endif // __vtkMapTileService_h
@@ -0,0 +1,310 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSource.cxx
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+
+#include "vtkMapTileSource.h"
+#include "vtkMapTile.h"
+#include "vtkMapTileCodec.h"
+#include "vtkMapTileFailureCache.h"
+
+#include <vtkConditionVariable.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+
+#include <vtksys/SystemTools.hxx>
+
+#include <map>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkMapTileSource)
+
+//----------------------------------------------------------------------------
+class vtkMapTileSource::vtkMapTileSourceInternals
+{
+public:
+  std::vector<std::string> Subdomains;
+  unsigned int NextSubdomain;  // rotation counter
+
+  std::map<std::string, int> ActiveRequests;  // per host
+  vtkMutexLock *Lock;
+  vtkConditionVariable *HostAvailable;
+};
+
+//----------------------------------------------------------------------------
+namespace
+{
+// Replace all occurrences of key in text
+void ReplaceAll(std::string& text, const std::string& key,
+                const std::string& value)
+{
+  std::string::size_type pos = text.find(key);
+  while (pos != std::string::npos)
+    {
+    text.replace(pos, key.size(), value);
+    pos = text.find(key, pos + value.size());
+    }
+}
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSource::vtkMapTileSource()
+{
+  this->Name = NULL;
+  this->UrlTemplate = NULL;
+  this->MaxZoom = 19;
+  this->TileSize = 256;
+  this->MaxRequestsPerHost = 2;
+  this->RateLimiter = vtkMapTileRateLimiter::New();
+  this->Codec = vtkMapTileCodec::New();
+
+  this->Internals = new vtkMapTileSourceInternals;
+  this->Internals->NextSubdomain = 0;
+  this->Internals->Lock = vtkMutexLock::New();
+  this->Internals->HostAvailable = vtkConditionVariable::New();
+
+  // Default to OpenStreetMap
+  this->SetName("osm");
+  this->SetUrlTemplate("http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png");
+  this->AddSubdomain("a");
+  this->AddSubdomain("b");
+  this->AddSubdomain("c");
+}
+
+//----------------------------------------------------------------------------
+vtkMapTileSource::~vtkMapTileSource()
+{
+  this->SetName(NULL);
+  this->SetUrlTemplate(NULL);
+  this->RateLimiter->Delete();
+  this->Codec->Delete();
+  this->Internals->Lock->Delete();
+  this->Internals->HostAvailable->Delete();
+  delete this->Internals;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Name: " << (this->Name ? this->Name : "(none)") << "\n"
+     << indent << "UrlTemplate: "
+     << (this->UrlTemplate ? this->UrlTemplate : "(none)") << "\n"
+     << indent << "Subdomains:";
+  for (size_t i = 0; i < this->Internals->Subdomains.size(); ++i)
+    {
+    os << " " << this->Internals->Subdomains[i];
+    }
+  os << "\n"
+     << indent << "MaxZoom: " << this->MaxZoom << "\n"
+     << indent << "TileSize: " << this->TileSize << "\n"
+     << indent << "MaxRequestsPerHost: " << this->MaxRequestsPerHost
+     << "\n"
+     << indent << "RateLimiter:\n";
+  this->RateLimiter->PrintSelf(os, indent.GetNextIndent());
+  os << indent << "Codec: " << this->Codec->GetClassName() << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::SetRateLimiter(vtkMapTileRateLimiter *limiter)
+{
+  if (!limiter || limiter == this->RateLimiter)
+    {
+    return;
+    }
+
+  limiter->Register(this);
+  this->RateLimiter->UnRegister(this);
+  this->RateLimiter = limiter;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::SetCodec(vtkMapTileCodec *codec)
+{
+  if (!codec || codec == this->Codec)
+    {
+    return;
+    }
+
+  codec->Register(this);
+  this->Codec->UnRegister(this);
+  this->Codec = codec;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::AddSubdomain(const std::string& subdomain)
+{
+  this->Internals->Subdomains.push_back(subdomain);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::RemoveAllSubdomains()
+{
+  this->Internals->Subdomains.clear();
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileSource::GetNumberOfSubdomains()
+{
+  return static_cast<int>(this->Internals->Subdomains.size());
+}
+
+//----------------------------------------------------------------------------
+bool vtkMapTileSource::IsLocal()
+{
+  return this->UrlTemplate &&
+    std::string(this->UrlTemplate).compare(0, 7, "file://") == 0;
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileSource::GetNextSubdomainIndex()
+{
+  int count = this->GetNumberOfSubdomains();
+  if (count < 2)
+    {
+    return 0;
+    }
+
+  this->Internals->Lock->Lock();
+  int start = this->Internals->NextSubdomain++ % count;
+  int result = start;
+  if (this->MaxRequestsPerHost > 0)
+    {
+    // Prefer the next host in rotation that has a free request slot
+    for (int i = 0; i < count; ++i)
+      {
+      int index = (start + i) % count;
+      std::string host =
+        vtkMapTileFailureCache::GetHost(this->GetTileUrl(0, 0, 0, index));
+      if (this->Internals->ActiveRequests[host] < this->MaxRequestsPerHost)
+        {
+        result = index;
+        break;
+        }
+      }
+    }
+  this->Internals->Lock->Unlock();
+
+  return result;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileSource::
+GetTileUrl(int zoom, int x, int y, int subdomainIndex)
+{
+  if (!this->UrlTemplate)
+    {
+    return std::string();
+    }
+
+  std::string url(this->UrlTemplate);
+  std::stringstream oss;
+  oss << zoom;
+  ReplaceAll(url, "{z}", oss.str());
+  oss.str("");
+  oss << x;
+  ReplaceAll(url, "{x}", oss.str());
+  oss.str("");
+  oss << y;
+  ReplaceAll(url, "{y}", oss.str());
+
+  if (!this->Internals->Subdomains.empty())
+    {
+    int count = this->GetNumberOfSubdomains();
+    ReplaceAll(url, "{s}", this->Internals->Subdomains[subdomainIndex % count]);
+    }
+
+  return url;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileSource::GetLocalTileFile(int zoom, int x, int y)
+{
+  // Strip "file://" (and keep the leading slash of absolute paths)
+  std::string url = this->GetTileUrl(zoom, x, y);
+  return this->IsLocal() ? url.substr(7) : std::string();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkMapTileSource::
+GetCacheTileFile(const char *cacheDirectory, int zoom, int x, int y)
+{
+  std::stringstream oss;
+  oss << cacheDirectory << "/" << zoom << "/" << x << "/" << y << ".png";
+  return oss.str();
+}
+
+//----------------------------------------------------------------------------
+int vtkMapTileSource::DownloadTile(const std::string& url,
+                                   const std::string& filename,
+                                   std::string& errorMessage, int priority)
+{
+  // Cached tiles are stored in per zoom and column directories
+  std::string directory = vtksys::SystemTools::GetFilenamePath(filename);
+  if (!directory.empty())
+    {
+    vtksys::SystemTools::MakeDirectory(directory.c_str());
+    }
+
+  std::string host = vtkMapTileFailureCache::GetHost(url);
+  this->RateLimiter->Acquire(host, priority);
+  this->AcquireHost(host);
+  int status = vtkMapTile::DownloadImageFile(url, filename, errorMessage,
+                                             this->Codec);
+  this->ReleaseHost(host);
+  if (status == vtkMapTile::DownloadOK)
+    {
+    this->RateLimiter->RecordBytes(
+      host, vtksys::SystemTools::FileLength(filename));
+    }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::AcquireHost(const std::string& host)
+{
+  this->Internals->Lock->Lock();
+  if (this->MaxRequestsPerHost > 0)
+    {
+    while (this->Internals->ActiveRequests[host] >= this->MaxRequestsPerHost)
+      {
+      this->Internals->HostAvailable->Wait(this->Internals->Lock);
+      }
+    }
+  this->Internals->ActiveRequests[host]++;
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkMapTileSource::ReleaseHost(const std::string& host)
+{
+  this->Internals->Lock->Lock();
+  this->Internals->ActiveRequests[host]--;
+  this->Internals->HostAvailable->Broadcast();
+  this->Internals->Lock->Unlock();
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkMapTileSource::ReadTileImage(int, int, int, int *status)
+{
+  if (status)
+    {
+    *status = vtkMapTile::DownloadMissing;
+    }
+  return NULL;
+}
@@ -0,0 +1,184 @@
+/*=========================================================================
+
+  Program:   Visualization Toolkit
+  Module:    vtkMapTileSource.h
+
+  Copyright (c) Ken Martin, Will Schroeder, Bill Lorensen
+  All rights reserved.
+  See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
+
+   This software is distributed WITHOUT ANY WARRANTY; without even
+   the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+   PURPOSE.  See the above copyright notice for more information.
+
+=========================================================================*/
+// .NAME vtkMapTileSource - where map tile images come from
+// .SECTION Description
+// Describes a tile server by a url template, in which {z}, {x} and {y}
+// are replaced by the tile indices and {s} by one of the subdomains.
+// For example, "http://{s}.tile.openstreetmap.org/{z}/{x}/{y}.png"
+// with subdomains "a", "b" and "c", which is the default.
+// Requests are rotated across the subdomains (mirror hosts), and the
+// number of concurrent requests to each host is limited by
+// MaxRequestsPerHost. Request and byte rates are limited by the
+// RateLimiter, which can be shared between sources.
+//
+// Servers only have tiles up to MaxZoom. Tile layers display the
+// tiles of MaxZoom magnified when zoomed in further, rather than
+// requesting tiles that don't exist.
+//
+// TileSize is the width of the tile images in pixels. Tile layers
+// choose the zoom level of the tiles from the screen resolution, so
+// high resolution (@2x, 512 pixel) tiles cover a screen with a quarter
+// of the tiles of 256 pixel ones.
+//
+// Templates starting with "file://" describe a local tile directory;
+// those tiles are read in place, without copying them to the cache.
+//
+// Subclasses that read tiles from other storage (e.g. a tile package,
+// see vtkMBTilesTileSource) or produce them (e.g. by blending other
+// sources, see vtkCompositeTileSource) override ProvidesImages() and
+// ReadTileImage().
+
+#ifndef __vtkMapTileSource_h
+#define __vtkMapTileSource_h
+
+#include <vtkObject.h>
+#include "vtkMapTileRateLimiter.h"  // for Priority
+#include "vtkmap_export.h"
+
+#include <string>
+
+class vtkImageData;
+class vtkMapTileCodec;
+
+class VTKMAP_EXPORT vtkMapTileSource : public vtkObject
+{
+public:
+  static vtkMapTileSource *New();
+  virtual void PrintSelf(ostream &os, vtkIndent indent);
+  vtkTypeMacro(vtkMapTileSource, vtkObject)
+
+  // Description:
+  // Get/Set the name of the source, which is also the name of the
+  // cache subdirectory used by tile layers. Default is "osm".
+  vtkSetStringMacro(Name)
+  vtkGetStringMacro(Name)
+
+  // Description:
+  // Get/Set the url template, using {z}, {x}, {y} and {s} placeholders
+  vtkSetStringMacro(UrlTemplate)
+  vtkGetStringMacro(UrlTemplate)
+
+  // Description:
+  // Add/remove the subdomains substituted for {s} in the url template
+  void AddSubdomain(const std::string& subdomain);
+  void RemoveAllSubdomains();
+  int GetNumberOfSubdomains();
+
+  // Description:
+  // Get/Set the highest zoom level the source has tiles for.
+  // Default is 19, the highest OpenStreetMap level.
+  vtkSetClampMacro(MaxZoom, int, 0, 30)
+  vtkGetMacro(MaxZoom, int)
+
+  // Description:
+  // Get/Set the width and height of the tile images in pixels, e.g.
+  // 512 for high resolution (@2x) tiles. Default is 256.
+  vtkSetClampMacro(TileSize, int, 1, 4096)
+  vtkGetMacro(TileSize, int)
+
+  // Description:
+  // Get/Set the maximum number of concurrent requests to one host.
+  // Zero means no limit. Default is 2.
+  vtkSetMacro(MaxRequestsPerHost, int)
+  vtkGetMacro(MaxRequestsPerHost, int)
+
+  // Description:
+  // Get/Set the rate limiter applied to downloads. Share one limiter
+  // between sources to apply MaxBytesPerSecond to all of them.
+  vtkGetObjectMacro(RateLimiter, vtkMapTileRateLimiter)
+  void SetRateLimiter(vtkMapTileRateLimiter *limiter);
+
+  // Description:
+  // Get/Set the codec recognizing and decoding the tile images.
+  // The default one detects PNG and JPEG images; set a subclass
+  // to support other formats.
+  vtkGetObjectMacro(Codec, vtkMapTileCodec)
+  void SetCodec(vtkMapTileCodec *codec);
+
+  // Description:
+  // Returns true if tiles are local files (file:// url template)
+  bool IsLocal();
+
+  // Description:
+  // Returns the index of the subdomain to use for the next request.
+  // Subdomains are used in rotation, skipping hosts that are
+  // at their request limit when possible. Thread safe.
+  int GetNextSubdomainIndex();
+
+  // Description:
+  // Returns the url of tile (zoom, x, y) on the specified subdomain
+  std::string GetTileUrl(int zoom, int x, int y, int subdomainIndex = 0);
+
+  // Description:
+  // Returns the local file name of tile (zoom, x, y), for local sources
+  std::string GetLocalTileFile(int zoom, int x, int y);
+
+  // Description:
+  // Returns the name of the file caching tile (zoom, x, y)
+  // in cacheDirectory, <zoom>/<x>/<y>.png, for sources that are not
+  // local. The extension doesn't depend on the image format; codecs
+  // recognize the images by their content.
+  std::string GetCacheTileFile(const char *cacheDirectory,
+                               int zoom, int x, int y);
+
+  // Description:
+  // Download url to filename, creating its directory if needed, and
+  // waiting while the url's host is at its request limit or rate limit.
+  // Priority is a vtkMapTileRateLimiter::Priority value.
+  // Returns a vtkMapTile::DownloadStatus value. Thread safe.
+  int DownloadTile(const std::string& url, const std::string& filename,
+                   std::string& errorMessage,
+                   int priority = vtkMapTileRateLimiter::PriorityVisible);
+
+  // Description:
+  // Returns true if the source provides decoded tile images through
+  // ReadTileImage() rather than image files. Default is false.
+  virtual bool ProvidesImages() { return false; }
+
+  // Description:
+  // Read tile (zoom, x, y) into a new image that the caller must
+  // Delete(). Returns NULL if the tile is not available, or if the
+  // source doesn't provide images. If status is not NULL, it is set to
+  // a vtkMapTile::DownloadStatus value telling whether the tile is
+  // missing or may be available later. Thread safe.
+  virtual vtkImageData *ReadTileImage(int zoom, int x, int y,
+                                      int *status = NULL);
+
+protected:
+  vtkMapTileSource();
+  ~vtkMapTileSource();
+
+  // Description:
+  // Wait for / release a request slot on the host
+  void AcquireHost(const std::string& host);
+  void ReleaseHost(const std::string& host);
+
+  char *Name;
+  char *UrlTemplate;
+  int MaxZoom;
+  int TileSize;
+  int MaxRequestsPerHost;
+  vtkMapTileRateLimiter *RateLimiter;
+  vtkMapTileCodec *Codec;
+
+  class vtkMapTileSourceInternals;
+  vtkMapTileSourceInternals *Internals;
+
+private:
+  vtkMapTileSource(const vtkMapTileSource&);  // Not implemented
+  vtkMapTileSource& operator=(const vtkMapTileSource&); // Not implemented
+};
+
+#endif // __vtkMapTileSource_h
@@ -42,26 +42,26 @@ public:
   //----------------------------------------------------------------------------
   static int long2tilex(double lon, int z)
   {
-    return (int)(floor((lon + 180.0) / 360.0 * std::pow(2.0, z)));
+    return (int)(floor((lon + 180.0) / 360.0 * (1 << z)));
   }
 
   //----------------------------------------------------------------------------
   static int lat2tiley(double lat, int z)
   {
     return (int)(floor((1.0 - log( tan(lat * m_pi()/180.0) + 1.0 /
-      cos(lat * m_pi()/180.0)) / m_pi()) / 2.0 * std::pow(2.0, z)));
+      cos(lat * m_pi()/180.0)) / m_pi()) / 2.0 * (1 << z)));
   }
 
   //----------------------------------------------------------------------------
   static double tilex2long(int x, int z)
   {
-    return x / std::pow(2.0, z) * 360.0 - 180;
+    return x / static_cast<double>(1 << z) * 360.0 - 180;
   }
 
   //----------------------------------------------------------------------------
   static double tiley2lat(int y, int z)
   {
-    double n = m_pi() - 2.0 * m_pi() * y / std::pow(2.0, z);
+    double n = m_pi() - 2.0 * m_pi() * y / (1 << z);
     return 180.0 / m_pi() * atan(0.5 * (exp(n) - exp(-n)));
   }
 
@@ -77,9 +77,133 @@ public:
     return 180.0 / m_pi() * log(tan(m_pi() / 4.0 + a * (m_pi() / 180.0) / 2.0));
   }
 
+  //----------------------------------------------------------------------------
+  // Batch versions of lat2y() and y2lat(), for n values; in and out
+  // may be the same array. They evaluate polynomial approximations
+  // instead of the math library's tan, log, exp and atan. Within the
+  // Web Mercator limits (latitudes of +/-85.0511 degrees), results are
+  // within 1e-9 degree of lat2y() and y2lat(), i.e. 0.1 mm on the
+  // ground, far below the 15 cm of a pixel at zoom level 20.
+  static void lat2y(const double *lat, double *y, vtkIdType n)
+  {
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      y[i] = (180.0 / m_pi()) * fastLat2y(lat[i] * (m_pi() / 180.0));
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  static void y2lat(const double *y, double *lat, vtkIdType n)
+  {
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      lat[i] = (180.0 / m_pi()) * fastY2lat(y[i] * (m_pi() / 180.0));
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  // Batch versions of long2tilex() and lat2tiley(), for n values at
+  // zoom level z (0 to 30)
+  static void long2tilex(const double *lon, int *x, vtkIdType n, int z)
+  {
+    const double scale = (1 << z) / 360.0;
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      x[i] = (int)(floor((lon[i] + 180.0) * scale));
+      }
+  }
+
+  //----------------------------------------------------------------------------
+  static void lat2tiley(const double *lat, int *y, vtkIdType n, int z)
+  {
+    const double scale = static_cast<double>(1 << z);
+    for (vtkIdType i = 0; i < n; ++i)
+      {
+      double my = fastLat2y(lat[i] * (m_pi() / 180.0)) / m_pi();
+      y[i] = (int)(floor((1.0 - my) / 2.0 * scale));
+      }
+  }
+
 protected:
   vtkMercator() {}
   virtual ~vtkMercator() {}
+
+  //----------------------------------------------------------------------------
+  // Mercator y of latitude phi, both in radians: log(tan(pi/4 + phi/2)),
+  // computed as log((1 + sin(phi)) / cos(phi)) on |phi| < pi/2
+  static double fastLat2y(double phi)
+  {
+    double a = fabs(phi);
+    double a2 = a * a;
+
+    // Taylor series, truncation error below 5e-14 on [0, pi/2]
+    double s = a * (1.0 + a2 * (-1.0 / 6.0 + a2 * (1.0 / 120.0 +
+      a2 * (-1.0 / 5040.0 + a2 * (1.0 / 362880.0 + a2 * (-1.0 / 39916800.0 +
+      a2 * (1.0 / 6227020800.0 + a2 * (-1.0 / 1307674368000.0 +
+      a2 * (1.0 / 355687428096000.0)))))))));
+    double c = 1.0 + a2 * (-1.0 / 2.0 + a2 * (1.0 / 24.0 +
+      a2 * (-1.0 / 720.0 + a2 * (1.0 / 40320.0 + a2 * (-1.0 / 3628800.0 +
+      a2 * (1.0 / 479001600.0 + a2 * (-1.0 / 87178291200.0 +
+      a2 * (1.0 / 20922789888000.0 + a2 * (-1.0 / 6402373705728000.0)))))))));
+
+    double y = fastLog((1.0 + s) / c);
+    return phi < 0.0 ? -y : y;
+  }
+
+  //----------------------------------------------------------------------------
+  // Latitude of Mercator y, both in radians: pi/2 - 2 atan(exp(-|y|))
+  static double fastY2lat(double y)
+  {
+    double a = fabs(y);
+    double t = fastExp(-a);  // in (0, 1]
+
+    // Halve the angle twice, to |t| < tan(pi/16), then Taylor series
+    // with truncation error below 1e-13
+    t = t / (1.0 + sqrt(1.0 + t * t));
+    t = t / (1.0 + sqrt(1.0 + t * t));
+    double t2 = t * t;
+    double atanT = t * (1.0 + t2 * (-1.0 / 3.0 + t2 * (1.0 / 5.0 +
+      t2 * (-1.0 / 7.0 + t2 * (1.0 / 9.0 + t2 * (-1.0 / 11.0 +
+      t2 * (1.0 / 13.0 + t2 * (-1.0 / 15.0 + t2 * (1.0 / 17.0)))))))));
+
+    double lat = m_pi() / 2.0 - 8.0 * atanT;
+    return y < 0.0 ? -lat : lat;
+  }
+
+  //----------------------------------------------------------------------------
+  // Natural logarithm of v > 0: v = m 2^e with m in [sqrt(1/2), sqrt(2)),
+  // log(m) = 2 atanh((m - 1) / (m + 1)), series error below 1e-16
+  static double fastLog(double v)
+  {
+    int e;
+    double m = frexp(v, &e);  // in [0.5, 1)
+    bool low = m < 0.70710678118654752440;
+    m = low ? 2.0 * m : m;
+    e = low ? e - 1 : e;
+
+    double t = (m - 1.0) / (m + 1.0);
+    double t2 = t * t;
+    double series = t * (2.0 + t2 * (2.0 / 3.0 + t2 * (2.0 / 5.0 +
+      t2 * (2.0 / 7.0 + t2 * (2.0 / 9.0 + t2 * (2.0 / 11.0 +
+      t2 * (2.0 / 13.0 + t2 * (2.0 / 15.0 + t2 * (2.0 / 17.0 +
+      t2 * (2.0 / 19.0))))))))));
+    return e * 0.69314718055994530942 + series;
+  }
+
+  //----------------------------------------------------------------------------
+  // Exponential of x: x = k log(2) + r with |r| <= log(2) / 2,
+  // Taylor series of exp(r) with error below 1e-16
+  static double fastExp(double x)
+  {
+    double k = floor(x * 1.44269504088896340736 + 0.5);
+    double r = x - k * 0.69314718055994530942;
+    double p = 1.0 + r * (1.0 + r * (1.0 / 2.0 + r * (1.0 / 6.0 +
+      r * (1.0 / 24.0 + r * (1.0 / 120.0 + r * (1.0 / 720.0 +
+      r * (1.0 / 5040.0 + r * (1.0 / 40320.0 + r * (1.0 / 362880.0 +
+      r * (1.0 / 3628800.0 + r * (1.0 / 39916800.0 +
+      r * (1.0 / 479001600.0 + r * (1.0 / 6227020800.0)))))))))))));
+    return ldexp(p, static_cast<int>(k));
+  }
 };
 
 
@@ -15,24 +15,15 @@
 
 #include "vtkMultiThreadedOsmLayer.h"
 #include "vtkMapTile.h"
+#include "vtkMapTileService.h"
+#include "vtkMapTileSource.h"
 
-#include <vtkAtomicInt.h>
-#include <vtkCallbackCommand.h>
-#include <vtkConditionVariable.h>
-#include <vtkMultiThreader.h>
+#include <vtkImageData.h>
 #include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
-#include <vtkRenderWindow.h>
-#include <vtkRenderWindowInteractor.h>
 #include <vtksys/SystemTools.hxx>
 
-#include <curl/curl.h>
 #include <cstdio>  // for remove()
-#include <sstream>
-#include <stack>
-
-// Limit the number of concurrent http requests
-#define NUMBER_OF_REQUEST_THREADS 6
 
 vtkStandardNewMacro(vtkMultiThreadedOsmLayer)
 
@@ -40,90 +31,26 @@ vtkStandardNewMacro(vtkMultiThreadedOsmLayer)
 class vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayerInternals
 {
 public:
-  vtkMultiThreader *BackgroundThreader;  // for BackgroundThreadExecute()
-  vtkMultiThreader *RequestThreader;  // for RequestThreadExecute()
-  int BackgroundThreadId;
-  bool DownloadMode;  // sets RequestThreader behavior
-
-  vtkAtomicInt<vtkTypeInt32> ThreadingEnabled;
-  vtkConditionVariable *ThreadingCondition;
-
-  std::stack<TileSpecList> ScheduledTiles;
-  vtkAtomicInt<vtkTypeInt32> ScheduledStackSize;
-  vtkMutexLock *ScheduledTilesLock;
-
   TileSpecList NewTiles;
   vtkMutexLock *NewTilesLock;
-
-  // Allocate tile-spec list for each request thread
-  TileSpecList ThreadTileSpecs[NUMBER_OF_REQUEST_THREADS];
 };
 
-//----------------------------------------------------------------------------
-static VTK_THREAD_RETURN_TYPE StaticBackgroundThreadExecute(void *arg)
-{
-  vtkMultiThreadedOsmLayer *self;
-  vtkMultiThreader::ThreadInfo *info =
-    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
-  self = static_cast<vtkMultiThreadedOsmLayer*>(info->UserData);
-  self->BackgroundThreadExecute();
-  return VTK_THREAD_RETURN_VALUE;
-}
-
-//----------------------------------------------------------------------------
-static VTK_THREAD_RETURN_TYPE StaticRequestThreadExecute(void *arg)
-{
-  vtkMultiThreadedOsmLayer *self;
-  vtkMultiThreader::ThreadInfo *info =
-    static_cast<vtkMultiThreader::ThreadInfo *>(arg);
-  self = static_cast<vtkMultiThreadedOsmLayer*>(info->UserData);
-  int threadId = info->ThreadID;
-  self->RequestThreadExecute(threadId);
-  return VTK_THREAD_RETURN_VALUE;
-}
-
 //----------------------------------------------------------------------------
 vtkMultiThreadedOsmLayer::vtkMultiThreadedOsmLayer()
 {
   this->AsyncMode = true;
   this->Internals = new vtkMultiThreadedOsmLayerInternals;
-
-  this->Internals->BackgroundThreader = vtkMultiThreader::New();
-  this->Internals->ThreadingEnabled = 1;
-  this->Internals->ThreadingCondition = vtkConditionVariable::New();
-  this->Internals->ScheduledStackSize = 0;
-  this->Internals->ScheduledTilesLock = vtkMutexLock::New();
   this->Internals->NewTilesLock = vtkMutexLock::New();
-
-  this->Internals->RequestThreader = vtkMultiThreader::New();
-  this->Internals->RequestThreader->SetNumberOfThreads(
-    NUMBER_OF_REQUEST_THREADS);
-  this->Internals->RequestThreader->SetSingleMethod(
-    StaticRequestThreadExecute, this);
-
-  // Start the background thread
-  this->Internals->BackgroundThreadId =
-    this->Internals->BackgroundThreader->SpawnThread(
-      StaticBackgroundThreadExecute, this);
 }
 
 //----------------------------------------------------------------------------
 vtkMultiThreadedOsmLayer::~vtkMultiThreadedOsmLayer()
 {
-  this->Internals->ThreadingEnabled = 0;
-  this->Internals->ThreadingCondition->Broadcast();
+  // Requests in progress call back this layer
+  this->TileService->CancelRequests(this);
+  this->ClearNewTiles();
 
-  this->Internals->BackgroundThreader->TerminateThread(
-    this->Internals->BackgroundThreadId);
-  vtkDebugMacro("Terminate Thread " << this->Internals->BackgroundThreadId);
-
-  this->Internals->BackgroundThreader->Delete();
-  this->Internals->RequestThreader->Delete();
-
-  this->Internals->ThreadingCondition->Delete();
-  this->Internals->ScheduledTilesLock->Delete();
   this->Internals->NewTilesLock->Delete();
-
   delete this->Internals;
 }
 
@@ -132,10 +59,8 @@ void vtkMultiThreadedOsmLayer::PrintSelf(ostream &os, vtkIndent indent)
 {
   Superclass::PrintSelf(os, indent);
   os << "vtkMultiThreadedOsmLayer"
-     << "\n" << indent << "BackgroundThreadId: "
-     << this->Internals->BackgroundThreadId
-     << "\n" << indent << "NumberOfRequestThreads: "
-     << this->Internals->RequestThreader->GetNumberOfThreads()
+     << "\n" << indent << "NumberOfPendingTiles: "
+     << this->TileService->GetNumberOfPendingTiles(this)
      << std::endl;
 }
 
@@ -146,147 +71,61 @@ void vtkMultiThreadedOsmLayer::Update()
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::BackgroundThreadExecute()
+// Checks if image is in a cache, and if so, creates tile
+bool vtkMultiThreadedOsmLayer::LookupTile(vtkMapTileSpecInternal& spec)
 {
-  vtkDebugMacro("Enter BackgroundThreadExecute()");
-  TileSpecList tileSpecs;
-  TileSpecList newTiles;
-  int workingStackSize;  // snapshot of stack size
-  while (this->Internals->ThreadingEnabled)
+  if (this->TileSource->ProvidesImages())
     {
-    // Check if there are scheduled tiles
-    this->Internals->ScheduledTilesLock->Lock();
-    workingStackSize = this->Internals->ScheduledTiles.size();
-    if (workingStackSize > 0)
-      {
-      tileSpecs = this->Internals->ScheduledTiles.top();
-      this->Internals->ScheduledTiles.pop();
-      workingStackSize--;
-      }
-    this->Internals->ScheduledStackSize = workingStackSize;
-    this->Internals->ScheduledTilesLock->Unlock();
-
-    // Process tileSpecs (if any) using 2-pass algorithm
-    // The 1st pass initializes those tiles that have an
-    // image file available in the image cache
-    // (from a previous application/session).
-    // The 2nd pass performs http requests for the files
-    // that aren't already in the image cache.
-    if (!tileSpecs.empty())
-      {
-      // Pass 1 initializes new tiles that have image file in cache
-      this->AssignTileSpecsToThreads(tileSpecs);
-      this->Internals->DownloadMode = false;
-      this->Internals->RequestThreader->SingleMethodExecute();
-      newTiles.clear();
-      tileSpecs.clear();
-      this->CollateThreadResults(newTiles, tileSpecs);
-
-      // std::cout << "After pass 1: "
-      //           << "newTiles.size() " << newTiles.size()
-      //           << ", tileSpecs.size() " << tileSpecs.size()
-      //           << std::endl;
-
-      // Copy new tiles to shared list
-      this->UpdateNewTiles(newTiles);
-
-      // Check if there are newer tiles in the scheduled stack
-      if (this->Internals->ScheduledStackSize > workingStackSize)
-        {
-        // If there are newer tiles, loop back and do them next
-        continue;
-        }
-
-      // Pass 2 downloads image files and initializes new tiles.
-      // Process one tile per thread so that we can break out
-      // sooner when new tiles are scheduled.
-      while (tileSpecs.size() > 0 &&
-             this->Internals->ScheduledStackSize == workingStackSize)
-        {
-        //std::cout << "Before pass 2: " << tileSpecs.size() << std::endl;
-        this->AssignOneTileSpecPerThread(tileSpecs);
-        //std::cout << "After assign : " << tileSpecs.size() << std::endl;
-        this->Internals->DownloadMode = true;
-        this->Internals->RequestThreader->SingleMethodExecute();
-        newTiles.clear();
-        this->CollateThreadResults(newTiles, tileSpecs);
-        //std::cout << "After collate : " << tileSpecs.size() << std::endl;
-        this->UpdateNewTiles(newTiles);
-        newTiles.clear();
-        }  // while
-      }  // if (tileSpecs not empty)
-
-    // If we broke out of loop early, continue processing
-    if (tileSpecs.size() > 0)
+    // Sources that provide images (e.g. tile packages) are read
+    // directly, so every spec is resolved without downloading
+    vtkMapTile *tile = this->CreateTile(spec);
+    if (!this->ReadTileImage(tile, spec))
       {
-      continue;
+      this->AssignFallbackImage(tile, spec);
       }
+    return true;
+    }
 
-    // Check if there are more scheduled tiles to process now
-    this->Internals->ScheduledTilesLock->Lock();
-    if (this->Internals->ScheduledTiles.size() == 0)
-      {
-      // If not, wait for condition variable
-      this->Internals->ThreadingCondition->Wait(
-        this->Internals->ScheduledTilesLock);
-      }
-    this->Internals->ScheduledTilesLock->Unlock();
-    }  // while
+  // Invalid files (e.g. from an interrupted session) are removed
+  // so that they are downloaded again
+  std::string filename = this->GetTileImageFile(
+    spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]);
+  vtkImageData *image = this->TileService->LoadImageFile(
+    filename, this->TileSource->GetCodec(),
+    this->TileMemoryMode == ReducedColor);
+  if (image)
+    {
+    this->SetTileImage(this->CreateTile(spec), image, filename);
+    image->Delete();
+    return true;
+    }
+
+  if (!this->TileSource->IsLocal() &&
+      vtksys::SystemTools::FileExists(filename.c_str(), true))
+    {
+    remove(filename.c_str());
+    }
+  return false;
 }
 
 //----------------------------------------------------------------------------
-// Checks if image file is in cache, and if so, creates tile
-void vtkMultiThreadedOsmLayer::RequestThreadExecute(int threadId)
+// Performs http request. Tiles that fail (or are backed off) get
+// substitute imagery, so that every spec is resolved.
+void vtkMultiThreadedOsmLayer::FetchTile(vtkMapTileSpecInternal& spec)
 {
-  //vtkDebugMacro("Enter RequestThreadExecute, thread " << threadId);
-  std::stringstream oss;
-
-  // Get reference to tiles assigned to this thread
-  TileSpecList& tileSpecs = this->Internals->ThreadTileSpecs[threadId];
-  if (tileSpecs.empty())
+  vtkMapTile *tile = this->CreateTile(spec);
+  if (!this->FetchTileImage(tile, spec))
     {
-    return;
+    this->AssignFallbackImage(tile, spec);
     }
+}
 
-  // Process all tile specs
-  std::vector<vtkMapTileSpecInternal>::iterator tileSpecIter =
-    tileSpecs.begin();
-  for (; tileSpecIter != tileSpecs.end(); tileSpecIter++)
-    {
-    vtkMapTileSpecInternal& spec = *tileSpecIter;
-    oss.str("");
-    oss << this->GetCacheDirectory() << "/"
-        << spec.ZoomRowCol[0]
-        << spec.ZoomRowCol[1]
-        << spec.ZoomRowCol[2]
-        << ".png";
-    std::string filename = oss.str();
-
-    if (this->Internals->DownloadMode)
-      {
-      // If DownloadMode, perform http request
-      oss.str("");
-      oss << "http://tile.openstreetmap.org"
-          << "/" << spec.ZoomRowCol[0]
-          << "/" << spec.ZoomRowCol[1]
-          << "/" << spec.ZoomRowCol[2]
-          << ".png";
-      std::string url = oss.str();
-
-      if (this->DownloadImageFile(url, filename))
-        {
-        this->CreateTile(spec);
-        }
-      }
-    else
-      {
-      // If *not* DownloadMode, check for image file in cache
-      if (vtksys::SystemTools::FileExists(filename.c_str(), true))
-        {
-        this->CreateTile(spec);
-        }
-      }
-    }  // for
+//----------------------------------------------------------------------------
+std::string vtkMultiThreadedOsmLayer::
+GetTileKey(vtkMapTileSpecInternal& spec)
+{
+  return this->GetTileImageFile(
+    spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]);
 }
 
 //----------------------------------------------------------------------------
@@ -317,7 +156,7 @@ vtkMap::AsyncState vtkMultiThreadedOsmLayer::ResolveAsync()
     }
 
   vtkMap::AsyncState result = vtkMap::AsyncIdle;  // return value
-  bool tilesTodo = this->Internals->ScheduledStackSize > 0;
+  bool tilesTodo = this->TileService->GetNumberOfPendingTiles(this) > 0;
   if (newTiles.size() > 0)
     {
     //std::cout << "Added new tiles: " << newTiles.size() << std::endl;
@@ -352,16 +191,11 @@ void vtkMultiThreadedOsmLayer::AddTiles()
   std::vector<vtkMapTileSpecInternal> tileSpecs;
 
   this->SelectTiles(tiles, tileSpecs);
+  this->UpdateTileVisibility(tiles);
   if (tileSpecs.size() > 0)
     {
-    // Add newTileSpecs to scheduled tiles stack
-    //std::cout << "Scheduling tiles " << newTileSpecs.size() << std::endl;
-    this->Internals->ScheduledTilesLock->Lock();
-    this->Internals->ScheduledTiles.push(tileSpecs);
-    this->Internals->ScheduledStackSize =
-      this->Internals->ScheduledTiles.size();
-    this->Internals->ThreadingCondition->Broadcast();
-    this->Internals->ScheduledTilesLock->Unlock();
+    // Queue newTileSpecs ahead of earlier requests
+    this->TileService->RequestTiles(this, tileSpecs);
     }
   else
     {
@@ -370,150 +204,56 @@ void vtkMultiThreadedOsmLayer::AddTiles()
 }
 
 //----------------------------------------------------------------------------
-// Note: This method is very similar to vtkMapTile::DownloadImage()
-bool vtkMultiThreadedOsmLayer::
-DownloadImageFile(std::string url, std::string filename)
+void vtkMultiThreadedOsmLayer::ResetTiles()
 {
-  //std::cout << "Downloading " << filename << std::endl;
-  CURL* curl;
-  FILE* fp;
-  CURLcode res;
-  char errorBuffer[CURL_ERROR_SIZE];  // for debug
-  long httpStatus = 0;  // for debug
-  curl = curl_easy_init();
-  if (!curl)
-    {
-    vtkErrorMacro(<< "curl_easy_init() failed" );
-    return false;
-    }
-
-  fp = fopen(filename.c_str(), "wb");
-  if(!fp)
-    {
-    vtkErrorMacro( << "Cannot open file " << filename.c_str());
-    return false;
-    }
-
-  curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errorBuffer);
-  curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-  res = curl_easy_perform(curl);
-
-  curl_easy_getinfo (curl, CURLINFO_RESPONSE_CODE, &httpStatus);
-  vtkDebugMacro("Download " << url.c_str() << " status: " << httpStatus);
-  curl_easy_cleanup(curl);
-  fclose(fp);
-
-  // If there was an error, remove invalid image file
-  if (res != CURLE_OK)
-    {
-    //std::cerr << "Removing invalid file: " << filename << std::endl;
-    remove(filename.c_str());
-    vtkErrorMacro(<< errorBuffer);
-    return false;
-    }
-
-  return true;
+  // Once the requests are canceled, no tile is resolved until the next
+  // request, but tiles of the previous source (or memory mode) may be
+  // waiting for ResolveAsync()
+  this->Superclass::ResetTiles();
+  this->ClearNewTiles();
 }
 
 //----------------------------------------------------------------------------
-vtkMapTile *vtkMultiThreadedOsmLayer::
-CreateTile(vtkMapTileSpecInternal& spec)
+void vtkMultiThreadedOsmLayer::ClearNewTiles()
 {
-  std::stringstream oss;
-
-  vtkMapTile *tile = vtkMapTile::New();
-  tile->SetCorners(spec.Corners);
-
-  // Set the image key
-  oss.str("");
-  oss << spec.ZoomRowCol[0]
-      << spec.ZoomRowCol[1]
-      << spec.ZoomRowCol[2];
-  tile->SetImageKey(oss.str());
-
-  // Set tile texture source
-  oss.str("");
-  oss << "http://tile.openstreetmap.org"
-      << "/" << spec.ZoomRowCol[0]
-      << "/" << spec.ZoomRowCol[1]
-      << "/" << spec.ZoomRowCol[2]
-      << ".png";
-  tile->SetImageSource(oss.str());
-
-  // Don't call tile->Init() here; must do that in the foreground thread
-  spec.Tile = tile;
-  return tile;
+  this->Internals->NewTilesLock->Lock();
+  TileSpecList::iterator specIter = this->Internals->NewTiles.begin();
+  for (; specIter != this->Internals->NewTiles.end(); specIter++)
+    {
+    specIter->Tile->Delete();
+    }
+  this->Internals->NewTiles.clear();
+  this->Internals->NewTilesLock->Unlock();
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::
-AssignTileSpecsToThreads(TileSpecList& tileSpecs)
+void vtkMultiThreadedOsmLayer::Prefetch(const double worldBounds[4],
+                                        int displayWidth)
 {
-  // Clear current thread tile spec lists
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
+  if (!this->TileService || displayWidth <= 0)
     {
-    this->Internals->ThreadTileSpecs[i].clear();
+    return;
     }
 
-  // Distribute inputs across threads
-  int index;
-  for (int i=0; i<tileSpecs.size(); i++)
+  int zoom = this->ComputeTileZoom(worldBounds[1] - worldBounds[0],
+                                   displayWidth);
+  std::vector<vtkMapTileSpecInternal> tileSpecs;
+  this->GetMissingTileSpecs(worldBounds, zoom, tileSpecs);
+  if (!tileSpecs.empty())
     {
-    index = i % numThreads;
-    this->Internals->ThreadTileSpecs[index].push_back(tileSpecs[i]);
+    this->TileService->RequestTiles(this, tileSpecs);
     }
 }
 
 //----------------------------------------------------------------------------
-void vtkMultiThreadedOsmLayer::
-AssignOneTileSpecPerThread(TileSpecList& tileSpecs)
+vtkMapTile *vtkMultiThreadedOsmLayer::
+CreateTile(vtkMapTileSpecInternal& spec)
 {
-  // Move tileSpecs from end of tileSpecs to thread
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
-    {
-    this->Internals->ThreadTileSpecs[i].clear();
-    if (tileSpecs.size() > 0)
-      {
-      // vtkMapTileSpecInternal spec = tileSpecs.back();
-      // std::stringstream oss;
-      // oss << "Assign "
-      //     << spec.ZoomRowCol[0] << spec.ZoomRowCol[1] << spec.ZoomRowCol[2]
-      //     << std::endl;
-      // std::cout << oss.str();
-
-      this->Internals->ThreadTileSpecs[i].push_back(tileSpecs.back());
-      tileSpecs.pop_back();
-      }
-    }
-}
+  vtkMapTile *tile = this->NewTile(spec);
 
-//----------------------------------------------------------------------------
-// Checks thread results and updates lists
-void vtkMultiThreadedOsmLayer::
-CollateThreadResults(TileSpecList& newTiles, TileSpecList& tileSpecs)
-{
-  int numThreads = this->Internals->RequestThreader->GetNumberOfThreads();
-  for (int i=0; i<numThreads; i++)
-    {
-    TileSpecList::iterator specIter =
-      this->Internals->ThreadTileSpecs[i].begin();
-    for (; specIter != this->Internals->ThreadTileSpecs[i].end(); specIter++)
-      {
-      vtkMapTileSpecInternal& spec = *specIter;
-      if (spec.Tile)
-        {
-        newTiles.push_back(spec);
-        }
-      else
-        {
-        tileSpecs.push_back(spec);
-        }
-      }
-    }
+  // Don't call tile->Init() here; must do that in the foreground thread
+  spec.Tile = tile;
+  return tile;
 }
 
 //----------------------------------------------------------------------------
@@ -16,15 +16,15 @@
 // .SECTION Description
 // A multithreaded subclass of vtkOsmLayer.
 // It performs concurrent map-tile requests in background threads,
-// in order to circumvent I/O blocking. On initialization, the class
-// starts a single background thread that supervises the overall logic
-// for both: (i) requesting files from the map tile server and
-// (ii) constructing new vtkMapTile instances. This supervisory thread
-// in turn executes a set of additional threads concurrently to perform
-// file I/O and http I/O actions. Because map tiles are generated
-// asynchronously, the class overrides the vtkLayer::ResolveAsync()
-// method; if new tiles have been created by the background threads,
-// they are added to the layer's map-tile cache in ResolveAsync().
+// in order to circumvent I/O blocking. Tile requests are queued on the
+// layer's vtkMapTileService, whose threads (i) look for the tile images
+// in the image caches, (ii) request files from the map tile server, and
+// (iii) construct new vtkMapTile instances, calling back the layer's
+// threaded methods. Layers sharing a service share its threads and
+// download queue. Because map tiles are generated asynchronously, the
+// class overrides the vtkLayer::ResolveAsync() method; if new tiles
+// have been created by the background threads, they are added to the
+// layer's map-tile cache in ResolveAsync().
 
 #ifndef __vtkMultiThreadedOsmLayer_h
 #define __vtkMultiThreadedOsmLayer_h
@@ -44,16 +44,37 @@ public:
   vtkTypeMacro(vtkMultiThreadedOsmLayer, vtkOsmLayer)
   virtual void PrintSelf(ostream &os, vtkIndent indent);
 
+  // Description:
+  // Tiles are created by the tile service threads instead
+  virtual void PrepareUpdate() {}
+
   // Description:
   virtual void Update();
 
   // Description:
-  // Threaded method for managing tile requests, to prevent blocking.
-  void BackgroundThreadExecute();
+  // Request the missing tiles of the view from the tile service,
+  // ahead of earlier requests
+  virtual void Prefetch(const double worldBounds[4], int displayWidth);
+
+  // Description:
+  // Threaded method for tile requests: create the tile if its image
+  // is available without downloading it. Returns true if the tile
+  // was created.
+  bool LookupTile(vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Threaded method for tile requests: download the tile image and
+  // create the tile, with substitute imagery if the download fails.
+  void FetchTile(vtkMapTileSpecInternal& spec);
 
   // Description:
-  // Threaded method for concurrent tile requests.
-  void RequestThreadExecute(int threadId);
+  // Threaded method for tile requests: returns the key identifying
+  // the tile image, for sharing downloads between layers
+  std::string GetTileKey(vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Threaded method for tile requests: copies new tiles to shared list.
+  void UpdateNewTiles(TileSpecList& newTiles);
 
   // Description:
   // Override vtkLayer::ResolveAsync()
@@ -69,31 +90,18 @@ protected:
   virtual void AddTiles();
 
   // Description:
-  // Download image file, returns boolean indicating success
-  bool DownloadImageFile(std::string url, std::string filename);
-
-  // Description:
-  // Instantiate and initialize vtkMapTile
-  vtkMapTile *CreateTile(vtkMapTileSpecInternal& spec);
-
-  // Description:
-  // Assign tile specs evenly across request threads
-  void AssignTileSpecsToThreads(TileSpecList& specs);
+  // Also drop the tiles resolved before the reset and not added to
+  // the cache yet
+  virtual void ResetTiles();
 
   // Description:
-  // Assign 1 tile spec to each thread
-  void AssignOneTileSpecPerThread(TileSpecList& specs);
+  // Delete the tiles resolved by the tile service threads and not
+  // added to the cache yet
+  void ClearNewTiles();
 
   // Description:
-  // Separate tile specs from threads into two lists,
-  // depending on whether they have initialized tile or not.
-  // Does not clear lists, but appends data to them.
-  void CollateThreadResults(TileSpecList& newTiles,
-                            TileSpecList& tileSpecs);
-
-  // Description:
-  // Copies new tiles to shared list.
-  void UpdateNewTiles(TileSpecList& newTiles);
+  // Instantiate and initialize vtkMapTile
+  vtkMapTile *CreateTile(vtkMapTileSpecInternal& spec);
 
   class vtkMultiThreadedOsmLayerInternals;
   vtkMultiThreadedOsmLayerInternals *Internals;
@@ -14,13 +14,23 @@
 
 #include "vtkOsmLayer.h"
 
+#include "vtkCompositeTileSource.h"
 #include "vtkMercator.h"
 #include "vtkMapTile.h"
-
+#include "vtkMapTileCodec.h"
+#include "vtkMapTileFailureCache.h"
+#include "vtkMapTileService.h"
+#include "vtkMapTileSource.h"
+
+#include <vtkActor.h>
+#include <vtkImageData.h>
+#include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
+#include <vtkProperty.h>
 #include <vtksys/SystemTools.hxx>
 
 #include <algorithm>
+#include <cstdio>  // for remove()
 #include <iomanip>
 #include <iterator>
 #include <math.h>
@@ -37,17 +47,110 @@ struct sortTiles
   }
 };
 
+//----------------------------------------------------------------------------
+// Number of world copies displayed on each side of the map
+static const int MaxWorldCopies = 2;
+
+//----------------------------------------------------------------------------
+// Returns the OSM column of unwrapped column x, of n columns per
+// world, and sets copy to the world copy x is in
+static int WrapColumn(int x, int n, int& copy)
+{
+  copy = x >= 0 ? x / n : -((n - 1 - x) / n);
+  return x - copy * n;
+}
+
+//----------------------------------------------------------------------------
+// Range of the tiles at zoom covering the view from bottomLeft to
+// topRight (world coordinates, y clamped to the map): zoom, first and
+// last unwrapped column (see WrapColumn()), first and last OSM row
+static void ComputeTileRange(const double bottomLeft[2],
+                             const double topRight[2], int zoom,
+                             int range[5])
+{
+  int last = (1 << zoom) - 1;
+  int first = -MaxWorldCopies * (1 << zoom);
+  int end = (MaxWorldCopies + 1) * (1 << zoom) - 1;
+  double lon[2] = { bottomLeft[0], topRight[0] };
+  double lat[2] = { bottomLeft[1], topRight[1] };
+  int tileX[2];
+  int tileY[2];
+  vtkMercator::y2lat(lat, lat, 2);
+  vtkMercator::long2tilex(lon, tileX, 2, zoom);
+  vtkMercator::lat2tiley(lat, tileY, 2, zoom);
+
+  range[0] = zoom;
+  range[1] = std::max(first, std::min(end, tileX[0]));
+  range[2] = std::max(first, std::min(end, tileX[1]));
+  range[3] = std::max(0, std::min(last, std::min(tileY[0], tileY[1])));
+  range[4] = std::max(0, std::min(last, std::max(tileY[0], tileY[1])));
+}
+
+//----------------------------------------------------------------------------
+// Tile spec of the tile at OSM column x and row y of zoom
+static void InitializeTileSpec(int zoom, int x, int y,
+                               vtkMapTileSpecInternal& tileSpec)
+{
+  int zoomLevelFactor = 1 << zoom;
+  double lonPerTile = 360.0 / zoomLevelFactor;
+  double latPerTile = 360.0 / zoomLevelFactor;
+  int xIndex = x;
+  int yIndex = zoomLevelFactor - 1 - y;
+
+  tileSpec.Corners[0] = -180.0 + xIndex * lonPerTile;  // llx
+  tileSpec.Corners[1] = -180.0 + yIndex * latPerTile;  // lly
+  tileSpec.Corners[2] = -180.0 + (xIndex + 1) * lonPerTile;  // urx
+  tileSpec.Corners[3] = -180.0 + (yIndex + 1) * latPerTile;  // ury
+
+  tileSpec.ZoomRowCol[0] = zoom;
+  tileSpec.ZoomRowCol[1] = x;
+  tileSpec.ZoomRowCol[2] = y;
+
+  tileSpec.ZoomXY[0] = zoom;
+  tileSpec.ZoomXY[1] = xIndex;
+  tileSpec.ZoomXY[2] = yIndex;
+}
+
+//----------------------------------------------------------------------------
+// Serializes the renderer coordinate conversions of layers
+static vtkSimpleMutexLock RendererLock;
+
 //----------------------------------------------------------------------------
 vtkOsmLayer::vtkOsmLayer() : vtkFeatureLayer()
 {
   this->BaseOn();
   this->CacheDirectory = NULL;
+  this->TileSource = vtkMapTileSource::New();
+  this->FailureCache = vtkMapTileFailureCache::New();
+  this->TileService = vtkMapTileService::New();
+  this->TileSourceMTime = 0;
+  this->TileMemoryMode = FullColor;
+  this->Prepared = false;
+  this->CrossFade = false;
+  this->View = &this->MainView;
+}
+
+//----------------------------------------------------------------------------
+vtkOsmLayer::ViewState::ViewState()
+{
+  this->SelectedRange[0] = -1;
+  this->SelectedRange[1] = this->SelectedRange[3] = 0;
+  this->SelectedRange[2] = this->SelectedRange[4] = -1;
+  this->TileLevel = 0.0;
+  this->TileZoom = -1;
+  this->FadeZoom = -1;
+  this->FadeOpacity = 1.0;
+  this->RenderedPropsMTime = 0;
 }
 
 //----------------------------------------------------------------------------
 vtkOsmLayer::~vtkOsmLayer()
 {
+  this->ClearPreparedTiles();
   this->RemoveTiles();
+  this->TileSource->Delete();
+  this->FailureCache->Delete();
+  this->TileService->UnRegister(this);
   delete [] this->CacheDirectory;
 }
 
@@ -55,6 +158,66 @@ vtkOsmLayer::~vtkOsmLayer()
 void vtkOsmLayer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "CrossFade: " << (this->CrossFade ? "On" : "Off") << "\n";
+  os << indent << "TileMemoryMode: "
+     << (this->TileMemoryMode == ReducedColor ? "ReducedColor" : "FullColor")
+     << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileSource(vtkMapTileSource *source)
+{
+  if (!source || source == this->TileSource)
+    {
+    return;
+    }
+
+  // Tiles from the previous source are no longer valid
+  this->ResetTiles();
+  this->SetCacheDirectory(NULL);
+
+  source->Register(this);
+  this->TileSource->UnRegister(this);
+  this->TileSource = source;
+  this->TileSourceMTime = 0;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkOsmLayer::GetMTime()
+{
+  return std::max(this->Superclass::GetMTime(),
+                  this->TileSource->GetMTime());
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileService(vtkMapTileService *service)
+{
+  if (!service || service == this->TileService)
+    {
+    return;
+    }
+
+  this->TileService->CancelRequests(this);
+  service->Register(this);
+  this->TileService->UnRegister(this);
+  this->TileService = service;
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileMemoryMode(int mode)
+{
+  mode = (mode == ReducedColor) ? ReducedColor : FullColor;
+  if (mode == this->TileMemoryMode)
+    {
+    return;
+    }
+
+  // Tiles are rebuilt with the new textures
+  this->ResetTiles();
+  this->TileMemoryMode = mode;
+  this->Modified();
 }
 
 //----------------------------------------------------------------------------
@@ -85,6 +248,23 @@ void vtkOsmLayer::SetCacheSubDirectory(const char *relativePath)
   this->SetCacheDirectory(fullPath.c_str());
 }
 
+//----------------------------------------------------------------------------
+void vtkOsmLayer::PrepareUpdate()
+{
+  // The first update, and updates after the tile source changes,
+  // are done entirely by Update()
+  if (!this->Map || !this->Renderer || !this->CacheDirectory ||
+      this->TileSource->GetMTime() != this->TileSourceMTime)
+    {
+    return;
+    }
+
+  this->ClearPreparedTiles();
+  this->SelectTiles(this->PreparedTiles, this->PreparedTileSpecs);
+  this->LoadTiles(this->PreparedTileSpecs);
+  this->Prepared = true;
+}
+
 //----------------------------------------------------------------------------
 void vtkOsmLayer::Update()
 {
@@ -96,7 +276,26 @@ void vtkOsmLayer::Update()
   if (!this->CacheDirectory)
     {
     // Note this calls the public "Sub" directory method
-    this->SetCacheSubDirectory("osm");
+    this->SetCacheSubDirectory(this->TileSource->GetName());
+    }
+
+  // Composite sources cache their component tiles with ours
+  vtkCompositeTileSource *composite =
+    vtkCompositeTileSource::SafeDownCast(this->TileSource);
+  if (composite && !composite->GetCacheDirectory())
+    {
+    composite->SetCacheDirectory(this->CacheDirectory);
+    }
+
+  // Reload the tiles after the tile source is modified
+  unsigned long sourceMTime = this->TileSource->GetMTime();
+  if (sourceMTime != this->TileSourceMTime)
+    {
+    if (this->TileSourceMTime != 0)
+      {
+      this->ResetTiles();
+      }
+    this->TileSourceMTime = sourceMTime;
     }
 
   this->AddTiles();
@@ -104,9 +303,90 @@ void vtkOsmLayer::Update()
   this->Superclass::Update();
 }
 
+//----------------------------------------------------------------------------
+void vtkOsmLayer::UpdateViewport(vtkRenderer *renderer)
+{
+  this->Superclass::UpdateViewport(renderer);
+  if (!this->Map || !this->Renderer || !renderer ||
+      renderer == this->Renderer || !this->CacheDirectory)
+    {
+    return;
+    }
+
+  // Select the tiles of the viewport's camera, sharing the tile cache.
+  // Tiles prepared for the map's renderer are left for it.
+  vtkRenderer *mapRenderer = this->Renderer;
+  bool prepared = this->Prepared;
+  this->Renderer = renderer;
+  this->View = &this->Viewports[renderer];
+  this->Prepared = false;
+
+  this->AddTiles();
+
+  this->Renderer = mapRenderer;
+  this->View = &this->MainView;
+  this->Prepared = prepared;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::RemoveViewport(vtkRenderer *renderer)
+{
+  this->Superclass::RemoveViewport(renderer);
+  std::map<vtkRenderer*, ViewState>::iterator view =
+    this->Viewports.find(renderer);
+  if (view == this->Viewports.end())
+    {
+    return;
+    }
+
+  std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
+  for (; iter != this->CachedTiles.end(); iter++)
+    {
+    (*iter)->RemoveActors(renderer);
+    }
+  this->Viewports.erase(view);
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ResetTiles()
+{
+  std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
+  for (; iter != this->CachedTiles.end(); iter++)
+    {
+    this->RemoveTileActors(*iter);
+    }
+  this->TileService->CancelRequests(this);
+  this->ClearPreparedTiles();
+  this->RemoveTiles();
+  this->FailureCache->Clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ClearPreparedTiles()
+{
+  std::vector<vtkMapTileSpecInternal>::iterator iter =
+    this->PreparedTileSpecs.begin();
+  for (; iter != this->PreparedTileSpecs.end(); iter++)
+    {
+    if (iter->Tile)
+      {
+      iter->Tile->Delete();
+      }
+    }
+  this->PreparedTileSpecs.clear();
+  this->PreparedTiles.clear();
+  this->Prepared = false;
+}
+
 //----------------------------------------------------------------------------
 void vtkOsmLayer::RemoveTiles()
 {
+  this->ClearSelectedTiles(this->MainView);
+  std::map<vtkRenderer*, ViewState>::iterator view = this->Viewports.begin();
+  for (; view != this->Viewports.end(); ++view)
+    {
+    this->ClearSelectedTiles(view->second);
+    }
   this->CachedTilesMap.clear();
   std::vector<vtkMapTile*>::iterator iter = this->CachedTiles.begin();
   for (; iter != this->CachedTiles.end(); iter++)
@@ -128,7 +408,18 @@ void vtkOsmLayer::AddTiles()
   std::vector<vtkMapTile*> tiles;
   std::vector<vtkMapTileSpecInternal> tileSpecs;
 
-  this->SelectTiles(tiles, tileSpecs);
+  // Use the tiles prepared for this update, if any
+  if (this->Prepared)
+    {
+    tiles.swap(this->PreparedTiles);
+    tileSpecs.swap(this->PreparedTileSpecs);
+    this->Prepared = false;
+    }
+  else
+    {
+    this->SelectTiles(tiles, tileSpecs);
+    }
+  this->UpdateTileVisibility(tiles);
   if (tileSpecs.size() > 0)
     {
     this->InitializeTiles(tiles, tileSpecs);
@@ -148,6 +439,9 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
   double focusDisplayPoint[3], bottomLeft[4], topRight[4];
   int width, height, tile_llx, tile_lly;
 
+  // The layers of a map share the renderer's coordinate conversions
+  // while preparing their updates concurrently
+  RendererLock.Lock();
   this->Renderer->SetWorldPoint(0.0, 0.0, 0.0, 1.0);
   this->Renderer->WorldToDisplay();
   this->Renderer->GetDisplayPoint(focusDisplayPoint);
@@ -166,8 +460,8 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
 
   //std::cerr << "Before bottomLeft " << bottomLeft[0] << " " << bottomLeft[1] << std::endl;
 
-  bottomLeft[0] = std::max(bottomLeft[0], -180.0);
-  bottomLeft[0] = std::min(bottomLeft[0],  180.0);
+  // Views past the antimeridian display copies of the map
+  double left = bottomLeft[0];
   bottomLeft[1] = std::max(bottomLeft[1], -180.0);
   bottomLeft[1] = std::min(bottomLeft[1],  180.0);
 
@@ -176,6 +470,7 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
                                   focusDisplayPoint[2]);
   this->Renderer->DisplayToWorld();
   this->Renderer->GetWorldPoint(topRight);
+  RendererLock.Unlock();
 
   if (topRight[3] != 0.0)
     {
@@ -184,95 +479,273 @@ SelectTiles(std::vector<vtkMapTile*>& tiles,
     topRight[2] /= topRight[3];
     }
 
-  topRight[0] = std::max(topRight[0], -180.0);
-  topRight[0] = std::min(topRight[0],  180.0);
+  double level = this->ComputeTileLevel(topRight[0] - left, width);
+  int zoomLevel = static_cast<int>(floor(level + 0.5));
+
   topRight[1] = std::max(topRight[1], -180.0);
   topRight[1] = std::min(topRight[1],  180.0);
 
-  int zoomLevel = this->Map->GetZoom() + 1;
-  int zoomLevelFactor = 1 << zoomLevel; // Zoom levels are interpreted as powers of two.
-
-  int tile1x = vtkMercator::long2tilex(bottomLeft[0], zoomLevel);
-  int tile2x = vtkMercator::long2tilex(topRight[0], zoomLevel);
-
-  int tile1y = vtkMercator::lat2tiley(
-                 vtkMercator::y2lat(bottomLeft[1]), zoomLevel);
-  int tile2y = vtkMercator::lat2tiley(
-                 vtkMercator::y2lat(topRight[1]), zoomLevel);
+  // Between two levels, load the level being approached and blend
+  // the cached tiles of the other one
+  int fadeZoom = -1;
+  this->View->FadeZoom = -1;
+  if (this->CrossFade)
+    {
+    int lower = static_cast<int>(floor(level));
+    double fraction = level - lower;
+    if (fraction > 1.0 / 256.0 && fraction < 255.0 / 256.0)
+      {
+      if (level > this->View->TileLevel)
+        {
+        zoomLevel = lower + 1;
+        }
+      else if (level < this->View->TileLevel)
+        {
+        zoomLevel = lower;
+        }
+      else if (this->View->TileZoom == lower ||
+               this->View->TileZoom == lower + 1)
+        {
+        zoomLevel = this->View->TileZoom;
+        }
+      fadeZoom = (zoomLevel == lower) ? lower + 1 : lower;
+      this->View->FadeZoom = lower + 1;
+      this->View->FadeOpacity = fraction;
+      }
+    }
+  this->View->TileLevel = level;
+  this->View->TileZoom = zoomLevel;
 
-  //std::cerr << "tile1y " << tile1y << " " << tile2y << std::endl;
+  // Only look up the tiles entering the view
+  int range[5];
+  ComputeTileRange(bottomLeft, topRight, zoomLevel, range);
+  this->UpdateSelectedTiles(range);
 
-  if (tile2y > tile1y)
+  // The cached tiles of the level faded with it. A tile seen in
+  // several world copies is listed once, with the range of its copies.
+  if (fadeZoom >= 0)
     {
-    int temp = tile1y;
-    tile1y = tile2y;
-    tile2y = temp;
+    int fadeRange[5];
+    ComputeTileRange(bottomLeft, topRight, fadeZoom, fadeRange);
+    int n = 1 << fadeZoom;
+    for (int i = fadeRange[1]; i <= fadeRange[2]; ++i)
+      {
+      int copy;
+      int x = WrapColumn(i, n, copy);
+      for (int j = fadeRange[3]; j <= fadeRange[4]; ++j)
+        {
+        vtkMapTile *tile = this->GetCachedTile(fadeZoom, x, n - 1 - j);
+        if (!tile || tile->GetFallback())
+          {
+          continue;
+          }
+        if (i - n >= fadeRange[1])
+          {
+          tile->SetCopyRange(tile->GetCopyRange()[0], copy);
+          }
+        else
+          {
+          tile->SetCopyRange(copy, copy);
+          tiles.push_back(tile);
+          }
+        }
+      }
     }
 
-  //std::cerr << "Before bottomLeft " << bottomLeft[0] << " " << bottomLeft[1] << std::endl;
-  //std::cerr << "Before topRight " << topRight[0] << " " << topRight[1] << std::endl;
-
-  /// Clamp tilex and tiley
-  tile1x = std::max(tile1x, 0);
-  tile1x = std::min(zoomLevelFactor - 1, tile1x);
-  tile2x = std::max(tile2x, 0);
-  tile2x = std::min(zoomLevelFactor - 1, tile2x);
+  int n = 1 << zoomLevel;
+  std::vector<SelectedTile>::iterator iter = this->View->SelectedTiles.begin();
+  for (; iter != this->View->SelectedTiles.end(); ++iter)
+    {
+    int copy;
+    int i = WrapColumn(iter->X, n, copy);
+    int j = iter->Y;
 
-  tile1y = std::max(tile1y, 0);
-  tile1y = std::min(zoomLevelFactor - 1, tile1y);
-  tile2y = std::max(tile2y, 0);
-  tile2y = std::min(zoomLevelFactor - 1, tile2y);
+    // Only copies are found a world away
+    vtkMapTile* tile = iter->Tile;
+    if (iter->X - n >= range[1])
+      {
+      if (tile)
+        {
+        tile->SetCopyRange(tile->GetCopyRange()[0], copy);
+        }
+      continue;
+      }
 
-  int noOfTilesX = std::max(1, zoomLevelFactor);
-  int noOfTilesY = std::max(1, zoomLevelFactor);
+    if (tile)
+      {
+      tile->SetCopyRange(copy, copy);
+      tiles.push_back(tile);
+      }
 
-  double lonPerTile = 360.0 / noOfTilesX;
-  double latPerTile = 360.0 / noOfTilesY;
+    // Request new tiles, and retry fallback tiles once their
+    // backoff period has expired
+    if (!tile || (tile->GetFallback() &&
+                  this->FailureCache->IsTileAvailable(zoomLevel, i, j)))
+      {
+      vtkMapTileSpecInternal tileSpec;
+      InitializeTileSpec(zoomLevel, i, j, tileSpec);
+      tileSpecs.push_back(tileSpec);
+      }
+    }
+}
 
-  //std::cerr << "llx " << llx << " lly " << lly << " " << height << std::endl;
-  //std::cerr << "tile1y " << tile1y << " " << tile2y << std::endl;
+//----------------------------------------------------------------------------
+void vtkOsmLayer::
+GetMissingTileSpecs(const double worldBounds[4], int zoom,
+                    std::vector<vtkMapTileSpecInternal>& tileSpecs)
+{
+  double bottomLeft[2] = { worldBounds[0], worldBounds[2] };
+  double topRight[2] = { worldBounds[1], worldBounds[3] };
+  bottomLeft[1] = std::max(-180.0, std::min(bottomLeft[1], 180.0));
+  topRight[1] = std::max(-180.0, std::min(topRight[1], 180.0));
+
+  // Each tile once, whatever the number of world copies in view
+  int range[5];
+  ComputeTileRange(bottomLeft, topRight, zoom, range);
+  int n = 1 << zoom;
+  int end = std::min(range[2], range[1] + n - 1);
+  for (int k = range[1]; k <= end; ++k)
+    {
+    int copy;
+    int i = WrapColumn(k, n, copy);
+    for (int j = range[3]; j <= range[4]; ++j)
+      {
+      if (!this->GetCachedTile(zoom, i, n - 1 - j) &&
+          this->FailureCache->IsTileAvailable(zoom, i, j))
+        {
+        vtkMapTileSpecInternal tileSpec;
+        InitializeTileSpec(zoom, i, j, tileSpec);
+        tileSpecs.push_back(tileSpec);
+        }
+      }
+    }
+}
 
-  //std::cerr << "tile1x " << tile1x << " tile2x " << tile2x << std::endl;
-  //std::cerr << "tile1y " << tile1y << " tile2y " << tile2y << std::endl;
+//----------------------------------------------------------------------------
+void vtkOsmLayer::UpdateSelectedTiles(int range[5])
+{
+  if (std::equal(range, range + 5, this->View->SelectedRange))
+    {
+    return;
+    }
 
-  std::ostringstream ossKey, ossImageSource;
-  std::vector<vtkMapTile*> pendingTiles;
-  int xIndex, yIndex;
-  for (int i = tile1x; i <= tile2x; ++i)
+  // Tiles in both ranges are kept, entering ones are looked up
+  int *old = this->View->SelectedRange;
+  int oldHeight = old[4] - old[3] + 1;
+  int n = 1 << range[0];
+  std::vector<SelectedTile> selected;
+  selected.reserve((range[2] - range[1] + 1) * (range[4] - range[3] + 1));
+  for (int i = range[1]; i <= range[2]; ++i)
     {
-    for (int j = tile2y; j <= tile1y; ++j)
+    for (int j = range[3]; j <= range[4]; ++j)
       {
-      xIndex = i;
-      yIndex = zoomLevelFactor - 1 - j;
-
-      vtkMapTile* tile = this->GetCachedTile(zoomLevel, xIndex, yIndex);
-      if (tile)
+      SelectedTile entry;
+      entry.X = i;
+      entry.Y = j;
+      if (range[0] == old[0] && i >= old[1] && i <= old[2] &&
+          j >= old[3] && j <= old[4])
         {
-        tiles.push_back(tile);
-        tile->SetVisible(true);
+        entry.Tile =
+          this->View->SelectedTiles[(i - old[1]) * oldHeight + j - old[3]].Tile;
         }
       else
         {
-        vtkMapTileSpecInternal tileSpec;
+        int copy;
+        entry.Tile =
+          this->GetCachedTile(range[0], WrapColumn(i, n, copy), n - 1 - j);
+        }
+      selected.push_back(entry);
+      }
+    }
+
+  // List the leaving ones, for Update() to hide
+  std::vector<SelectedTile>::iterator iter = this->View->SelectedTiles.begin();
+  for (; iter != this->View->SelectedTiles.end(); ++iter)
+    {
+    if (iter->Tile && (range[0] != old[0] ||
+        iter->X < range[1] || iter->X > range[2] ||
+        iter->Y < range[3] || iter->Y > range[4]))
+      {
+      this->View->LeavingTiles.push_back(iter->Tile);
+      }
+    }
 
-        tileSpec.Corners[0] = -180.0 + xIndex * lonPerTile;  // llx
-        tileSpec.Corners[1] = -180.0 + yIndex * latPerTile;  // lly
-        tileSpec.Corners[2] = -180.0 + (xIndex + 1) * lonPerTile;  // urx
-        tileSpec.Corners[3] = -180.0 + (yIndex + 1) * latPerTile;  // ury
+  this->View->SelectedTiles.swap(selected);
+  std::copy(range, range + 5, this->View->SelectedRange);
+}
 
-        tileSpec.ZoomRowCol[0] = zoomLevel;
-        tileSpec.ZoomRowCol[1] = i;
-        tileSpec.ZoomRowCol[2] =
-          zoomLevelFactor - 1 - yIndex;
+//----------------------------------------------------------------------------
+void vtkOsmLayer::ClearSelectedTiles(ViewState& view)
+{
+  view.SelectedTiles.clear();
+  view.SelectedRange[0] = -1;
+  view.SelectedRange[1] = view.SelectedRange[3] = 0;
+  view.SelectedRange[2] = view.SelectedRange[4] = -1;
+  view.RenderedActors.clear();
+  view.LeavingTiles.clear();
+}
 
-        tileSpec.ZoomXY[0] = zoomLevel;
-        tileSpec.ZoomXY[1] = xIndex;
-        tileSpec.ZoomXY[2] = yIndex;
+//----------------------------------------------------------------------------
+void vtkOsmLayer::UpdateTileVisibility(std::vector<vtkMapTile*>& tiles)
+{
+  std::vector<vtkMapTile*>::iterator iter = this->View->LeavingTiles.begin();
+  for (; iter != this->View->LeavingTiles.end(); ++iter)
+    {
+    (*iter)->SetVisible(false);
+    }
+  this->View->LeavingTiles.clear();
 
-        tileSpecs.push_back(tileSpec);
+  for (iter = tiles.begin(); iter != tiles.end(); ++iter)
+    {
+    (*iter)->SetVisible(true);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::
+SetSelectedTile(ViewState& view, int zoom, int x, int y, vtkMapTile *tile)
+{
+  // In all the world copies (rows count from the top there)
+  int *range = view.SelectedRange;
+  int n = 1 << zoom;
+  int j = n - 1 - y;
+  if (zoom == range[0] && j >= range[3] && j <= range[4])
+    {
+    int height = range[4] - range[3] + 1;
+    int copy;
+    WrapColumn(range[1], n, copy);
+    for (int i = x + copy * n; i <= range[2]; i += n)
+      {
+      if (i >= range[1])
+        {
+        view.SelectedTiles[(i - range[1]) * height + j - range[3]].Tile = tile;
+        }
       }
     }
-  }
+}
+
+//----------------------------------------------------------------------------
+int vtkOsmLayer::ComputeTileZoom(double worldWidth, int displayWidth)
+{
+  return static_cast<int>(
+    floor(this->ComputeTileLevel(worldWidth, displayWidth) + 0.5));
+}
+
+//----------------------------------------------------------------------------
+double vtkOsmLayer::ComputeTileLevel(double worldWidth, int displayWidth)
+{
+  double level = this->Map->GetZoom() + 1;
+  if (worldWidth > 0.0 && displayWidth > 0)
+    {
+    // Tiles at zoom are 360 / 2^zoom degrees wide
+    double pixelsPerDegree = displayWidth / worldWidth;
+    level = log(pixelsPerDegree * 360.0 / this->TileSource->GetTileSize())
+      / log(2.0);
+    }
+
+  // Past the source's highest level, its tiles are magnified
+  return std::max(0.0, std::min(level,
+    static_cast<double>(this->TileSource->GetMaxZoom())));
 }
 
 //----------------------------------------------------------------------------
@@ -281,61 +754,116 @@ void vtkOsmLayer::
 InitializeTiles(std::vector<vtkMapTile*>& tiles,
                 std::vector<vtkMapTileSpecInternal>& tileSpecs)
 {
-  std::stringstream oss;
+  this->LoadTiles(tileSpecs);
+
   std::vector<vtkMapTileSpecInternal>::iterator tileSpecIter =
     tileSpecs.begin();
   for (; tileSpecIter != tileSpecs.end(); tileSpecIter++)
     {
     vtkMapTileSpecInternal spec = *tileSpecIter;
-
-    vtkMapTile *tile = vtkMapTile::New();
-    tile->SetLayer(this);
-    tile->SetCorners(spec.Corners);
-
-    // Set the image key
-    oss.str("");
-    oss << spec.ZoomRowCol[0]
-        << spec.ZoomRowCol[1]
-        << spec.ZoomRowCol[2];
-    tile->SetImageKey(oss.str());
-
-    // Set tile texture source
-    oss.str("");
-    oss << "http://tile.openstreetmap.org"
-        << "/" << spec.ZoomRowCol[0]
-        << "/" << spec.ZoomRowCol[1]
-        << "/" << spec.ZoomRowCol[2]
-        << ".png";
-    tile->SetImageSource(oss.str());
+    vtkMapTile *tile = spec.Tile;
 
     // Initialize the tile and add to the cache
     tile->Init();
     int zoom = spec.ZoomXY[0];
     int x = spec.ZoomXY[1];
     int y = spec.ZoomXY[2];
+    vtkMapTile *oldTile = this->GetCachedTile(zoom, x, y);
+    if (oldTile)
+      {
+      std::replace(tiles.begin(), tiles.end(), oldTile, tile);
+      }
+    else
+      {
+      tiles.push_back(tile);
+      }
     this->AddTileToCache(zoom, x, y, tile);
-    tiles.push_back(tile);
     tile->SetVisible(true);
     }
   tileSpecs.clear();
 }
 
 
+//----------------------------------------------------------------------------
+void vtkOsmLayer::LoadTiles(std::vector<vtkMapTileSpecInternal>& tileSpecs)
+{
+  std::vector<vtkMapTileSpecInternal>::iterator tileSpecIter =
+    tileSpecs.begin();
+  for (; tileSpecIter != tileSpecs.end(); tileSpecIter++)
+    {
+    vtkMapTileSpecInternal& spec = *tileSpecIter;
+    if (spec.Tile)
+      {
+      continue;
+      }
+
+    vtkMapTile *tile = this->NewTile(spec);
+    tile->SetLayer(this);
+
+    // Use substitute imagery if the image can't be read or downloaded now
+    bool hasImage = this->TileSource->ProvidesImages() ?
+      this->ReadTileImage(tile, spec) : this->FetchTileImage(tile, spec);
+    if (!hasImage)
+      {
+      this->AssignFallbackImage(tile, spec);
+      }
+    spec.Tile = tile;
+    }
+}
+
 //----------------------------------------------------------------------------
 // Updates display to incorporate all new tiles
 void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
 {
+  // Nothing to do if the same tiles are displayed, and no other
+  // layer reordered the props since
+  std::stable_sort(tiles.begin(), tiles.end(), sortTiles());
+
+  // Blend the upper level while fading between two levels
+  std::vector<vtkMapTile*>::iterator tileIter = tiles.begin();
+  for (; tileIter != tiles.end(); ++tileIter)
+    {
+    vtkActor *actor = (*tileIter)->GetActor();
+    if (actor)
+      {
+      bool faded = (*tileIter)->GetZoom() == this->View->FadeZoom;
+      actor->GetProperty()->SetOpacity(
+        faded ? this->View->FadeOpacity : 1.0);
+      }
+    }
+
+  // Tiles are drawn in each of their world copies
+  std::vector<vtkActor*> actors;
+  for (tileIter = tiles.begin(); tileIter != tiles.end(); ++tileIter)
+    {
+    int *copies = (*tileIter)->GetCopyRange();
+    for (int copy = copies[0]; copy <= copies[1]; ++copy)
+      {
+      vtkActor *actor = (*tileIter)->GetCopyActor(copy);
+      if (actor)
+        {
+        actors.push_back(actor);
+        }
+      }
+    }
+
+  vtkPropCollection* props = this->Renderer->GetViewProps();
+  if (actors == this->View->RenderedActors &&
+      props->GetMTime() == this->View->RenderedPropsMTime)
+    {
+    tiles.clear();
+    return;
+    }
+
   if (tiles.size() > 0)
     {
     // Remove the old tiles first
     std::vector<vtkMapTile*>::iterator itr = this->CachedTiles.begin();
     for (; itr != this->CachedTiles.end(); ++itr)
       {
-      this->Renderer->RemoveActor((*itr)->GetActor());
+      (*itr)->RemoveActors(this->Renderer);
       }
 
-    vtkPropCollection* props = this->Renderer->GetViewProps();
-
     props->InitTraversal();
     vtkProp* prop = props->GetNextProp();
     std::vector<vtkProp*> otherProps;
@@ -347,11 +875,10 @@ void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
 
     this->Renderer->RemoveAllViewProps();
 
-    std::sort(tiles.begin(), tiles.end(), sortTiles());
-    for (std::size_t i = 0; i < tiles.size(); ++i)
+    for (std::size_t i = 0; i < actors.size(); ++i)
       {
       // Add tile to the renderer
-      this->Renderer->AddActor(tiles[i]->GetActor());
+      this->Renderer->AddActor(actors[i]);
       }
 
     std::vector<vtkProp*>::iterator itr2 = otherProps.begin();
@@ -361,6 +888,8 @@ void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
       ++itr2;
       }
 
+    this->View->RenderedActors.swap(actors);
+    this->View->RenderedPropsMTime = props->GetMTime();
     tiles.clear();
     }
 }
@@ -368,8 +897,41 @@ void vtkOsmLayer::RenderTiles(std::vector<vtkMapTile*>& tiles)
 //----------------------------------------------------------------------------
 void vtkOsmLayer::AddTileToCache(int zoom, int x, int y, vtkMapTile* tile)
 {
+  // Replace existing (fallback) tile
+  vtkMapTile *oldTile = this->GetCachedTile(zoom, x, y);
+  if (oldTile && oldTile != tile)
+    {
+    this->RemoveTileActors(oldTile);
+    this->CachedTiles.erase(std::remove(this->CachedTiles.begin(),
+                                        this->CachedTiles.end(), oldTile),
+                            this->CachedTiles.end());
+    oldTile->Delete();
+    }
+
   this->CachedTilesMap[zoom][x][y] = tile;
   this->CachedTiles.push_back(tile);
+
+  // Keep the selections of all the views up to date
+  this->SetSelectedTile(this->MainView, zoom, x, y, tile);
+  std::map<vtkRenderer*, ViewState>::iterator view = this->Viewports.begin();
+  for (; view != this->Viewports.end(); ++view)
+    {
+    this->SetSelectedTile(view->second, zoom, x, y, tile);
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::RemoveTileActors(vtkMapTile *tile)
+{
+  if (this->Renderer)
+    {
+    tile->RemoveActors(this->Renderer);
+    }
+  std::map<vtkRenderer*, ViewState>::iterator view = this->Viewports.begin();
+  for (; view != this->Viewports.end(); ++view)
+    {
+    tile->RemoveActors(view->first);
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -384,3 +946,289 @@ vtkMapTile *vtkOsmLayer::GetCachedTile(int zoom, int x, int y)
 
   return this->CachedTilesMap[zoom][x][y];
 }
+
+//----------------------------------------------------------------------------
+std::string vtkOsmLayer::GetTileImageFile(int zoom, int x, int y)
+{
+  if (this->TileSource->IsLocal())
+    {
+    return this->TileSource->GetLocalTileFile(zoom, x, y);
+    }
+
+  return this->TileSource->GetCacheTileFile(this->CacheDirectory,
+                                           zoom, x, y);
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::RequestTileImage(vtkMapTileSpecInternal& spec)
+{
+  int zoom = spec.ZoomRowCol[0];
+  int x = spec.ZoomRowCol[1];
+  int y = spec.ZoomRowCol[2];
+  std::string filename = this->GetTileImageFile(zoom, x, y);
+  if (vtkMapTile::IsImageFileValid(filename.c_str(),
+                                   this->TileSource->GetCodec()))
+    {
+    return true;
+    }
+
+  // Local sources have nothing to download
+  if (this->TileSource->IsLocal())
+    {
+    if (this->FailureCache->IsTileAvailable(zoom, x, y))
+      {
+      this->FailureCache->RecordFailure(zoom, x, y, "localhost", true);
+      }
+    return false;
+    }
+
+  // Skip tiles that failed recently. If the next host in rotation
+  // is suspended, try the other hosts.
+  std::string url;
+  std::string host;
+  int numHosts = std::max(1, this->TileSource->GetNumberOfSubdomains());
+  int start = this->TileSource->GetNextSubdomainIndex();
+  bool canRequest = false;
+  for (int i = 0; i < numHosts && !canRequest; ++i)
+    {
+    url = this->TileSource->GetTileUrl(zoom, x, y, (start + i) % numHosts);
+    host = vtkMapTileFailureCache::GetHost(url);
+    canRequest = this->FailureCache->CanRequest(zoom, x, y, host);
+    }
+  if (!canRequest)
+    {
+    // All hosts are suspended: back off the tile too, or it would be
+    // requested again on every update
+    if (this->FailureCache->IsTileAvailable(zoom, x, y))
+      {
+      this->FailureCache->RecordTileFailure(zoom, x, y);
+      }
+    return false;
+    }
+
+  std::string errorMessage;
+  int status = this->TileSource->DownloadTile(url, filename, errorMessage);
+  if (status == vtkMapTile::DownloadOK)
+    {
+    this->FailureCache->RecordSuccess(zoom, x, y, host);
+    return true;
+    }
+
+  vtkWarningMacro(<< errorMessage);
+  this->FailureCache->RecordFailure(zoom, x, y, host,
+                                    status == vtkMapTile::DownloadMissing);
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::FetchTileImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec)
+{
+  if (!this->RequestTileImage(spec))
+    {
+    return false;
+    }
+  std::string filename = tile->GetImageFile();
+  if (this->LoadTileImage(tile, filename))
+    {
+    return true;
+    }
+
+  // Undecodable downloads are removed, to be downloaded again once
+  // the tile's backoff expires
+  int zoom = spec.ZoomRowCol[0];
+  int x = spec.ZoomRowCol[1];
+  int y = spec.ZoomRowCol[2];
+  if (!this->TileSource->IsLocal())
+    {
+    remove(filename.c_str());
+    }
+  if (this->FailureCache->IsTileAvailable(zoom, x, y))
+    {
+    this->FailureCache->RecordTileFailure(zoom, x, y);
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::LoadTileImage(vtkMapTile *tile, const std::string& filename)
+{
+  vtkImageData *image = this->TileService->LoadImageFile(
+    filename, this->TileSource->GetCodec(),
+    this->TileMemoryMode == ReducedColor);
+  if (!image)
+    {
+    return false;
+    }
+  this->SetTileImage(tile, image, filename);
+  image->Delete();
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::SetTileImage(vtkMapTile *tile, vtkImageData *image,
+                               const std::string& key)
+{
+  vtkImageData *expanded = this->TileService->ExpandImage(key, image);
+  tile->SetImage(expanded);
+  if (expanded)
+    {
+    expanded->Delete();
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkOsmLayer::ReadTileImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec)
+{
+  int zoom = spec.ZoomRowCol[0];
+  int x = spec.ZoomRowCol[1];
+  int y = spec.ZoomRowCol[2];
+  int status = vtkMapTile::DownloadMissing;
+  vtkImageData *image = this->ReadSourceImage(zoom, x, y, &status);
+  if (image)
+    {
+    this->SetTileImage(tile, image, this->GetSourceImageKey(zoom, x, y));
+    image->Delete();
+    return true;
+    }
+
+  // Don't look for the tile again until it expires from the failure
+  // cache, or its retry delay expires if it may be available later
+  if (this->FailureCache->IsTileAvailable(zoom, x, y))
+    {
+    this->FailureCache->RecordFailure(zoom, x, y,
+                                      this->TileSource->GetName(),
+                                      status != vtkMapTile::DownloadFailed);
+    }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+vtkImageData *vtkOsmLayer::ReadSourceImage(int zoom, int x, int y,
+                                           int *status, bool cachedOnly)
+{
+  std::string key = this->GetSourceImageKey(zoom, x, y);
+  vtkImageData *image = this->TileService->GetImage(key);
+  if (image && status)
+    {
+    *status = vtkMapTile::DownloadOK;
+    }
+  if (!image && !cachedOnly)
+    {
+    vtkImageData *sourceImage =
+      this->TileSource->ReadTileImage(zoom, x, y, status);
+    vtkImageData *indexed = (sourceImage &&
+      this->TileMemoryMode == ReducedColor) ?
+      vtkMapTileCodec::IndexColors(sourceImage) : NULL;
+    if (indexed)
+      {
+      sourceImage->Delete();
+      sourceImage = indexed;
+      }
+    image = this->TileService->AddImage(key, sourceImage);
+    if (sourceImage)
+      {
+      sourceImage->Delete();
+      }
+    }
+  return image;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkOsmLayer::GetSourceImageKey(int zoom, int x, int y)
+{
+  // Source names are unique, as they name the cache directories.
+  // The modification time distinguishes images read before the
+  // source changed (e.g. composite source opacities).
+  std::stringstream oss;
+  oss << this->TileSource->GetName() << "@" << this->TileSourceMTime
+      << "/" << zoom << "/" << x << "/" << y;
+  return oss.str();
+}
+
+//----------------------------------------------------------------------------
+void vtkOsmLayer::
+AssignFallbackImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec)
+{
+  int zoom = spec.ZoomRowCol[0];
+  int x = spec.ZoomRowCol[1];
+  int y = spec.ZoomRowCol[2];
+
+  tile->SetFallback(true);
+  tile->SetImageFile("");  // placeholder, unless an ancestor is available
+  tile->SetImage(NULL);
+
+  // Search up the tile pyramid for the closest available image
+  bool providesImages = this->TileSource->ProvidesImages();
+  // Composite sources download their tiles; only use ancestors
+  // already blended
+  bool cachedOnly =
+    vtkCompositeTileSource::SafeDownCast(this->TileSource) != NULL;
+  for (int level = zoom - 1; level >= 0; --level)
+    {
+    int shift = zoom - level;
+    int ancestorX = x >> shift;
+    int ancestorY = y >> shift;
+    if (providesImages)
+      {
+      vtkImageData *image =
+        this->ReadSourceImage(level, ancestorX, ancestorY, NULL, cachedOnly);
+      if (!image)
+        {
+        continue;
+        }
+      this->SetTileImage(tile, image,
+                         this->GetSourceImageKey(level, ancestorX, ancestorY));
+      image->Delete();
+      }
+    else
+      {
+      std::string filename =
+        this->GetTileImageFile(level, ancestorX, ancestorY);
+      if (!this->LoadTileImage(tile, filename))
+        {
+        continue;
+        }
+      tile->SetImageFile(filename);
+      }
+
+    // Texture coordinates of this tile within the ancestor image.
+    // Tile rows count down from the top, texture t counts up from
+    // the bottom.
+    double n = static_cast<double>(1 << shift);
+    double col = x - (ancestorX << shift);
+    double row = y - (ancestorY << shift);
+    double range[4];
+    range[0] = col / n;
+    range[1] = (col + 1.0) / n;
+    range[2] = 1.0 - (row + 1.0) / n;
+    range[3] = 1.0 - row / n;
+    tile->SetTextureRange(range);
+    break;
+    }
+}
+
+//----------------------------------------------------------------------------
+vtkMapTile *vtkOsmLayer::NewTile(vtkMapTileSpecInternal& spec)
+{
+  std::stringstream oss;
+
+  vtkMapTile *tile = vtkMapTile::New();
+  tile->SetCorners(spec.Corners);
+  tile->SetZoom(spec.ZoomRowCol[0]);
+  tile->SetReducedColor(this->TileMemoryMode == ReducedColor);
+
+  // Set the image key
+  oss << spec.ZoomRowCol[0]
+      << spec.ZoomRowCol[1]
+      << spec.ZoomRowCol[2];
+  tile->SetImageKey(oss.str());
+
+  // Set tile texture source and file. The layer takes care of
+  // downloading, so the tile only reads the file.
+  tile->SetImageSource(this->TileSource->GetTileUrl(
+    spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]));
+  tile->SetImageFile(this->GetTileImageFile(
+    spec.ZoomRowCol[0], spec.ZoomRowCol[1], spec.ZoomRowCol[2]));
+
+  return tile;
+}
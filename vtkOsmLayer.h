@@ -28,11 +28,24 @@
 #include <vtkRenderer.h>
 
 #include <map>
+#include <string>
 #include <vector>
 
+class vtkMapTileFailureCache;
+class vtkMapTileService;
+class vtkMapTileSource;
+
 class VTKMAP_EXPORT vtkOsmLayer : public vtkFeatureLayer
 {
 public:
+  // Description:
+  // How tile images are stored (see SetTileMemoryMode())
+  enum TileMemoryModes
+    {
+    FullColor = 0,
+    ReducedColor
+    };
+
   static vtkOsmLayer* New();
   virtual void PrintSelf(ostream &os, vtkIndent indent);
   vtkTypeMacro(vtkOsmLayer, vtkFeatureLayer)
@@ -46,9 +59,78 @@ public:
   // The full path to the directory used for caching OSM image files.
   vtkGetStringMacro(CacheDirectory);
 
+  // Description:
+  // Get/Set the source of the tile images, OpenStreetMap by default.
+  // Setting the source resets the cache directory to the subdirectory
+  // named after the source; call SetCacheSubDirectory() afterwards
+  // to use a different one.
+  vtkGetObjectMacro(TileSource, vtkMapTileSource)
+  void SetTileSource(vtkMapTileSource *source);
+
+  // Description:
+  // Get the negative cache used to back off from failing tile requests.
+  // Use it to adjust retry delays, or to clear it after a network outage.
+  vtkGetObjectMacro(FailureCache, vtkMapTileFailureCache)
+
+  // Description:
+  // Get/Set the service holding the decoded tile images (and for
+  // vtkMultiThreadedOsmLayer, serving tile requests). Each layer has
+  // its own by default; layers showing the same tiles, in the same or
+  // different maps, can share one to decode and download tiles once.
+  vtkGetObjectMacro(TileService, vtkMapTileService)
+  void SetTileService(vtkMapTileService *service);
+
+  // Description:
+  // Get/Set how tile images are stored. FullColor (the default) keeps
+  // decoded images as they are, and uploads 32 bit textures.
+  // ReducedColor caches images of up to 256 colors, such as OSM's
+  // palettised PNGs, as one byte color indices in the tile service
+  // (a third of RGB), and uploads 16 bit textures (RGB5, or RGBA4 for
+  // translucent tiles), halving GPU memory. Images are expanded back
+  // to RGB(A) in the cache when a tile displays them, as the texture
+  // input, so displayed tiles take as much CPU memory as in FullColor,
+  // and only images cached for tiles not displayed yet are saved on.
+  // Use FullColor for imagery that needs the full color depth.
+  // Changing the mode reloads the tiles.
+  void SetTileMemoryMode(int mode);
+  vtkGetMacro(TileMemoryMode, int)
+  void SetTileMemoryModeToFullColor() { this->SetTileMemoryMode(FullColor); }
+  void SetTileMemoryModeToReducedColor()
+    { this->SetTileMemoryMode(ReducedColor); }
+
+  // Description:
+  // Get/Set whether to blend the tiles of the two levels closest to
+  // the screen resolution, for smooth fractional zooming (see
+  // vtkMap::SetZoomStep()). The level being approached is loaded,
+  // and drawn below or above the cached tiles of the other level,
+  // whose opacity follows the fractional part of the level. Off by
+  // default: the closest level is displayed.
+  vtkGetMacro(CrossFade, bool)
+  vtkSetMacro(CrossFade, bool)
+  vtkBooleanMacro(CrossFade, bool)
+
+  // Description:
+  // Includes the modification time of the tile source
+  virtual unsigned long GetMTime();
+
+  // Description:
+  // Select the tiles for the current view, and create and read the
+  // new ones, for the next Update() to display. Thread safe with
+  // respect to the other layers of the map.
+  virtual void PrepareUpdate();
+
   // Description:
   virtual void Update();
 
+  // Description:
+  // Select and display the tiles of a viewport's camera, sharing the
+  // tile cache, the tile requests and the tile actors and textures
+  // with the map's renderer. Each viewport has its own selection,
+  // culling and cross-fading. Faded tiles shared by views are drawn
+  // with the opacity of the last view updated.
+  virtual void UpdateViewport(vtkRenderer *renderer);
+  virtual void RemoveViewport(vtkRenderer *renderer);
+
 protected:
   vtkOsmLayer();
   virtual ~vtkOsmLayer();
@@ -58,6 +140,11 @@ protected:
   virtual void AddTiles();
   void RemoveTiles();
 
+  // Description:
+  // Remove all tiles from the renderer and the cache, cancel pending
+  // requests and clear the failure cache, e.g. when the source changes
+  virtual void ResetTiles();
+
   // Next 3 methods used to add tiles to layer
   void SelectTiles(std::vector<vtkMapTile*>& tiles,
                    std::vector<vtkMapTileSpecInternal>& tileSpecs);
@@ -65,14 +152,178 @@ protected:
                        std::vector<vtkMapTileSpecInternal>& tileSpecs);
   void RenderTiles(std::vector<vtkMapTile*>& tiles);
 
+  // Description:
+  // Set the tile range of the view being updated (zoom, first and
+  // last column, first and last OSM row), looking up only the tiles
+  // entering it, and listing the tiles leaving it to be hidden
+  void UpdateSelectedTiles(int range[5]);
+
+  // Description:
+  // Hide the tiles that left the selection of the view being updated,
+  // and show tiles, the ones SelectTiles() returned. Selecting tiles
+  // doesn't change any render object, so that it can be done by
+  // PrepareUpdate(); Update() applies the changes.
+  void UpdateTileVisibility(std::vector<vtkMapTile*>& tiles);
+
+  // Description:
+  // Create the tiles of the tile specs that have none, and read their
+  // images or fallback images. Doesn't change any render object.
+  void LoadTiles(std::vector<vtkMapTileSpecInternal>& tileSpecs);
+
+  // Description:
+  // Append the specs of the tiles at zoom covering worldBounds
+  // (xmin, xmax, ymin, ymax) that are neither cached nor known to fail
+  void GetMissingTileSpecs(const double worldBounds[4], int zoom,
+                           std::vector<vtkMapTileSpecInternal>& tileSpecs);
+
+  // Description:
+  // Delete the tiles prepared by PrepareUpdate() and not displayed yet
+  void ClearPreparedTiles();
+
+  // Description:
+  // Returns the zoom level of the tiles to display for a view
+  // worldWidth degrees wide on displayWidth pixels: the level whose
+  // tile pixels are closest to the screen pixels, so that the number
+  // of tiles on screen depends on the resolution and the tile size
+  int ComputeTileZoom(double worldWidth, int displayWidth);
+
+  // Description:
+  // Fractional tile level for the view, ComputeTileZoom() unrounded
+  double ComputeTileLevel(double worldWidth, int displayWidth);
+
+  // Description:
+  // Add tile to the cache, replacing (and deleting) any tile
+  // previously cached at the same indices
   void AddTileToCache(int zoom, int x, int y, vtkMapTile* tile);
   vtkMapTile* GetCachedTile(int zoom, int x, int y);
 
+  // Description:
+  // Image file name for the tile with OSM indices (zoom, x, y);
+  // in the cache directory, or the tile source directory if local
+  std::string GetTileImageFile(int zoom, int x, int y);
+
+  // Description:
+  // Create a tile for the tile spec, with image key & source set
+  vtkMapTile *NewTile(vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Make sure the image file for the tile spec is in the cache,
+  // downloading it unless requests for the tile are backed off.
+  // Returns true if the image is available. Thread safe.
+  bool RequestTileImage(vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Request the image file for the tile spec, and set it as the image
+  // of tile (created with NewTile()). Tiles whose image can't be
+  // decoded are backed off like failed requests.
+  // Returns true if the image is available. Thread safe.
+  bool FetchTileImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Set the decoded image file as the tile's image, using the
+  // tile service's image cache. Returns false if the file is not
+  // a valid image. Thread safe.
+  bool LoadTileImage(vtkMapTile *tile, const std::string& filename);
+
+  // Description:
+  // Set image, cached under key in the tile service, as the image of
+  // tile, expanding indexed images in the cache so that the tile
+  // shares its texture input with it (see
+  // vtkMapTileService::ExpandImage()). Thread safe.
+  void SetTileImage(vtkMapTile *tile, vtkImageData *image,
+                    const std::string& key);
+
+  // Description:
+  // For tile sources that provide decoded images, read the image
+  // for the tile spec into the tile.
+  // Returns true if the image is available. Thread safe.
+  bool ReadTileImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec);
+
+  // Description:
+  // Read the image for OSM indices (zoom, x, y) from an image providing
+  // tile source, through the tile service's image cache. Returns NULL
+  // if not available; the caller must Delete() the image. Status is
+  // set as for vtkMapTileSource::ReadTileImage(). If cachedOnly is true,
+  // only the image cache is checked. Thread safe.
+  vtkImageData *ReadSourceImage(int zoom, int x, int y, int *status = NULL,
+                                bool cachedOnly = false);
+
+  // Description:
+  // Key of the image read by ReadSourceImage() in the image cache
+  std::string GetSourceImageKey(int zoom, int x, int y);
+
+  // Description:
+  // Set up a tile whose own image is not available to display the
+  // matching part of the closest available ancestor image, or a placeholder
+  // if there is none. Thread safe.
+  void AssignFallbackImage(vtkMapTile *tile, vtkMapTileSpecInternal& spec);
+
 protected:
   char *CacheDirectory;
+  vtkMapTileSource *TileSource;
+  vtkMapTileFailureCache *FailureCache;
+  vtkMapTileService *TileService;
+  unsigned long TileSourceMTime;  // at the last Update()
+  int TileMemoryMode;
   std::map< int, std::map< int, std::map <int, vtkMapTile*> > > CachedTilesMap;
   std::vector<vtkMapTile*> CachedTiles;
 
+  // Tiles in the selected range, in column major order, NULL where
+  // not cached yet. Kept up to date by AddTileToCache().
+  struct SelectedTile
+    {
+    int X;  // column, continuing into the world copies
+    int Y;  // OSM row
+    vtkMapTile *Tile;
+    };
+
+  // Whether to cross-fade between tile levels
+  bool CrossFade;
+
+  // Tile selection and display of a view of the layer: the map's
+  // renderer or one of its viewports (see UpdateViewport())
+  struct ViewState
+    {
+    ViewState();
+
+    // Selected range, and its tiles
+    int SelectedRange[5];
+    std::vector<SelectedTile> SelectedTiles;
+
+    // Tiles that left the selection, to hide on the main thread
+    std::vector<vtkMapTile*> LeavingTiles;
+
+    // Cross-fading: level and zoom of the last selected tiles, and
+    // level of the tiles drawn with FadeOpacity (-1 when not fading)
+    double TileLevel;
+    int TileZoom;
+    int FadeZoom;
+    double FadeOpacity;
+
+    // Tile actors (including world copies) displayed by the last
+    // RenderTiles(), and time of the renderer's props then
+    std::vector<vtkActor*> RenderedActors;
+    unsigned long RenderedPropsMTime;
+    };
+  ViewState MainView;
+  std::map<vtkRenderer*, ViewState> Viewports;
+  ViewState *View;  // the view being updated
+
+  // Description:
+  // Clear the selection of view, or set the tile at (zoom, x, y) in it
+  void ClearSelectedTiles(ViewState& view);
+  void SetSelectedTile(ViewState& view, int zoom, int x, int y,
+                       vtkMapTile *tile);
+
+  // Description:
+  // Remove the actors of tile from the renderers of all the views
+  void RemoveTileActors(vtkMapTile *tile);
+
+  // Tiles selected by PrepareUpdate(), for the next Update()
+  bool Prepared;
+  std::vector<vtkMapTile*> PreparedTiles;
+  std::vector<vtkMapTileSpecInternal> PreparedTileSpecs;
+
 private:
   vtkOsmLayer(const vtkOsmLayer&);    // Not implemented
   vtkOsmLayer& operator=(const vtkOsmLayer&); // Not implemented
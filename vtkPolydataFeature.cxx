@@ -63,6 +63,18 @@ void vtkPolydataFeature::Update()
   this->UpdateTime.Modified();
 }
 
+//----------------------------------------------------------------------------
+void vtkPolydataFeature::AddViewport(vtkRenderer *renderer)
+{
+  renderer->AddActor(this->Actor);
+}
+
+//----------------------------------------------------------------------------
+void vtkPolydataFeature::RemoveViewport(vtkRenderer *renderer)
+{
+  renderer->RemoveActor(this->Actor);
+}
+
 //----------------------------------------------------------------------------
 void vtkPolydataFeature::CleanUp()
 {
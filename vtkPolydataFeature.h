@@ -54,6 +54,11 @@ public:
   // Override
   virtual void Update();
 
+  // Description:
+  // Override
+  virtual void AddViewport(vtkRenderer *renderer);
+  virtual void RemoveViewport(vtkRenderer *renderer);
+
 protected:
   vtkPolydataFeature();
   ~vtkPolydataFeature();
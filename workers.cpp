@@ -0,0 +1,56 @@
+// Worker processes for the vtkmap command line tools
+
+#include "workers.h"
+
+#include <vtksys/Process.h>
+
+#include <iostream>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+bool RunWorkers(const std::vector<std::string>& args, int processes)
+{
+  std::ostringstream count;
+  count << processes;
+  std::string countString = count.str();
+  std::vector<vtksysProcess*> workers;
+  for (int i = 0; i < processes; ++i)
+    {
+    std::ostringstream index;
+    index << i;
+    std::string worker = index.str();
+    std::vector<const char*> command;
+    for (size_t k = 0; k < args.size(); ++k)
+      {
+      command.push_back(args[k].c_str());
+      }
+    command.push_back("--processes");
+    command.push_back(countString.c_str());
+    command.push_back("--worker");
+    command.push_back(worker.c_str());
+    command.push_back(NULL);
+
+    vtksysProcess *process = vtksysProcess_New();
+    vtksysProcess_SetCommand(process, &command[0]);
+    vtksysProcess_SetPipeShared(process, vtksysProcess_Pipe_STDOUT, 1);
+    vtksysProcess_SetPipeShared(process, vtksysProcess_Pipe_STDERR, 1);
+    vtksysProcess_Execute(process);
+    workers.push_back(process);
+    }
+
+  bool ok = true;
+  for (size_t i = 0; i < workers.size(); ++i)
+    {
+    vtksysProcess_WaitForExit(workers[i], NULL);
+    int state = vtksysProcess_GetState(workers[i]);
+    if (state == vtksysProcess_State_Error)
+      {
+      std::cerr << "Cannot run worker " << i << ": "
+                << vtksysProcess_GetErrorString(workers[i]) << std::endl;
+      }
+    ok = ok && state == vtksysProcess_State_Exited &&
+      vtksysProcess_GetExitValue(workers[i]) == 0;
+    vtksysProcess_Delete(workers[i]);
+    }
+  return ok;
+}
@@ -0,0 +1,17 @@
+// Worker processes for the vtkmap command line tools
+//
+// vtkmap-snapshot and vtkmap-rasterize split their work between copies
+// of themselves, each run with the tool's arguments followed by
+// "--processes N --worker I".
+
+#ifndef __workers_h
+#define __workers_h
+
+#include <string>
+#include <vector>
+
+// Run processes workers, each with args, the number of workers and
+// its index. Returns false if any of them failed.
+bool RunWorkers(const std::vector<std::string>& args, int processes);
+
+#endif // __workers_h